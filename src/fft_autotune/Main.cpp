@@ -0,0 +1,71 @@
+#include "fft_bench/Benchmarks.hpp"
+#include "fft_bench/Dispatch.hpp"
+
+// Short calibration of the forward benchmarks that writes the fastest plan per size to the dispatch table read by DispatchingFFT.
+// Takes the same --fft_* options as fft_bench, e.g.
+// ./fft_autotune --fft_sizes=2^8:2^24 --fft_backends=fftw,ipp,pffft,kfr --fft_threads=1:max --fft_dispatch=../data/dispatch.table
+int main(int argc, char** argv)
+try
+{
+  auto config = ParseConfig(argc, argv);
+  config.transforms = {Transform::Forward};
+  config.cacheModes = {CacheMode::Warm};
+  config.bufferStrategies = {config.bufferStrategies.front()};
+  config.latency = false;
+  config.instances.clear();
+  config.planBenchmarks = false;
+  config.batchCounts.clear();
+  config.multidimShapes.clear();
+  config.fourStepSizes.clear();
+  config.outOfCore.sizes.clear();
+  config.doubleSizes.clear();
+  config.stream.path.clear();
+  config.stft.sizes.clear();
+  config.setupSizes.clear();
+  config.jobs.sizes.clear();
+  InitBackends(config);
+  PlanCache::Global().SetCapacity(config.planCacheCapacity);
+  BufferArena::Global().SetStrategy(config.bufferStrategies.front());
+
+  RegisterBenchmarks(config);
+
+  // a short minimum time keeps the calibration at a few seconds per size, --benchmark_min_time overrides it
+  std::vector<char*> args(argv, argv + argc);
+  std::string minTime = "--benchmark_min_time=0.05";
+  if (std::ranges::none_of(args, [](const char* arg) { return std::string_view(arg).starts_with("--benchmark_min_time"); }))
+    args.push_back(minTime.data());
+  int nargs = args.size();
+  args.push_back(nullptr);
+
+  benchmark::Initialize(&nargs, args.data());
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  InputFixtures::Clear();
+
+  DispatchTable table;
+  for (const auto size : GetForwardSizes(config))
+    if (const auto key = SizeAdvisor::Global().GetFastestPlan(size))
+      table.Set(*key);
+  if (table.Empty())
+    throw std::runtime_error("No benchmark completed, the dispatch table would be empty");
+
+  table.Save(config.dispatchPath);
+  fmt::print("Dispatch table {}:\n", config.dispatchPath);
+  for (const auto& [size, key] : table.GetEntries())
+    fmt::print("{:>8} | {}\n", size, GetPlanName(key));
+
+  PlanCache::Global().Clear();
+  fftwf_cleanup_threads();
+  fftw_cleanup_threads();
+  return EXIT_SUCCESS;
+}
+catch (const std::exception& e)
+{
+  fmt::print("Error: {}\n", e.what());
+  return EXIT_FAILURE;
+}
+catch (...)
+{
+  fmt::print("Error: Unknown error\n");
+  return EXIT_FAILURE;
+}
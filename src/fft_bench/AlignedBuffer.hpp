@@ -0,0 +1,39 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "BufferArena.hpp"
+
+// Caller-owned, zero-initialized buffer aligned for every backend's SIMD requirements (FFTW, IPP, PFFFT, KFR). The memory comes from
+// BufferArena with its current strategy.
+template <typename T>
+class AlignedBuffer
+{
+public:
+  static constexpr usize alignment = BufferArena::alignment;
+
+  AlignedBuffer() = default;
+  explicit AlignedBuffer(usize size) : size(size), block(BufferArena::Global().Allocate(size * sizeof(T)))
+  {
+    std::memset(block.data, 0, (size * sizeof(T) + alignment - 1) / alignment * alignment);
+  }
+  AlignedBuffer(const AlignedBuffer&) = delete;
+  AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+  AlignedBuffer(AlignedBuffer&& other) noexcept : size(std::exchange(other.size, 0)), block(std::exchange(other.block, {})) {}
+  AlignedBuffer& operator=(AlignedBuffer&& other) noexcept
+  {
+    std::swap(size, other.size);
+    std::swap(block, other.block);
+    return *this;
+  }
+  ~AlignedBuffer() { BufferArena::Global().Release(block); }
+
+  T* Data() { return static_cast<T*>(block.data); }
+  const T* Data() const { return static_cast<const T*>(block.data); }
+  usize Size() const { return size; }
+  usize Bytes() const { return size * sizeof(T); }
+  T& operator[](usize index) { return Data()[index]; }
+  const T& operator[](usize index) const { return Data()[index]; }
+
+private:
+  usize size = 0;
+  BufferArena::Block block;
+};
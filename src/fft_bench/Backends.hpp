@@ -0,0 +1,515 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+#include "SimdFFT.hpp"
+
+// from https://www.fftw.org/fftw3_doc/One_002dDimensional-DFTs-of-Real-Data.html
+// In many practical applications, the input data in[i] are purely real numbers, in which case the DFT output satisfies the “Hermitian” redundancy:
+// out[i] is the conjugate of out[n-i]. It is possible to take advantage of these circumstances in order to achieve roughly a factor of two
+// improvement in both speed and memory usage. In exchange for these speed and space advantages, the user sacrifices some of the simplicity of
+// FFTW’s complex transforms. First of all, the input and output arrays are of different sizes and types: the input is n real numbers, while the
+// output is n/2+1 complex numbers (the non-redundant outputs); this also requires slight “padding” of the input array for in-place transforms.
+// Second, the inverse transform (complex to real) has the side-effect of overwriting its input array, by default. Neither of these inconveniences
+// should pose a serious problem for users, but it is important to be aware of them.
+
+enum class Backend
+{
+  FFTW,
+  IPP,
+  PFFFT,
+  PocketFFT,
+  KFR,
+  OpenCV,
+  Simd,
+};
+
+enum class Precision
+{
+  F32,
+  F64,
+};
+
+// Direct runs the backend's own real transform, FourStep decomposes it into sub-FFTs of the backend, see FourStep.hpp
+enum class Algorithm
+{
+  Direct,
+  FourStep,
+};
+
+// everything that makes two plans interchangeable, flags are the FFTW planner flags or the IPP hint
+struct PlanKey
+{
+  Backend backend;
+  usize size;
+  Precision precision = Precision::F32;
+  i32 threads = 1;
+  u32 flags = 0;
+  Algorithm algorithm = Algorithm::Direct;
+
+  auto operator<=>(const PlanKey&) const = default;
+};
+
+inline std::string GetBackendName(Backend backend)
+{
+  switch (backend)
+  {
+  case Backend::FFTW:
+    return "fftw";
+  case Backend::IPP:
+    return "ipp";
+  case Backend::PFFFT:
+    return "pffft";
+  case Backend::PocketFFT:
+    return "pocketfft";
+  case Backend::KFR:
+    return "kfr";
+  case Backend::OpenCV:
+    return "opencv";
+  case Backend::Simd:
+    return "simd";
+  }
+  return "unknown";
+}
+
+inline Backend ParseBackend(const std::string& str)
+{
+  for (const auto backend : {Backend::FFTW, Backend::IPP, Backend::PFFFT, Backend::PocketFFT, Backend::KFR, Backend::OpenCV, Backend::Simd})
+    if (GetBackendName(backend) == str)
+      return backend;
+  throw std::invalid_argument(fmt::format("Unknown backend '{}'", str));
+}
+
+inline bool IsBackendAvailable(Backend backend)
+{
+#ifndef ENABLE_KFR
+  if (backend == Backend::KFR)
+    return false;
+#endif
+#ifndef ENABLE_OPENCV
+  if (backend == Backend::OpenCV)
+    return false;
+#endif
+  return true;
+}
+
+// PFFFT only accepts sizes decomposable into 2, 3 and 5 with a SIMD-width multiple, the other backends handle every size
+inline bool IsSizeSupported(Backend backend, usize size)
+{
+  if (backend == Backend::PFFFT)
+    return pffft::Fft<f32>::nearestTransformSize(size) == static_cast<int>(size);
+  if (backend == Backend::Simd)
+    return IsSimdSizeSupported(size);
+  return true;
+}
+
+inline std::string GetFFTWFlagName(u32 flag)
+{
+  switch (flag)
+  {
+  case FFTW_ESTIMATE:
+    return "FFTW_ESTIMATE";
+  case FFTW_MEASURE:
+    return "FFTW_MEASURE";
+  case FFTW_PATIENT:
+    return "FFTW_PATIENT";
+  case FFTW_EXHAUSTIVE:
+    return "FFTW_EXHAUSTIVE";
+  default:
+    return fmt::format("FFTW_{:#x}", flag);
+  }
+}
+
+inline std::string GetIPPHintName(IppHintAlgorithm hint)
+{
+  return hint == ippAlgHintAccurate ? "IPP_ACCURATE" : "IPP_FAST";
+}
+
+inline std::string GetThreadsName(i32 nthreads)
+{
+  return fmt::format("{} {}", nthreads, nthreads == 1 ? "thread" : "threads");
+}
+
+// plan name without the thread count, e.g. "FFTW_PATIENT" or "PFFFT"
+inline std::string GetPlanBaseName(const PlanKey& key)
+{
+  switch (key.backend)
+  {
+  case Backend::FFTW:
+    return GetFFTWFlagName(key.flags);
+  case Backend::IPP:
+    return GetIPPHintName(static_cast<IppHintAlgorithm>(key.flags));
+  case Backend::PFFFT:
+    return "PFFFT";
+  case Backend::PocketFFT:
+    return "PocketFFT";
+  case Backend::KFR:
+    return "KFR";
+  case Backend::OpenCV:
+    return "OpenCV";
+  case Backend::Simd:
+    return fmt::format("SIMD {}", simdIsaName);
+  }
+  return "Unknown";
+}
+
+// benchmark name of a plan, e.g. "FFTW_PATIENT 4 threads", "PFFFT" or "PFFFT four-step 4 threads", only FFTW, IPP and the four-step
+// engine thread internally. Double precision plans carry an f64 suffix.
+inline std::string GetPlanName(const PlanKey& key)
+{
+  const auto suffix = key.precision == Precision::F64 ? " f64" : "";
+  if (key.algorithm == Algorithm::FourStep)
+    return fmt::format("{} four-step {}{}", GetPlanBaseName(key), GetThreadsName(key.threads), suffix);
+  if (key.backend == Backend::FFTW or key.backend == Backend::IPP)
+    return fmt::format("{} {}{}", GetPlanBaseName(key), GetThreadsName(key.threads), suffix);
+  return GetPlanBaseName(key) + suffix;
+}
+
+// the FFTW planner is not thread-safe, every fftw(f)_plan_* and fftw(f)_destroy_plan call has to hold this lock, only execution is thread-safe
+inline std::mutex& GetFFTWPlannerMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Real-to-complex transform planned once for a given size and executed many times. Real buffers hold size values and spectra size/2+1
+// complex values, both are owned by the caller and aligned to AlignedBuffer::alignment. PFFFT and OpenCV keep their native packed
+// layouts (Nyquist bin stored next to the DC bin) and Inverse expects whatever Forward produced. Transforms are unnormalized and Inverse may
+// overwrite its input (FFTW c2r does). In-place transforms work on a single buffer of size/2+1 complex values (the FFTW padded layout),
+// backends without native in-place support go through an internal scratch copy. Plans keep internal work buffers, so a plan must not be
+// executed concurrently.
+class FFTPlan
+{
+public:
+  explicit FFTPlan(usize size) : size(size) {}
+  virtual ~FFTPlan() = default;
+
+  virtual void Forward(const f32* input, std::complex<f32>* output) = 0;
+  virtual void Inverse(std::complex<f32>* input, f32* output) = 0;
+
+  virtual void ForwardInPlace(f32* data)
+  {
+    auto& buffer = GetScratch();
+    std::memcpy(buffer.Data(), data, size * sizeof(f32));
+    Forward(buffer.Data(), reinterpret_cast<std::complex<f32>*>(data));
+  }
+
+  virtual void InverseInPlace(f32* data)
+  {
+    auto& buffer = GetScratch();
+    std::memcpy(buffer.Data(), data, buffer.Bytes());
+    Inverse(reinterpret_cast<std::complex<f32>*>(buffer.Data()), data);
+  }
+
+  // converts the native layout written by Forward to the FFTW half spectrum of size/2+1 values, in place
+  virtual void UnpackSpectrum(std::complex<f32>* spectrum) const {}
+
+  // converts the FFTW half spectrum back to the native layout Inverse reads, in place
+  virtual void PackSpectrum(std::complex<f32>* spectrum) const {}
+
+  usize GetSize() const { return size; }
+  usize GetScratchBytes() const { return scratch.Bytes(); }
+
+protected:
+  usize size;
+  AlignedBuffer<f32> scratch;
+
+  AlignedBuffer<f32>& GetScratch()
+  {
+    if (scratch.Size() == 0)
+      scratch = AlignedBuffer<f32>(size + 2);
+    return scratch;
+  }
+};
+
+// r2c and c2r plans, out-of-place and in-place, each created on first use
+class FFTWPlan : public FFTPlan
+{
+public:
+  FFTWPlan(usize size, u32 flags, i32 nthreads) : FFTPlan(size), flags(flags), nthreads(nthreads) { GetPlan(Kind::Forward); }
+  ~FFTWPlan() override
+  {
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    for (auto plan : plans)
+      if (plan)
+        fftwf_destroy_plan(plan);
+  }
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    fftwf_execute_dft_r2c(GetPlan(Kind::Forward), const_cast<f32*>(input), reinterpret_cast<fftwf_complex*>(output));
+  }
+
+  void Inverse(std::complex<f32>* input, f32* output) override { fftwf_execute_dft_c2r(GetPlan(Kind::Inverse), reinterpret_cast<fftwf_complex*>(input), output); }
+
+  void ForwardInPlace(f32* data) override { fftwf_execute_dft_r2c(GetPlan(Kind::ForwardInPlace), data, reinterpret_cast<fftwf_complex*>(data)); }
+
+  void InverseInPlace(f32* data) override { fftwf_execute_dft_c2r(GetPlan(Kind::InverseInPlace), reinterpret_cast<fftwf_complex*>(data), data); }
+
+private:
+  enum class Kind
+  {
+    Forward,
+    Inverse,
+    ForwardInPlace,
+    InverseInPlace,
+  };
+
+  u32 flags;
+  i32 nthreads;
+  std::array<fftwf_plan, 4> plans{};
+
+  // planning with FFTW_MEASURE and above overwrites the arrays, so plan on scratch buffers and execute with the new-array interface
+  fftwf_plan GetPlan(Kind kind)
+  {
+    auto& plan = plans[static_cast<usize>(kind)];
+    if (plan)
+      return plan;
+
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    AlignedBuffer<f32> real(size + 2);
+    AlignedBuffer<std::complex<f32>> complex(size / 2 + 1);
+    const auto padded = reinterpret_cast<fftwf_complex*>(real.Data());
+    fftwf_plan_with_nthreads(nthreads);
+    switch (kind)
+    {
+    case Kind::Forward:
+      plan = fftwf_plan_dft_r2c_1d(size, real.Data(), reinterpret_cast<fftwf_complex*>(complex.Data()), flags);
+      break;
+    case Kind::Inverse:
+      plan = fftwf_plan_dft_c2r_1d(size, reinterpret_cast<fftwf_complex*>(complex.Data()), real.Data(), flags);
+      break;
+    case Kind::ForwardInPlace:
+      plan = fftwf_plan_dft_r2c_1d(size, real.Data(), padded, flags);
+      break;
+    case Kind::InverseInPlace:
+      plan = fftwf_plan_dft_c2r_1d(size, padded, real.Data(), flags);
+      break;
+    default:
+      break;
+    }
+    if (not plan)
+      throw std::runtime_error(fmt::format("Failed to create FFTW plan of size {}", size));
+    return plan;
+  }
+};
+
+// the IPP thread count is process-wide, so switch it only when a plan with a different count executes
+inline void SetIPPThreads(i32 nthreads)
+{
+  static std::atomic<i32> currentThreads = 0;
+  if (currentThreads.exchange(nthreads) != nthreads)
+    ippSetNumThreads(nthreads);
+}
+
+class IPPPlan : public FFTPlan
+{
+public:
+  IPPPlan(usize size, IppHintAlgorithm hint, i32 nthreads) : FFTPlan(size), nthreads(nthreads)
+  {
+    const auto flag = IPP_FFT_NODIV_BY_ANY;
+    int sizeDFTSpec, sizeDFTInitBuf, sizeDFTWorkBuf;
+    ippsDFTGetSize_R_32f(size, flag, hint, &sizeDFTSpec, &sizeDFTInitBuf, &sizeDFTWorkBuf);
+    pDFTSpec = (IppsDFTSpec_R_32f*)ippsMalloc_8u(sizeDFTSpec);
+    workBuffer = AlignedBuffer<u8>(sizeDFTWorkBuf);
+    auto pDFTInitBuf = ippsMalloc_8u(sizeDFTInitBuf);
+    const auto status = ippsDFTInit_R_32f(size, flag, hint, pDFTSpec, pDFTInitBuf);
+    if (pDFTInitBuf)
+      ippFree(pDFTInitBuf);
+    if (status != ippStsNoErr)
+    {
+      Free();
+      throw std::runtime_error(fmt::format("Failed to initialize IPP DFT of size {}: {}", size, ippGetStatusString(status)));
+    }
+  }
+  ~IPPPlan() override { Free(); }
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    SetIPPThreads(nthreads);
+    ippsDFTFwd_RToCCS_32f(input, reinterpret_cast<f32*>(output), pDFTSpec, workBuffer.Data());
+  }
+
+  void Inverse(std::complex<f32>* input, f32* output) override
+  {
+    SetIPPThreads(nthreads);
+    ippsDFTInv_CCSToR_32f(reinterpret_cast<const f32*>(input), output, pDFTSpec, workBuffer.Data());
+  }
+
+protected:
+  i32 nthreads;
+  IppsDFTSpec_R_32f* pDFTSpec = nullptr;
+  AlignedBuffer<u8> workBuffer;
+
+  void Free()
+  {
+    if (pDFTSpec)
+      ippFree(pDFTSpec);
+  }
+};
+
+// pffft allows the input and output to alias, so the in-place transforms need no scratch copy
+class PFFFTPlan : public FFTPlan
+{
+public:
+  explicit PFFFTPlan(usize size) : FFTPlan(size), fft(size)
+  {
+    if (!fft.isValid())
+      throw std::invalid_argument(fmt::format("Error: transformation length {} is not decomposable into small prime factors. Next valid transform size is: {}; next power of 2 is: {}", size,
+          pffft::Fft<f32>::nearestTransformSize(size), pffft::Fft<f32>::nextPowerOfTwo(size)));
+  }
+
+  void Forward(const f32* input, std::complex<f32>* output) override { fft.forward(input, output); }
+  void Inverse(std::complex<f32>* input, f32* output) override { fft.inverse(input, output); }
+  void ForwardInPlace(f32* data) override { fft.forward(data, reinterpret_cast<std::complex<f32>*>(data)); }
+  void InverseInPlace(f32* data) override { fft.inverse(reinterpret_cast<std::complex<f32>*>(data), data); }
+
+  // the Nyquist bin is stored in the imaginary part of the DC bin
+  void UnpackSpectrum(std::complex<f32>* spectrum) const override
+  {
+    spectrum[size / 2] = {spectrum[0].imag(), 0};
+    spectrum[0] = {spectrum[0].real(), 0};
+  }
+
+  void PackSpectrum(std::complex<f32>* spectrum) const override { spectrum[0] = {spectrum[0].real(), spectrum[size / 2].real()}; }
+
+protected:
+  pffft::Fft<f32> fft;
+};
+
+class PocketFFTPlan : public FFTPlan
+{
+public:
+  explicit PocketFFTPlan(usize size) : FFTPlan(size), shape{size} {}
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    pocketfft::r2c(shape, strideReal, strideComplex, axis, pocketfft::FORWARD, input, output, factor, nthreads);
+  }
+
+  void Inverse(std::complex<f32>* input, f32* output) override
+  {
+    pocketfft::c2r(shape, strideComplex, strideReal, axis, pocketfft::BACKWARD, input, output, factor, nthreads);
+  }
+
+protected:
+  pocketfft::shape_t shape;
+  const pocketfft::stride_t strideReal{sizeof(f32)};
+  const pocketfft::stride_t strideComplex{sizeof(std::complex<f32>)};
+  static constexpr size_t axis = 0;
+  static constexpr size_t nthreads = 1;
+  static constexpr f32 factor = 1;
+};
+
+#ifdef ENABLE_KFR
+class KFRPlan : public FFTPlan
+{
+public:
+  explicit KFRPlan(usize size) : FFTPlan(size), plan(size), temp(plan.temp_size) {}
+
+  void Forward(const f32* input, std::complex<f32>* output) override { plan.execute(reinterpret_cast<kfr::complex<f32>*>(output), input, temp.Data()); }
+  void Inverse(std::complex<f32>* input, f32* output) override { plan.execute(output, reinterpret_cast<const kfr::complex<f32>*>(input), temp.Data()); }
+
+protected:
+  kfr::dft_plan_real<f32> plan;
+  AlignedBuffer<u8> temp;
+};
+#endif
+
+// in-tree kernels specialized for every power of two size between simdMinSize and simdMaxSize, see SimdFFT.hpp
+template <usize N>
+class SimdPlan : public FFTPlan
+{
+public:
+  SimdPlan() : FFTPlan(N) {}
+
+  void Forward(const f32* input, std::complex<f32>* output) override { fft.Forward(input, output); }
+  void Inverse(std::complex<f32>* input, f32* output) override { fft.Inverse(input, output); }
+
+private:
+  SimdFFT<N, simdLanesFor<N>> fft;
+};
+
+template <usize N = simdMinSize>
+inline std::unique_ptr<FFTPlan> CreateSimdPlan(usize size)
+{
+  if (size == N)
+    return std::make_unique<SimdPlan<N>>();
+  if constexpr (N < simdMaxSize)
+    return CreateSimdPlan<2 * N>(size);
+  else
+    throw std::invalid_argument(fmt::format("SIMD has no kernel of size {}, only powers of two from {} to {}", size, simdMinSize, simdMaxSize));
+}
+
+#ifdef ENABLE_OPENCV
+class OpenCVPlan : public FFTPlan
+{
+public:
+  explicit OpenCVPlan(usize size) : FFTPlan(size) {}
+
+  // CCS packed output: Re0, Re1, Im1, ..., Re(N/2)
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    const cv::Mat in(1, size, CV_32F, const_cast<f32*>(input));
+    cv::Mat out(1, size, CV_32F, reinterpret_cast<f32*>(output));
+    cv::dft(in, out);
+  }
+
+  void Inverse(std::complex<f32>* input, f32* output) override
+  {
+    const cv::Mat in(1, size, CV_32F, reinterpret_cast<f32*>(input));
+    cv::Mat out(1, size, CV_32F, output);
+    cv::dft(in, out, cv::DFT_INVERSE | cv::DFT_REAL_OUTPUT);
+  }
+
+  void UnpackSpectrum(std::complex<f32>* spectrum) const override
+  {
+    auto values = reinterpret_cast<f32*>(spectrum);
+    std::memmove(values + 2, values + 1, (size - 1) * sizeof(f32));
+    values[1] = 0;
+    if (size % 2 == 0)
+      values[size + 1] = 0;
+  }
+
+  void PackSpectrum(std::complex<f32>* spectrum) const override
+  {
+    auto values = reinterpret_cast<f32*>(spectrum);
+    std::memmove(values + 1, values + 2, (size - 1) * sizeof(f32));
+  }
+};
+#endif
+
+inline std::unique_ptr<FFTPlan> CreateFourStepPlan(const PlanKey& key);
+
+inline std::unique_ptr<FFTPlan> CreatePlan(const PlanKey& key)
+{
+  if (key.precision != Precision::F32)
+    throw std::invalid_argument(fmt::format("{} is a double precision plan, see CreatePlan64", GetPlanName(key)));
+  if (key.algorithm == Algorithm::FourStep)
+    return CreateFourStepPlan(key);
+
+  switch (key.backend)
+  {
+  case Backend::FFTW:
+    return std::make_unique<FFTWPlan>(key.size, key.flags, key.threads);
+  case Backend::IPP:
+    return std::make_unique<IPPPlan>(key.size, static_cast<IppHintAlgorithm>(key.flags), key.threads);
+  case Backend::PFFFT:
+    return std::make_unique<PFFFTPlan>(key.size);
+  case Backend::PocketFFT:
+    return std::make_unique<PocketFFTPlan>(key.size);
+#ifdef ENABLE_KFR
+  case Backend::KFR:
+    return std::make_unique<KFRPlan>(key.size);
+#endif
+#ifdef ENABLE_OPENCV
+  case Backend::OpenCV:
+    return std::make_unique<OpenCVPlan>(key.size);
+#endif
+  case Backend::Simd:
+    return CreateSimdPlan(key.size);
+  default:
+    throw std::invalid_argument(fmt::format("Backend {} is not enabled in this build", GetBackendName(key.backend)));
+  }
+}
+
+#include "FourStep.hpp"
@@ -0,0 +1,264 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "Backends.hpp"
+#include "utils/MemoryTracker.hpp"
+
+// Memory layout of a batch of independent real transforms. Element j of transform b is input[b * inputDistance + j * stride] and bin k is
+// output[b * outputDistance + k * stride], distances are in reals and complex values respectively.
+struct BatchLayout
+{
+  std::string name;
+  usize stride;
+  usize inputDistance;
+  usize outputDistance;
+
+  // transforms stored back to back
+  static BatchLayout Contiguous(usize size) { return {"contiguous", 1, size, size / 2 + 1}; }
+
+  // transforms stored back to back with each one starting on an AlignedBuffer::alignment boundary
+  static BatchLayout Padded(usize size)
+  {
+    const auto round = [](usize bytes) { return (bytes + AlignedBuffer<f32>::alignment - 1) / AlignedBuffer<f32>::alignment * AlignedBuffer<f32>::alignment; };
+    return {"padded", 1, round(size * sizeof(f32)) / sizeof(f32), round((size / 2 + 1) * sizeof(std::complex<f32>)) / sizeof(std::complex<f32>)};
+  }
+
+  // element j of every transform stored next to each other, e.g. one transform per channel of a multichannel signal
+  static BatchLayout Interleaved(usize count) { return {"interleaved", count, 1, 1}; }
+
+  // any stride and distances given as strided:<stride>:<distance>[:<output distance>], the output distance defaults to the input distance
+  static BatchLayout Strided(const std::string& name, usize size, usize count)
+  {
+    const auto isNumber = [](const std::string& field) { return not field.empty() and std::ranges::all_of(field, [](char c) { return c >= '0' and c <= '9'; }); };
+    std::vector<usize> values;
+    std::istringstream fields(name.substr(name.find(':') + 1));
+    for (std::string field; std::getline(fields, field, ':');)
+      values.push_back(isNumber(field) ? std::stoull(field) : 0);
+    if ((values.size() != 2 and values.size() != 3) or std::ranges::find(values, 0) != values.end())
+      throw std::invalid_argument(fmt::format("Invalid batch layout '{}', expected strided:<stride>:<distance>[:<output distance>]", name));
+
+    const BatchLayout layout{name, values[0], values[1], values.size() == 3 ? values[2] : values[1]};
+    if (not IsDisjoint(size, count, layout.stride, layout.inputDistance) or not IsDisjoint(size / 2 + 1, count, layout.stride, layout.outputDistance))
+      throw std::invalid_argument(fmt::format("Batch layout '{}' overlaps the transforms of a batch of {} x {}", name, count, size));
+    return layout;
+  }
+
+  static BatchLayout Parse(const std::string& name, usize size, usize count)
+  {
+    if (name == "contiguous")
+      return Contiguous(size);
+    if (name == "padded")
+      return Padded(size);
+    if (name == "interleaved")
+      return Interleaved(count);
+    if (name.starts_with("strided:"))
+      return Strided(name, size, count);
+    throw std::invalid_argument(fmt::format("Unknown batch layout '{}'", name));
+  }
+
+  usize InputExtent(usize size, usize count) const { return (count - 1) * inputDistance + (size - 1) * stride + 1; }
+  usize OutputExtent(usize size, usize count) const { return (count - 1) * outputDistance + size / 2 * stride + 1; }
+
+  // count transforms of length values never share an element when every transform ends before the next one starts or all transforms fit
+  // between two consecutive elements
+  static bool IsDisjoint(usize length, usize count, usize stride, usize distance)
+  {
+    return count == 1 or distance >= (length - 1) * stride + 1 or stride >= (count - 1) * distance + 1;
+  }
+};
+
+// Batch of count real-to-complex transforms described by a BatchLayout, executed either with the library's own batching and threading
+// (native) or as an OpenMP loop over per-thread single-threaded plans.
+class BatchPlan
+{
+public:
+  BatchPlan(usize size, usize count, const BatchLayout& layout) : size(size), count(count), layout(layout) {}
+  virtual ~BatchPlan() = default;
+
+  virtual void Forward(const f32* input, std::complex<f32>* output) = 0;
+
+  usize GetSize() const { return size; }
+  usize GetCount() const { return count; }
+  const BatchLayout& GetLayout() const { return layout; }
+
+protected:
+  usize size;
+  usize count;
+  BatchLayout layout;
+};
+
+class FFTWBatchPlan : public BatchPlan
+{
+public:
+  FFTWBatchPlan(usize size, usize count, const BatchLayout& layout, u32 flags, i32 nthreads) : BatchPlan(size, count, layout)
+  {
+    AlignedBuffer<f32> input(layout.InputExtent(size, count));
+    AlignedBuffer<std::complex<f32>> output(layout.OutputExtent(size, count));
+    const int n = size;
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    fftwf_plan_with_nthreads(nthreads);
+    plan = fftwf_plan_many_dft_r2c(1, &n, count, input.Data(), nullptr, layout.stride, layout.inputDistance, reinterpret_cast<fftwf_complex*>(output.Data()), nullptr, layout.stride,
+        layout.outputDistance, flags);
+    if (not plan)
+      throw std::runtime_error(fmt::format("Failed to create FFTW plan of {} transforms of size {}", count, size));
+  }
+  ~FFTWBatchPlan() override
+  {
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    fftwf_destroy_plan(plan);
+  }
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    fftwf_execute_dft_r2c(plan, const_cast<f32*>(input), reinterpret_cast<fftwf_complex*>(output));
+  }
+
+private:
+  fftwf_plan plan;
+};
+
+class PocketFFTBatchPlan : public BatchPlan
+{
+public:
+  PocketFFTBatchPlan(usize size, usize count, const BatchLayout& layout, i32 nthreads) : BatchPlan(size, count, layout), nthreads(nthreads) {}
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    const pocketfft::shape_t shape{count, size};
+    const pocketfft::stride_t strideInput{static_cast<std::ptrdiff_t>(layout.inputDistance * sizeof(f32)), static_cast<std::ptrdiff_t>(layout.stride * sizeof(f32))};
+    const pocketfft::stride_t strideOutput{
+        static_cast<std::ptrdiff_t>(layout.outputDistance * sizeof(std::complex<f32>)), static_cast<std::ptrdiff_t>(layout.stride * sizeof(std::complex<f32>))};
+    const size_t axis = 1;
+    const f32 factor = 1;
+    pocketfft::r2c(shape, strideInput, strideOutput, axis, pocketfft::FORWARD, input, output, factor, nthreads);
+  }
+
+private:
+  usize nthreads;
+};
+
+// OpenMP loop over one single-threaded plan per thread. Transforms that are strided or not aligned are gathered into per-thread
+// scratch buffers, which is what a caller of a library without native batching would have to do.
+class LoopBatchPlan : public BatchPlan
+{
+public:
+  LoopBatchPlan(PlanKey key, usize count, const BatchLayout& layout) : BatchPlan(key.size, count, layout), nthreads(key.threads)
+  {
+    key.threads = 1;
+    for (i32 thread = 0; thread < nthreads; ++thread)
+    {
+      plans.push_back(CreatePlan(key));
+      inputScratch.emplace_back(size);
+      outputScratch.emplace_back(size / 2 + 1);
+    }
+  }
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (usize b = 0; b < count; ++b)
+    {
+      const auto thread = omp_get_thread_num();
+      const f32* in = input + b * layout.inputDistance;
+      std::complex<f32>* out = output + b * layout.outputDistance;
+      const bool gatherInput = layout.stride != 1 or not IsAligned(in);
+      const bool scatterOutput = layout.stride != 1 or not IsAligned(out);
+
+      if (gatherInput)
+      {
+        for (usize j = 0; j < size; ++j)
+          inputScratch[thread][j] = in[j * layout.stride];
+        in = inputScratch[thread].Data();
+      }
+
+      plans[thread]->Forward(in, scatterOutput ? outputScratch[thread].Data() : out);
+
+      if (scatterOutput)
+        for (usize k = 0; k < size / 2 + 1; ++k)
+          out[k * layout.stride] = outputScratch[thread][k];
+    }
+  }
+
+private:
+  i32 nthreads;
+  std::vector<std::unique_ptr<FFTPlan>> plans;
+  std::vector<AlignedBuffer<f32>> inputScratch;
+  std::vector<AlignedBuffer<std::complex<f32>>> outputScratch;
+
+  static bool IsAligned(const void* ptr) { return reinterpret_cast<uintptr_t>(ptr) % AlignedBuffer<f32>::alignment == 0; }
+};
+
+inline bool HasNativeBatching(Backend backend)
+{
+  return backend == Backend::FFTW or backend == Backend::PocketFFT;
+}
+
+inline std::unique_ptr<BatchPlan> CreateBatchPlan(const PlanKey& key, usize count, const BatchLayout& layout, bool native)
+{
+  if (not native)
+    return std::make_unique<LoopBatchPlan>(key, count, layout);
+
+  switch (key.backend)
+  {
+  case Backend::FFTW:
+    return std::make_unique<FFTWBatchPlan>(key.size, count, layout, key.flags, key.threads);
+  case Backend::PocketFFT:
+    return std::make_unique<PocketFFTBatchPlan>(key.size, count, layout, key.threads);
+  default:
+    throw std::invalid_argument(fmt::format("{} has no native batching", GetPlanBaseName(key)));
+  }
+}
+
+// Batch plan of the configuration benchmarked last. google-benchmark runs a benchmark several times in a row to find its iteration count
+// and for repetitions, those runs share the plan instead of planning again. A plan of another configuration replaces it, the previous one
+// is freed first.
+class BatchPlanCache
+{
+public:
+  static BatchPlanCache& Global()
+  {
+    static BatchPlanCache cache;
+    return cache;
+  }
+
+  std::shared_ptr<BatchPlan> Get(const PlanKey& key, usize count, const BatchLayout& layout, bool native)
+  {
+    std::scoped_lock lock(mutex);
+    if (plan and key == cachedKey and count == plan->GetCount() and layout.name == plan->GetLayout().name and native == cachedNative)
+      return plan;
+
+    plan.reset();
+    const auto heapBefore = MemoryTracker::GetCurrentBytes();
+    plan = CreateBatchPlan(key, count, layout, native);
+    const auto heapAfter = MemoryTracker::GetCurrentBytes();
+    planBytes = heapAfter > heapBefore ? heapAfter - heapBefore : 0;
+    cachedKey = key;
+    cachedNative = native;
+    return plan;
+  }
+
+  // heap retained by creating the cached plan, see MemoryTracker
+  usize GetPlanBytes() const
+  {
+    std::scoped_lock lock(mutex);
+    return planBytes;
+  }
+
+  void Clear()
+  {
+    std::scoped_lock lock(mutex);
+    plan.reset();
+  }
+
+private:
+  mutable std::mutex mutex;
+  std::shared_ptr<BatchPlan> plan;
+  PlanKey cachedKey{};
+  bool cachedNative = false;
+  usize planBytes = 0;
+};
+
+// e.g. "FFTW_MEASURE 4 threads native" or "PFFFT 4 threads omp"
+inline std::string GetBatchPlanName(const PlanKey& key, bool native)
+{
+  return fmt::format("{} {} {}", GetPlanBaseName(key), GetThreadsName(key.threads), native ? "native" : "omp");
+}
@@ -1,145 +1,1166 @@
 #pragma once
 #include "Precompiled.hpp"
+#include "Batched.hpp"
+#include "Config.hpp"
+#include "Fixtures.hpp"
+#include "CacheModes.hpp"
+#include "DoublePrecision.hpp"
+#include "Executor.hpp"
+#include "Latency.hpp"
+#include "OutOfCore.hpp"
+#include "SignalFile.hpp"
+#include "Stft.hpp"
+#include "Throughput.hpp"
+#include "Multidim.hpp"
+#include "PlanCache.hpp"
+#include "Results.hpp"
+#include "Setup.hpp"
+#include "SizeAdvisor.hpp"
+#include "utils/FFTWWisdom.hpp"
+#include "utils/Memory.hpp"
+#include "utils/MemoryTracker.hpp"
+#include "utils/PerfCounters.hpp"
 
-// from https://www.fftw.org/fftw3_doc/One_002dDimensional-DFTs-of-Real-Data.html
-// In many practical applications, the input data in[i] are purely real numbers, in which case the DFT output satisfies the “Hermitian” redundancy:
-// out[i] is the conjugate of out[n-i]. It is possible to take advantage of these circumstances in order to achieve roughly a factor of two
-// improvement in both speed and memory usage. In exchange for these speed and space advantages, the user sacrifices some of the simplicity of
-// FFTW’s complex transforms. First of all, the input and output arrays are of different sizes and types: the input is n real numbers, while the
-// output is n/2+1 complex numbers (the non-redundant outputs); this also requires slight “padding” of the input array for in-place transforms.
-// Second, the inverse transform (complex to real) has the side-effect of overwriting its input array, by default. Neither of these inconveniences
-// should pose a serious problem for users, but it is important to be aware of them.
-
-static void FFTWBenchmark(benchmark::State& state, std::vector<f32> input, u32 flags, int nthreads)
-{
-  fftwf_plan_with_nthreads(nthreads);
-  f32* inputAligned = fftwf_alloc_real(input.size());
-  fftwf_complex* outputAligned = fftwf_alloc_complex(input.size() / 2 + 1);
-  fftwf_plan plan = fftwf_plan_dft_r2c_1d(input.size(), inputAligned, outputAligned, flags);
-  std::memcpy(inputAligned, input.data(), input.size() * sizeof(f32));
+// FFTW threads of both precisions and wisdom, IPP CPU dispatch
+inline void InitBackends(const BenchmarkConfig& config)
+{
+  if (not fftwf_init_threads() or not fftw_init_threads())
+    throw std::runtime_error("Failed to initialize FFTW threads");
+
+  // wisdom turns FFTW_PATIENT planning of already measured sizes into a lookup, compare the plan cache planning time with --fft_wisdom=none
+  if (config.wisdomPath == "none")
+    ResultsStore::Global().AddContext("wisdom", "none");
+  else
+  {
+    const auto tic = std::chrono::steady_clock::now();
+    const auto status = LoadWisdom(config.wisdomPath);
+    const auto ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - tic).count();
+    fmt::print("FFTW wisdom {}: {} ({:.1f} ms)\n", config.wisdomPath, GetWisdomStatusName(status), ms);
+    ResultsStore::Global().AddContext("wisdom", GetWisdomStatusName(status));
+    ResultsStore::Global().AddContext("wisdomPath", config.wisdomPath);
+  }
+
+  ippInit();
+  const auto libVersion = ippGetLibVersion();
+  fmt::print("IPP version: {} {}\n", libVersion->Name, libVersion->Version);
+  ResultsStore::Global().AddContext("ipp", fmt::format("{} {}", libVersion->Name, libVersion->Version));
+
+  if (not PerfCounters::IsSupported())
+  {
+    std::string paranoid = "unknown";
+    std::ifstream("/proc/sys/kernel/perf_event_paranoid") >> paranoid;
+    fmt::print("Hardware counters unavailable (perf_event_paranoid {}), reporting time and flops only\n", paranoid);
+  }
+}
+
+static void SetMemoryCounters(benchmark::State& state)
+{
+  state.counters["peakRSS"] = benchmark::Counter(GetPeakResidentMemory(), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+}
+
+// heap growth since a MemoryTracker::GetCurrentBytes reading
+static usize GetHeapGrowth(usize before)
+{
+  const auto current = MemoryTracker::GetCurrentBytes();
+  return current > before ? current - before : 0;
+}
+
+// page faults of the calling thread so far
+static std::pair<i64, i64> GetPageFaults()
+{
+  rusage usage{};
+  getrusage(RUSAGE_THREAD, &usage);
+  return {usage.ru_minflt, usage.ru_majflt};
+}
+
+// Heap accounting of the timed loop, reported only when the malloc hooks are linked in. Construct it right before the loop, after the plan
+// and the caller buffers exist. workHeap is what the transforms allocate on top of them (lazily created scratch and plans, per-call
+// temporaries), peakHeap the sum of plan, caller buffers and work, i.e. the memory budget of one transform, mallocs the allocations per
+// iteration.
+class HeapCounters
+{
+public:
+  HeapCounters() : heapBefore(MemoryTracker::GetCurrentBytes()), allocationsBefore(MemoryTracker::GetAllocationCount()) { MemoryTracker::ResetPeak(); }
+
+  void Set(benchmark::State& state, usize planBytes, usize bufferBytes) const
+  {
+    if (not MemoryTracker::IsEnabled())
+      return;
+    const auto peak = MemoryTracker::GetPeakBytes();
+    const usize workBytes = peak > heapBefore ? peak - heapBefore : 0;
+    state.counters["planHeap"] = benchmark::Counter(planBytes, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+    state.counters["workHeap"] = benchmark::Counter(workBytes, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+    state.counters["peakHeap"] = benchmark::Counter(planBytes + bufferBytes + workBytes, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+    state.counters["mallocs"] = benchmark::Counter(MemoryTracker::GetAllocationCount() - allocationsBefore, benchmark::Counter::kAvgIterations);
+  }
+
+private:
+  usize heapBefore;
+  usize allocationsBefore;
+};
+
+// Hardware counters per iteration of the timed loop, omitted when perf_event_open is unavailable. Construct it right before the loop.
+// flops is the conventional 2.5 N log2(N) operation count of a real FFT as a rate, bytes/cycle relates the caller buffers touched per
+// iteration to the cycles spent on them.
+class PerfCounterScope
+{
+public:
+  PerfCounterScope() { counters.Start(); }
+
+  void Set(benchmark::State& state, f64 flopsPerIteration, usize bytesPerIteration)
+  {
+    counters.Stop();
+    state.counters["flops"] = benchmark::Counter(flopsPerIteration, benchmark::Counter::kIsIterationInvariantRate);
+    if (not counters.IsAvailable() or state.iterations() == 0)
+      return;
+
+    for (usize i = 0; i < PerfCounters::events.size(); ++i)
+      if (const auto value = counters.Read(i); value >= 0)
+        state.counters[PerfCounters::events[i].name] = benchmark::Counter(value, benchmark::Counter::kAvgIterations);
+
+    const auto cycles = counters.Read(0);
+    const auto instructions = counters.Read(1);
+    if (cycles > 0)
+    {
+      state.counters["bytes/cycle"] = static_cast<f64>(bytesPerIteration) * state.iterations() / cycles;
+      if (instructions >= 0)
+        state.counters["IPC"] = instructions / cycles;
+    }
+  }
+
+private:
+  PerfCounters counters;
+};
+
+// The cache mode selects the buffers every iteration works on, see CacheModes.hpp. With flush, the eviction between transforms is excluded
+// from the time through manual timing but not from the hardware counters, so those are omitted. The buffer strategy provides the memory
+// of the buffers and, through the plan cache keyed by it, the scratch of the plan, see BufferArena.hpp.
+static void ForwardBenchmark(benchmark::State& state, PlanKey key, CacheMode mode, PageStrategy strategy)
+{
+  const auto fixture = InputFixtures::Acquire(key.size);
+  const auto& input = *fixture;
+  const bool processStrategy = strategy == BufferArena::Global().GetStrategy();
+  const BufferStrategyScope strategyScope(strategy);
+  std::shared_ptr<FFTPlan> plan;
+  usize planBytes = 0;
+  try
+  {
+    plan = PlanCache::Global().Get(key);
+    planBytes = PlanCache::Global().GetPlanBytes(key);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+
+  const usize pairBytes = key.size * sizeof(f32) + (key.size / 2 + 1) * sizeof(std::complex<f32>);
+  const usize ringSize = mode == CacheMode::Rotate ? GetRingSize(pairBytes) : 1;
+  std::vector<AlignedBuffer<f32>> inputs;
+  std::vector<AlignedBuffer<std::complex<f32>>> outputs;
+  const auto faultsBefore = GetPageFaults();
+  for (usize i = 0; i < ringSize; ++i)
+  {
+    inputs.emplace_back(key.size);
+    outputs.emplace_back(key.size / 2 + 1);
+    std::memcpy(inputs.back().Data(), input.data(), input.size() * sizeof(f32));
+  }
+  const auto bufferFaults = GetPageFaults().first - faultsBefore.first;
+  std::optional<CacheEvictor> evictor;
+  if (mode == CacheMode::Flush)
+    evictor.emplace();
+
+  const HeapCounters heap;
+  std::optional<PerfCounterScope> perf;
+  if (mode != CacheMode::Flush)
+    perf.emplace();
+  usize index = 0;
+  const auto tic = std::chrono::steady_clock::now();
   for (auto _ : state)
-    fftwf_execute(plan);
-  fftwf_destroy_plan(plan);
-  fftwf_free(inputAligned);
-  fftwf_free(outputAligned);
-  fftwf_cleanup_threads();
-}
-
-static void PocketFFTBenchmark(benchmark::State& state, std::vector<f32> input)
-{
-  const pocketfft::shape_t shapeInput{input.size()};
-  const pocketfft::stride_t strideInput{sizeof(f32)};
-  const pocketfft::stride_t strideOutput{sizeof(std::complex<f32>)};
-  const size_t axis = 0;
-  const size_t nthreads = 1;
-  const f32 factor = 1;
-  std::vector<std::complex<f32>> output(input.size() / 2 + 1);
+  {
+    if (mode == CacheMode::Flush)
+    {
+      evictor->Evict();
+      const auto start = std::chrono::steady_clock::now();
+      plan->Forward(inputs[0].Data(), outputs[0].Data());
+      state.SetIterationTime(std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count());
+      continue;
+    }
+    plan->Forward(inputs[index].Data(), outputs[index].Data());
+    index = index + 1 == ringSize ? 0 : index + 1;
+  }
+  const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - tic).count();
+  if (perf)
+    perf->Set(state, GetFFTFlops(key.size), pairBytes);
+  heap.Set(state, planBytes, ringSize * pairBytes);
+
+  // google-benchmark calls this repeatedly with growing iteration counts, the last and longest run wins. Only warm times on the buffers of the
+  // process-wide strategy are recorded, the advisor compares sizes under the same cache and page conditions.
+  if (mode == CacheMode::Warm and processStrategy and state.iterations() > 0)
+    SizeAdvisor::Global().Record(key, seconds / state.iterations());
+  if (mode != CacheMode::Warm)
+    state.counters["workingSet"] = benchmark::Counter(ringSize * pairBytes, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+
+  // minor faults of creating the buffers, close to zero when the arena reuses buffers faulted in by a previous benchmark
+  state.counters["bufferFaults"] = bufferFaults;
+  if (strategy == PageStrategy::THP or strategy == PageStrategy::HugeTLB)
+  {
+    usize hugeBytes = 0;
+    for (usize i = 0; i < ringSize; ++i)
+      hugeBytes += std::min(BufferArena::GetHugePageBytes(inputs[i].Data()), inputs[i].Bytes()) + std::min(BufferArena::GetHugePageBytes(outputs[i].Data()), outputs[i].Bytes());
+    state.counters["hugePages"] = benchmark::Counter(hugeBytes, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  }
+  SetMemoryCounters(state);
+}
+
+// bytes of the caller buffers and of the plan scratch, i.e. the memory a transform touches besides the plan itself
+static void SetBufferCounters(benchmark::State& state, const FFTPlan& plan, usize callerBytes)
+{
+  state.counters["buffers"] = benchmark::Counter(callerBytes + plan.GetScratchBytes(), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+}
+
+// c2r of the spectrum of the shared input. The spectrum is restored before every transform because inverse transforms may overwrite their
+// input, the copy is timed for all backends so that they stay comparable. One inverse runs before the timing, so plans created on first
+// use (the FFTW c2r) are neither timed nor counted as work heap.
+static void InverseBenchmark(benchmark::State& state, PlanKey key)
+{
+  const auto fixture = InputFixtures::Acquire(key.size);
+  const auto& input = *fixture;
+  std::shared_ptr<FFTPlan> plan;
+  try
+  {
+    plan = PlanCache::Global().Get(key);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+
+  AlignedBuffer<f32> real(key.size);
+  AlignedBuffer<std::complex<f32>> spectrum(key.size / 2 + 1);
+  AlignedBuffer<std::complex<f32>> work(key.size / 2 + 1);
+  std::memcpy(real.Data(), input.data(), input.size() * sizeof(f32));
+  plan->Forward(real.Data(), spectrum.Data());
+  std::memcpy(work.Data(), spectrum.Data(), spectrum.Bytes());
+  plan->Inverse(work.Data(), real.Data());
+  const HeapCounters heap;
+  PerfCounterScope perf;
   for (auto _ : state)
-    pocketfft::r2c(shapeInput, strideInput, strideOutput, axis, pocketfft::FORWARD, input.data(), output.data(), factor, nthreads);
+  {
+    std::memcpy(work.Data(), spectrum.Data(), spectrum.Bytes());
+    plan->Inverse(work.Data(), real.Data());
+  }
+  perf.Set(state, GetFFTFlops(key.size), real.Bytes() + spectrum.Bytes() + work.Bytes());
+  heap.Set(state, PlanCache::Global().GetPlanBytes(key), real.Bytes() + spectrum.Bytes() + work.Bytes());
+  SetBufferCounters(state, *plan, real.Bytes() + spectrum.Bytes() + work.Bytes());
+  SetMemoryCounters(state);
 }
 
-static void PFFFTBenchmark(benchmark::State& state, std::vector<f32> input)
+// forward -> normalize -> inverse, the normalization stands in for the processing done on the spectrum. Out-of-place keeps the signal and the
+// spectrum in separate buffers, in-place works on a single FFTW padded buffer of size/2+1 complex values. One round trip runs before the
+// timing to create the plans of the other kinds outside of it.
+static void RoundTripBenchmark(benchmark::State& state, PlanKey key, bool inPlace)
 {
-  pffft::Fft<f32> fft(input.size());
+  const auto fixture = InputFixtures::Acquire(key.size);
+  const auto& input = *fixture;
+  std::shared_ptr<FFTPlan> plan;
+  try
+  {
+    plan = PlanCache::Global().Get(key);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+
+  const f32 scale = 1.0f / key.size;
+  const auto normalize = [scale](std::complex<f32>* spectrum, usize count)
+  {
+    for (usize k = 0; k < count; ++k)
+      spectrum[k] *= scale;
+  };
+
+  if (inPlace)
+  {
+    AlignedBuffer<f32> data(key.size + 2);
+    std::memcpy(data.Data(), input.data(), input.size() * sizeof(f32));
+    plan->ForwardInPlace(data.Data());
+    plan->InverseInPlace(data.Data());
+    std::memcpy(data.Data(), input.data(), input.size() * sizeof(f32));
+    const HeapCounters heap;
+    PerfCounterScope perf;
+    for (auto _ : state)
+    {
+      plan->ForwardInPlace(data.Data());
+      normalize(reinterpret_cast<std::complex<f32>*>(data.Data()), key.size / 2 + 1);
+      plan->InverseInPlace(data.Data());
+    }
+    perf.Set(state, 2 * GetFFTFlops(key.size), data.Bytes());
+    heap.Set(state, PlanCache::Global().GetPlanBytes(key), data.Bytes());
+    SetBufferCounters(state, *plan, data.Bytes());
+  }
+  else
+  {
+    AlignedBuffer<f32> real(key.size);
+    AlignedBuffer<std::complex<f32>> spectrum(key.size / 2 + 1);
+    std::memcpy(real.Data(), input.data(), input.size() * sizeof(f32));
+    plan->Forward(real.Data(), spectrum.Data());
+    plan->Inverse(spectrum.Data(), real.Data());
+    std::memcpy(real.Data(), input.data(), input.size() * sizeof(f32));
+    const HeapCounters heap;
+    PerfCounterScope perf;
+    for (auto _ : state)
+    {
+      plan->Forward(real.Data(), spectrum.Data());
+      normalize(spectrum.Data(), spectrum.Size());
+      plan->Inverse(spectrum.Data(), real.Data());
+    }
+    perf.Set(state, 2 * GetFFTFlops(key.size), real.Bytes() + spectrum.Bytes());
+    heap.Set(state, PlanCache::Global().GetPlanBytes(key), real.Bytes() + spectrum.Bytes());
+    SetBufferCounters(state, *plan, real.Bytes() + spectrum.Bytes());
+  }
+  SetMemoryCounters(state);
+}
 
-  if (!fft.isValid())
-    throw std::invalid_argument(fmt::format("Error: transformation length {} is not decomposable into small prime factors. Next valid transform size is: {}; next power of 2 is: {}", input.size(),
-        pffft::Fft<f32>::nearestTransformSize(input.size()), pffft::Fft<f32>::nextPowerOfTwo(input.size())));
+// Every iteration timed on its own into a histogram. With pinning, the library worker threads are created and pinned while the benchmark
+// thread may still use all configured cores, so FFTW and IPP pools spawned on first use inherit that mask, then the benchmark thread moves
+// to the first core. All of them get the previous affinity back at the end, so later benchmarks are not confined to the latency cores.
+static void LatencyBenchmark(benchmark::State& state, PlanKey key, LatencyConfig config)
+{
+  const auto fixture = InputFixtures::Acquire(key.size);
+  const auto& input = *fixture;
+  std::shared_ptr<FFTPlan> plan;
+  try
+  {
+    plan = PlanCache::Global().Get(key);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+
+  AlignedBuffer<f32> inputAligned(key.size);
+  AlignedBuffer<std::complex<f32>> outputAligned(key.size / 2 + 1);
+  std::memcpy(inputAligned.Data(), input.data(), input.size() * sizeof(f32));
+
+  const auto affinity = GetThreadAffinity();
+  if (not config.cores.empty())
+  {
+    try
+    {
+      SetThreadAffinity(config.cores);
+      plan->Forward(inputAligned.Data(), outputAligned.Data());
+      PinOpenMPThreads(config.cores, key.threads);
+      SetThreadAffinity({config.cores.front()});
+    }
+    catch (const std::exception& e)
+    {
+      UnpinOpenMPThreads(affinity, key.threads);
+      SetThreadAffinity(affinity);
+      return state.SkipWithError(e.what());
+    }
+  }
+
+  LatencyHistogram histogram;
+  {
+    const BackgroundLoad load(config.loadCores, config.loadKind);
+    for (auto _ : state)
+    {
+      const auto tic = std::chrono::steady_clock::now();
+      plan->Forward(inputAligned.Data(), outputAligned.Data());
+      histogram.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tic).count());
+    }
+  }
+  if (not config.cores.empty())
+  {
+    UnpinOpenMPThreads(affinity, key.threads);
+    SetThreadAffinity(affinity);
+  }
 
-  pffft::AlignedVector<f32> inputAligned = fft.valueVector();
-  pffft::AlignedVector<std::complex<f32>> outputAligned = fft.spectrumVector();
-  std::memcpy(inputAligned.data(), input.data(), input.size() * sizeof(f32));
+  for (const auto& [name, fraction] : {std::pair{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p99.9", 0.999}})
+    state.counters[fmt::format("{}[us]", name)] = histogram.GetPercentile(fraction) * 1e-3;
+  state.counters["max[us]"] = histogram.GetMax() * 1e-3;
+  SetMemoryCounters(state);
+}
+
+// One instance per google-benchmark thread with its own plan and buffers, like the independent streams of a server. The first instance
+// reports the aggregate transforms/s and the efficiency, the throughput per core relative to one single-threaded instance of the plan.
+// Beyond the caches, efficiency drops while bytes_per_second levels off at the memory bandwidth.
+static void ThroughputBenchmark(benchmark::State& state, PlanKey key, CoreSet cores)
+{
+  const auto instance = state.thread_index();
+  const auto affinity = GetThreadAffinity();
+  std::unique_ptr<FFTPlan> plan; // created and destroyed by all instances at once, FFTW plans serialize both on the planner lock
+  try
+  {
+    if (not cores.empty())
+      SetThreadAffinity(GetInstanceCores(cores, instance, key.threads));
+    plan = CreatePlan(key);
+  }
+  catch (const std::exception& e)
+  {
+    state.SkipWithError(e.what());
+  }
+
+  const auto fixture = InputFixtures::Acquire(key.size);
+  const auto& input = *fixture;
+  AlignedBuffer<f32> inputAligned(key.size);
+  AlignedBuffer<std::complex<f32>> outputAligned(key.size / 2 + 1);
+  std::memcpy(inputAligned.Data(), input.data(), input.size() * sizeof(f32));
+  if (plan)
+    plan->Forward(inputAligned.Data(), outputAligned.Data()); // lazy plans and first touch of the buffers outside of the timing
+
+  // every thread has to enter the loop even when skipped, the loop start and end synchronize all threads of the run
+  const auto tic = std::chrono::steady_clock::now();
   for (auto _ : state)
-    fft.forward(inputAligned, outputAligned);
+    plan->Forward(inputAligned.Data(), outputAligned.Data());
+  const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - tic).count();
+  if (not cores.empty())
+    SetThreadAffinity(affinity);
+  if (not plan)
+    return;
+
+  const auto bytes = inputAligned.Bytes() + outputAligned.Bytes();
+  state.SetBytesProcessed(state.iterations() * bytes);
+  if (instance != 0)
+    return;
+
+  if (state.threads() == 1 and key.threads == 1 and state.iterations() > 0)
+    ThroughputBaselines::Global().Record(key, seconds / state.iterations());
+  state.counters["transforms/s"] = benchmark::Counter(1, benchmark::Counter::kIsIterationInvariantRate);
+  if (const auto baseline = ThroughputBaselines::Global().Get(key); baseline > 0)
+    state.counters["efficiency"] = baseline * state.iterations() / (seconds * key.threads);
+  state.counters["workingSet"] = benchmark::Counter(state.threads() * (bytes + plan->GetScratchBytes()), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  SetMemoryCounters(state);
 }
 
-#ifdef ENABLE_KFR
-static void KFRBenchmark(benchmark::State& state, std::vector<f32> input)
+// A signal file through the plan in frames of the transform size, hop samples apart, like the offline analysis of a capture. Every pass
+// maps the file anew, so page faults, read-ahead and the conversion to f32 are part of the time, and with cold the data comes from
+// storage instead of the page cache.
+static void StreamBenchmark(benchmark::State& state, PlanKey key, StreamConfig stream)
 {
-  kfr::univector<f32> in(input.size());
-  kfr::univector<kfr::complex<f32>> out(input.size());
-  kfr::dft_plan_real<f32> plan(input.size());
-  std::memcpy(in.data(), input.data(), input.size() * sizeof(f32));
-  kfr::univector<kfr::u8> temp(plan.temp_size);
+  std::shared_ptr<FFTPlan> plan;
+  usize samples = 0, dataBytes = 0;
+  try
+  {
+    plan = PlanCache::Global().Get(key);
+    const SignalFile file(stream.path, stream.format);
+    samples = file.GetSampleCount();
+    dataBytes = file.GetDataBytes();
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+  if (samples < key.size)
+    return state.SkipWithError(fmt::format("{} has fewer than {} samples", stream.path, key.size).c_str());
 
+  const usize hop = stream.hop != 0 ? stream.hop : key.size;
+  const usize frames = (samples - key.size) / hop + 1;
+  // samples inside the frames, a hop beyond the frame size skips the samples between frames and the tail after the last frame is never read
+  const usize covered = (frames - 1) * std::min(hop, key.size) + key.size;
+  AlignedBuffer<f32> frame(key.size);
+  AlignedBuffer<std::complex<f32>> spectrum(key.size / 2 + 1);
+  const auto faultsBefore = GetPageFaults();
   for (auto _ : state)
-    plan.execute(out, in, temp);
+  {
+    if (stream.cold)
+    {
+      state.PauseTiming();
+      SignalFile::DropPageCache(stream.path);
+      state.ResumeTiming();
+    }
+    SignalFile file(stream.path, stream.format);
+    for (usize index = 0; index < frames; ++index)
+    {
+      file.Read(index * hop, key.size, frame.Data());
+      plan->Forward(frame.Data(), spectrum.Data());
+    }
+  }
+  const auto faultsAfter = GetPageFaults();
+
+  state.counters["samples/s"] = benchmark::Counter(covered, benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["frames/s"] = benchmark::Counter(frames, benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["minorFaults"] = benchmark::Counter(faultsAfter.first - faultsBefore.first, benchmark::Counter::kAvgIterations);
+  state.counters["majorFaults"] = benchmark::Counter(faultsAfter.second - faultsBefore.second, benchmark::Counter::kAvgIterations);
+  state.SetBytesProcessed(state.iterations() * covered * (dataBytes / samples));
+  SetMemoryCounters(state);
 }
-#endif
 
-#ifdef ENABLE_OPENCV
-static void OpenCVBenchmark(benchmark::State& state, std::vector<f32> input)
+// Out-of-core forward transforms through the scratch file, which is refilled before every iteration outside of the timing. The bytes
+// processed are the real input and the half spectrum as in the in-memory benchmarks, memoryRatio is the time relative to the in-memory
+// four-step plan of the same backend and threads, measured when its buffers take at most half of the physical memory.
+static void OutOfCoreBenchmark(benchmark::State& state, PlanKey key, OutOfCoreConfig config)
 {
-  std::vector<f32> outputf;
+  // the memory budget is meant for the out-of-core blocks, not for the signal and the retained buffers of the previous suites
+  InputFixtures::Clear();
+  BufferArena::Global().Trim();
+  if (IsMemoryFilesystem(config.directory))
+    return state.SkipWithError(fmt::format("{} is in memory (tmpfs), pass a directory on storage with --fft_ooc_dir", config.directory).c_str());
+  std::unique_ptr<OutOfCoreFFT> fft;
+  std::unique_ptr<FFTPlan> plan;
+  const usize physicalBytes = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+  try
+  {
+    fft = std::make_unique<OutOfCoreFFT>(key, config.directory, config.memoryBytes);
+    if (3 * key.size * sizeof(f32) <= physicalBytes / 2)
+    {
+      PlanKey memoryKey = key;
+      memoryKey.algorithm = Algorithm::FourStep;
+      plan = CreatePlan(memoryKey);
+    }
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+
+  const auto pattern = GenerateRandomVector(1 << 16);
+  const auto fill = [&](f32* input)
+  {
+    for (usize i = 0; i < key.size; i += pattern.size())
+      std::memcpy(input + i, pattern.data(), std::min(pattern.size(), key.size - i) * sizeof(f32));
+  };
+
+  f64 memorySeconds = 0;
+  if (plan)
+  {
+    AlignedBuffer<f32> input(key.size);
+    AlignedBuffer<std::complex<f32>> output(key.size / 2 + 1);
+    fill(input.Data());
+    plan->Forward(input.Data(), output.Data());
+    memorySeconds = std::numeric_limits<f64>::max();
+    for (i32 run = 0; run < 3; ++run)
+    {
+      fill(input.Data());
+      const auto start = std::chrono::steady_clock::now();
+      plan->Forward(input.Data(), output.Data());
+      memorySeconds = std::min(memorySeconds, std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count());
+    }
+    plan.reset();
+  }
+
+  f64 seconds = 0;
   for (auto _ : state)
-    cv::dft(input, outputf);
-}
-#endif
-
-static void IPPBenchmark(benchmark::State& state, std::vector<f32> input, IppHintAlgorithm hint, int nthreads)
-{
-  ippSetNumThreads(nthreads);
-  const int N = input.size();
-  const auto flag = IPP_FFT_NODIV_BY_ANY;
-  auto pSrc = ippsMalloc_32f(N);
-  auto pDst = ippsMalloc_32f(N);
-  std::memcpy(pSrc, input.data(), input.size() * sizeof(f32));
-  int sizeDFTSpec, sizeDFTInitBuf, sizeDFTWorkBuf;
-  ippsDFTGetSize_R_32f(N, flag, hint, &sizeDFTSpec, &sizeDFTInitBuf, &sizeDFTWorkBuf);
-  auto pDFTSpec = (IppsDFTSpec_R_32f*)ippsMalloc_8u(sizeDFTSpec);
-  auto pDFTInitBuf = ippsMalloc_8u(sizeDFTInitBuf);
-  auto pDFTWorkBuf = ippsMalloc_8u(sizeDFTWorkBuf);
-  ippsDFTInit_R_32f(N, flag, hint, pDFTSpec, pDFTInitBuf);
-  if (pDFTInitBuf)
-    ippFree(pDFTInitBuf);
+  {
+    state.PauseTiming();
+    fill(fft->GetInput());
+    state.ResumeTiming();
+    const auto start = std::chrono::steady_clock::now();
+    fft->Forward();
+    seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  if (memorySeconds > 0)
+    state.counters["memoryRatio"] = seconds / state.iterations() / memorySeconds;
+  state.counters["file"] = benchmark::Counter(fft->GetFileBytes(), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  state.counters["blocks"] = benchmark::Counter(fft->GetMemoryBytes(), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  state.SetBytesProcessed(state.iterations() * (key.size * sizeof(f32) + (key.size / 2 + 1) * sizeof(std::complex<f32>)));
+  SetMemoryCounters(state);
+}
+
+// Double precision forward transform of the shared input, which is exactly representable in both precisions. After the timed loop the
+// single precision plan of the same key runs as many iterations, f32Ratio is the f64 time over the f32 time. digits64 and digits32 are the
+// significant decimal digits of either spectrum against the long double reference.
+static void DoubleBenchmark(benchmark::State& state, PlanKey key)
+{
+  const auto fixture = InputFixtures::Acquire(key.size);
+  const auto& input = *fixture;
+  std::shared_ptr<FFTPlan64> plan;
+  std::shared_ptr<FFTPlan> plan32;
+  try
+  {
+    plan = PlanCache64::Global().Get(key);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+  const usize planBytes = PlanCache64::Global().GetPlanBytes(key);
+
+  PlanKey key32 = key;
+  key32.precision = Precision::F32;
+  try
+  {
+    plan32 = PlanCache::Global().Get(key32);
+  }
+  catch (const std::exception&)
+  {
+    // the ratio is omitted for sizes the single precision plan rejects
+  }
+
+  AlignedBuffer<f64> real(key.size);
+  AlignedBuffer<std::complex<f64>> spectrum(key.size / 2 + 1);
+  std::ranges::copy(input, real.Data());
+
+  const HeapCounters heap;
+  PerfCounterScope perf;
+  const auto tic = std::chrono::steady_clock::now();
+  for (auto _ : state)
+    plan->Forward(real.Data(), spectrum.Data());
+  const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - tic).count();
+  perf.Set(state, GetFFTFlops(key.size), real.Bytes() + spectrum.Bytes());
+  heap.Set(state, planBytes, real.Bytes() + spectrum.Bytes());
+
+  const auto reference = GetReferenceSpectrum(input);
+  plan->UnpackSpectrum(spectrum.Data());
+  state.counters["digits64"] = GetAccurateDigits(GetSpectrumError(spectrum.Data(), reference));
+
+  if (plan32)
+  {
+    AlignedBuffer<f32> real32(key.size);
+    AlignedBuffer<std::complex<f32>> spectrum32(key.size / 2 + 1);
+    std::memcpy(real32.Data(), input.data(), input.size() * sizeof(f32));
+    plan32->Forward(real32.Data(), spectrum32.Data());
+    const auto start = std::chrono::steady_clock::now();
+    for (benchmark::IterationCount i = 0; i < state.iterations(); ++i)
+    {
+      plan32->Forward(real32.Data(), spectrum32.Data());
+      benchmark::ClobberMemory();
+    }
+    const f64 seconds32 = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    if (seconds32 > 0)
+      state.counters["f32Ratio"] = seconds / seconds32;
+    plan32->UnpackSpectrum(spectrum32.Data());
+    state.counters["digits32"] = GetAccurateDigits(GetSpectrumError(spectrum32.Data(), reference));
+  }
+  state.SetBytesProcessed(state.iterations() * (real.Bytes() + spectrum.Bytes()));
+  SetMemoryCounters(state);
+}
+
+// One frame per iteration through the STFT stages on the shared input, which repeats every frame size samples. Pipelined runs the analysis
+// on a producer thread that fills two spectrum slots ahead of the synthesis on the benchmark thread. The latency of a frame is the time
+// from the start of its analysis to the end of its synthesis including the wait in the slots, realtime the signal duration processed per
+// second of wall time at the configured sample rate.
+static void StftBenchmark(benchmark::State& state, PlanKey key, StftKernels kernels, bool pipelined, StftConfig config)
+{
+  const usize hop = key.size / config.overlap;
+  std::unique_ptr<StftStages> stages;
+  try
+  {
+    stages = std::make_unique<StftStages>(key, hop, kernels);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+
+  struct Slot
+  {
+    AlignedBuffer<std::complex<f32>> spectrum;
+    std::chrono::steady_clock::time_point start;
+  };
+  std::array<Slot, 2> slots{Slot{AlignedBuffer<std::complex<f32>>(key.size / 2 + 1)}, Slot{AlignedBuffer<std::complex<f32>>(key.size / 2 + 1)}};
+  const auto fixture = InputFixtures::Acquire(key.size);
+  const auto& input = *fixture;
+  const auto getHop = [&](usize frame) { return input.data() + frame * hop % key.size; };
+  AlignedBuffer<f32> output(hop);
+  LatencyHistogram latency;
+
+  // the plans of the stages create their inverse on first use, one frame outside of the timing keeps that out of the histogram
+  stages->Analyze(getHop(0), slots[0].spectrum.Data());
+  stages->Synthesize(slots[0].spectrum.Data(), output.Data());
+
+  PerfCounterScope perf;
+  const auto tic = std::chrono::steady_clock::now();
+  if (not pipelined)
+  {
+    usize frame = 0;
+    for (auto _ : state)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      stages->Analyze(getHop(frame++), slots[0].spectrum.Data());
+      stages->Synthesize(slots[0].spectrum.Data(), output.Data());
+      latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+  }
+  else
+  {
+    std::counting_semaphore<3> free(2); // the two slots and the stop signal
+    std::counting_semaphore<2> ready(0);
+    std::atomic<bool> stop = false;
+    std::thread producer(
+        [&]
+        {
+          for (usize frame = 0;; ++frame)
+          {
+            free.acquire();
+            if (stop)
+              return;
+            auto& slot = slots[frame % 2];
+            slot.start = std::chrono::steady_clock::now();
+            stages->Analyze(getHop(frame), slot.spectrum.Data());
+            ready.release();
+          }
+        });
+
+    usize frame = 0;
+    for (auto _ : state)
+    {
+      ready.acquire();
+      auto& slot = slots[frame++ % 2];
+      stages->Synthesize(slot.spectrum.Data(), output.Data());
+      latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - slot.start).count());
+      free.release();
+    }
+    stop = true;
+    free.release();
+    producer.join();
+  }
+  const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - tic).count();
+  perf.Set(state, 2 * GetFFTFlops(key.size), 2 * hop * sizeof(f32));
+
+  state.counters["frames/s"] = benchmark::Counter(1, benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["realtime"] = state.iterations() * hop / config.sampleRate / seconds;
+  state.counters["p50[us]"] = latency.GetPercentile(0.5) * 1e-3;
+  state.counters["p99[us]"] = latency.GetPercentile(0.99) * 1e-3;
+  state.counters["max[us]"] = latency.GetMax() * 1e-3;
+  SetMemoryCounters(state);
+}
+
+// cold creates a fresh plan in every iteration, warm looks up a plan the cache already holds. Cold FFTW planning starts from empty wisdom
+// in every iteration, otherwise FFTW would reuse what the earlier benchmarks of the process measured; the wisdom is restored after the run.
+static void PlanBenchmark(benchmark::State& state, PlanKey key, bool warm)
+{
+  PlanCache cache(1);
+  try
+  {
+    cache.Get(key);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+
+  const bool forgetWisdom = not warm and key.backend == Backend::FFTW;
+  std::string wisdom;
+  if (forgetWisdom)
+  {
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    char* exported = fftwf_export_wisdom_to_string();
+    wisdom = exported ? exported : "";
+    std::free(exported);
+  }
+
+  for (auto _ : state)
+  {
+    if (not warm)
+    {
+      state.PauseTiming();
+      cache.Clear();
+      if (forgetWisdom)
+      {
+        std::scoped_lock lock(GetFFTWPlannerMutex());
+        fftwf_forget_wisdom();
+      }
+      state.ResumeTiming();
+    }
+    benchmark::DoNotOptimize(cache.Get(key));
+  }
+
+  if (forgetWisdom and not wisdom.empty())
+  {
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    fftwf_import_wisdom_from_string(wisdom.c_str());
+  }
+
+  const auto stats = cache.GetStats();
+  state.counters["hits"] = stats.hits;
+  state.counters["misses"] = stats.misses;
+  state.counters["planMs"] = stats.planSeconds / stats.misses * 1e3;
+}
+
+// Mixed-size jobs through the executor or one thread per job, see Executor.hpp. Every iteration runs the jobs of one load, the time is the
+// first arrival to the last completion, wait the arrival to the start of a job, latency the arrival to its completion.
+static void JobBenchmark(benchmark::State& state, PlanKey key, JobConfig config, f64 rate, bool executor)
+{
+  InputFixtures::Clear();
+  std::map<usize, std::vector<f32>> inputs;
+  for (const auto& [size, weight] : config.sizes)
+    inputs.try_emplace(size, GenerateRandomVector(size));
+  std::optional<JobExecutor> pool;
+  try
+  {
+    if (executor)
+      pool.emplace(key, config, inputs);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
 
+  const auto nanoseconds = [](auto duration) { return static_cast<u64>(std::max<i64>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0)); };
+  LatencyHistogram wait, latency;
+  f64 seconds = 0;
+  u64 seed = 0;
   for (auto _ : state)
-    ippsDFTFwd_RToCCS_32f(pSrc, pDst, pDFTSpec, pDFTWorkBuf);
+  {
+    auto jobs = GenerateJobs(config, rate, seed++);
+    const auto start = std::chrono::steady_clock::now();
+    try
+    {
+      if (executor)
+      {
+        DispatchJobs(jobs, start, [&](JobRecord& job) { pool->Submit(job); });
+        pool->Wait();
+      }
+      else
+        RunThreadPerJob(key, jobs, inputs, start);
+    }
+    catch (const std::exception& e)
+    {
+      return state.SkipWithError(e.what());
+    }
 
-  if (pDFTWorkBuf)
-    ippFree(pDFTWorkBuf);
-  if (pDFTSpec)
-    ippFree(pDFTSpec);
-  ippFree(pSrc);
-  ippFree(pDst);
+    auto last = start;
+    for (const auto& job : jobs)
+    {
+      wait.Record(nanoseconds(job.start - job.arrival));
+      latency.Record(nanoseconds(job.done - job.arrival));
+      last = std::max(last, job.done);
+    }
+    const f64 elapsed = std::chrono::duration<f64>(last - start).count();
+    state.SetIterationTime(elapsed);
+    seconds += elapsed;
+  }
+
+  state.counters["jobs/s"] = state.iterations() * config.count / seconds;
+  state.counters["wait p50[us]"] = wait.GetPercentile(0.5) * 1e-3;
+  state.counters["wait p99[us]"] = wait.GetPercentile(0.99) * 1e-3;
+  state.counters["p50[us]"] = latency.GetPercentile(0.5) * 1e-3;
+  state.counters["p99[us]"] = latency.GetPercentile(0.99) * 1e-3;
+  state.counters["max[us]"] = latency.GetMax() * 1e-3;
+  if (pool)
+  {
+    const auto stats = pool->GetStats();
+    state.counters["batch"] = stats.tasks > stats.splits ? static_cast<f64>(wait.GetCount() - stats.splits) / (stats.tasks - stats.splits) : 0;
+    state.counters["splits"] = benchmark::Counter(stats.splits, benchmark::Counter::kAvgIterations);
+    state.counters["steals"] = benchmark::Counter(stats.steals, benchmark::Counter::kAvgIterations);
+  }
+  SetMemoryCounters(state);
 }
 
-void RegisterBenchmarks()
+// time to first transform, see Setup.hpp; every iteration is one setup, cold in a fresh process, warm in this one
+static void SetupBenchmark(benchmark::State& state, PlanKey key, bool cold, std::string wisdomPath)
 {
-  static constexpr auto expmin = 8;  // 8=512
-  static constexpr auto expmax = 24; // 24=16M
-  static const auto exponents = Linspace<i32>(expmin, expmax, expmax - expmin + 1);
+  // start from the arena a fresh caller would see, without the buffers the previous suites retained already faulted in
+  InputFixtures::Clear();
+  BufferArena::Global().Trim();
+  SetupCost total;
+  for (auto _ : state)
+  {
+    SetupCost cost;
+    try
+    {
+      cost = cold ? MeasureColdSetup(key, wisdomPath) : MeasureSetup(key);
+    }
+    catch (const std::exception& e)
+    {
+      return state.SkipWithError(e.what());
+    }
+    state.SetIterationTime(cost.GetFirstTransformSeconds());
+    total.initSeconds += cost.initSeconds;
+    total.wisdomSeconds += cost.wisdomSeconds;
+    total.planSeconds += cost.planSeconds;
+    total.firstSeconds += cost.firstSeconds;
+    total.transformSeconds += cost.transformSeconds;
+    total.spawnSeconds += cost.spawnSeconds;
+    total.planBytes = std::max(total.planBytes, cost.planBytes);
+    total.residentBytes = std::max(total.residentBytes, cost.residentBytes);
+  }
 
-  for (const auto exponent : exponents)
+  const f64 n = std::max<f64>(state.iterations(), 1);
+  SetupCost mean = total;
+  for (auto* seconds : {&mean.initSeconds, &mean.wisdomSeconds, &mean.planSeconds, &mean.firstSeconds, &mean.transformSeconds, &mean.spawnSeconds})
+    *seconds /= n;
+  SetupAdvisor::Global().Record(key, cold, mean);
+
+  if (cold)
   {
-    const auto timeunit = benchmark::kMillisecond;
-    const auto size = 1 << exponent;
-    const auto input = GenerateRandomVector(size);
+    state.counters["initMs"] = mean.initSeconds * 1e3;
+    state.counters["wisdomMs"] = mean.wisdomSeconds * 1e3;
+    state.counters["spawnMs"] = mean.spawnSeconds * 1e3;
+    state.counters["setupRSS"] = benchmark::Counter(mean.residentBytes, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  }
+  state.counters["planMs"] = mean.planSeconds * 1e3;
+  state.counters["firstMs"] = mean.firstSeconds * 1e3;
+  state.counters["transformMs"] = mean.transformSeconds * 1e3;
+  state.counters["breakEven"] = mean.GetBreakEven();
+  if (MemoryTracker::IsEnabled())
+    state.counters["planHeap"] = benchmark::Counter(mean.planBytes, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+}
 
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | FFTW_MEASURE 1 thread", size).c_str(), FFTWBenchmark, input, FFTW_MEASURE, 1)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | FFTW_MEASURE 2 threads", size).c_str(), FFTWBenchmark, input, FFTW_MEASURE, 2)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | FFTW_MEASURE 3 threads", size).c_str(), FFTWBenchmark, input, FFTW_MEASURE, 3)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | FFTW_MEASURE 4 threads", size).c_str(), FFTWBenchmark, input, FFTW_MEASURE, 4)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | FFTW_PATIENT 1 thread", size).c_str(), FFTWBenchmark, input, FFTW_PATIENT, 1)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | FFTW_PATIENT 2 threads", size).c_str(), FFTWBenchmark, input, FFTW_PATIENT, 2)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | FFTW_PATIENT 3 threads", size).c_str(), FFTWBenchmark, input, FFTW_PATIENT, 3)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | FFTW_PATIENT 4 threads", size).c_str(), FFTWBenchmark, input, FFTW_PATIENT, 4)->Unit(timeunit);
+static void BatchBenchmark(benchmark::State& state, PlanKey key, usize count, std::string layoutName, bool native)
+{
+  BatchLayout layout;
+  std::shared_ptr<BatchPlan> plan;
+  try
+  {
+    layout = BatchLayout::Parse(layoutName, key.size, count);
+    plan = BatchPlanCache::Global().Get(key, count, layout, native);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
 
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | IPP 1 thread", size).c_str(), IPPBenchmark, input, ippAlgHintFast, 1)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | IPP 2 threads", size).c_str(), IPPBenchmark, input, ippAlgHintFast, 2)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | IPP 3 threads", size).c_str(), IPPBenchmark, input, ippAlgHintFast, 3)->Unit(timeunit);
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | IPP 4 threads", size).c_str(), IPPBenchmark, input, ippAlgHintFast, 4)->Unit(timeunit);
+  const auto planBytes = BatchPlanCache::Global().GetPlanBytes();
+  const auto fixture = InputFixtures::Acquire(key.size);
+  const auto& signal = *fixture;
+  AlignedBuffer<f32> input(layout.InputExtent(key.size, count));
+  AlignedBuffer<std::complex<f32>> output(layout.OutputExtent(key.size, count));
+  for (usize b = 0; b < count; ++b)
+    for (usize j = 0; j < key.size; ++j)
+      input[b * layout.inputDistance + j * layout.stride] = signal[j];
 
-    // benchmark::RegisterBenchmark(fmt::format("{:>8} | PocketFFT", size).c_str(), PocketFFTBenchmark, input)->Unit(timeunit);
+  const HeapCounters heap;
+  PerfCounterScope perf;
+  for (auto _ : state)
+    plan->Forward(input.Data(), output.Data());
+  perf.Set(state, count * GetFFTFlops(key.size), input.Bytes() + output.Bytes());
+  heap.Set(state, planBytes, input.Bytes() + output.Bytes());
 
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | PFFFT", size).c_str(), PFFFTBenchmark, input)->Unit(timeunit);
+  state.counters["transforms/s"] = benchmark::Counter(count, benchmark::Counter::kIsIterationInvariantRate);
+  state.SetBytesProcessed(state.iterations() * count * (key.size * sizeof(f32) + (key.size / 2 + 1) * sizeof(std::complex<f32>)));
+  SetMemoryCounters(state);
+}
 
-#ifdef ENABLE_KFR
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | KFR", size).c_str(), KFRBenchmark, input)->Unit(timeunit);
-#endif
+static void MultidimBenchmark(benchmark::State& state, PlanKey key, Shape shape)
+{
+  std::unique_ptr<MultidimPlan> plan;
+  const auto heapBeforePlan = MemoryTracker::GetCurrentBytes();
+  try
+  {
+    plan = CreateMultidimPlan(key, shape);
+  }
+  catch (const std::exception& e)
+  {
+    return state.SkipWithError(e.what());
+  }
+  const auto planBytes = GetHeapGrowth(heapBeforePlan);
+
+  const auto fixture = InputFixtures::Acquire(GetElementCount(shape));
+  const auto& input = *fixture;
+  AlignedBuffer<f32> inputAligned(input.size());
+  AlignedBuffer<std::complex<f32>> outputAligned(plan->GetOutputCount());
+  std::memcpy(inputAligned.Data(), input.data(), input.size() * sizeof(f32));
+  const HeapCounters heap;
+  PerfCounterScope perf;
+  for (auto _ : state)
+    plan->Forward(inputAligned.Data(), outputAligned.Data());
+  perf.Set(state, GetFFTFlops(GetElementCount(shape)), inputAligned.Bytes() + outputAligned.Bytes());
+  heap.Set(state, planBytes, inputAligned.Bytes() + outputAligned.Bytes());
+
+  state.SetBytesProcessed(state.iterations() * (inputAligned.Bytes() + outputAligned.Bytes()));
+  SetMemoryCounters(state);
+}
+
+// threadedBackends get every configured thread count, the others run single-threaded
+inline std::vector<PlanKey> GetPlanKeys(const BenchmarkConfig& config, usize size, const std::vector<Backend>& threadedBackends = {Backend::FFTW, Backend::IPP},
+                                        Precision precision = Precision::F32)
+{
+  std::vector<PlanKey> keys;
+  for (const auto backend : config.backends)
+  {
+    if (not IsBackendAvailable(backend) or not(precision == Precision::F64 ? IsDoubleSupported(backend, size) : IsSizeSupported(backend, size)))
+      continue;
+
+    std::vector<u32> flags{0};
+    if (backend == Backend::FFTW)
+      flags = config.fftwFlags;
+    if (backend == Backend::IPP)
+      flags.assign(config.ippHints.begin(), config.ippHints.end());
+    const bool threaded = std::ranges::find(threadedBackends, backend) != threadedBackends.end();
+
+    for (const auto flag : flags)
+      for (const auto nthreads : threaded ? config.threads : std::vector<i32>{1})
+        keys.push_back({.backend = backend, .size = size, .precision = precision, .threads = nthreads, .flags = flag});
+  }
+  return keys;
+}
+
+void RegisterBenchmarks(const BenchmarkConfig& config)
+{
+  const auto timeunit = benchmark::kMillisecond;
+  for (const auto size : GetForwardSizes(config))
+  {
+    for (const auto& key : GetPlanKeys(config, size))
+      for (const auto transform : config.transforms)
+      {
+        const auto name = transform == Transform::Forward ? fmt::format("{:>8} | {}", size, GetPlanName(key)) : fmt::format("{:>8} | {} | {}", size, GetPlanName(key), GetTransformName(transform));
+        switch (transform)
+        {
+        case Transform::Forward:
+          for (const auto mode : config.cacheModes)
+            for (const auto strategy : config.bufferStrategies)
+            {
+              // the cache mode unless warm and the buffer strategy when several are compared
+              std::vector<std::string> parts;
+              if (mode != CacheMode::Warm)
+                parts.push_back(GetCacheModeName(mode));
+              if (config.bufferStrategies.size() > 1)
+                parts.push_back(fmt::format("{} buffers", GetPageStrategyName(strategy)));
+              const auto variant = fmt::format("{}", fmt::join(parts, " "));
+              auto* benchmark = RegisterLabeledBenchmark(variant.empty() ? name : fmt::format("{} | {}", name, variant), {size, key, "", variant}, ForwardBenchmark, key, mode, strategy);
+              benchmark->Unit(timeunit);
+              if (mode == CacheMode::Flush)
+                benchmark->UseManualTime()->Iterations(flushIterations);
+            }
+          break;
+        case Transform::Inverse:
+          RegisterLabeledBenchmark(name, {size, key, "", GetTransformName(transform)}, InverseBenchmark, key)->Unit(timeunit);
+          break;
+        case Transform::RoundTrip:
+        case Transform::RoundTripInPlace:
+          RegisterLabeledBenchmark(name, {size, key, "", GetTransformName(transform)}, RoundTripBenchmark, key, transform == Transform::RoundTripInPlace)->Unit(timeunit);
+          break;
+        }
+      }
+
+    if (config.latency)
+      for (const auto& key : GetPlanKeys(config, size))
+      {
+        const auto variant = GetLatencyName(config.latencyConfig);
+        RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", size, GetPlanName(key), variant), {size, key, "", variant}, LatencyBenchmark, key, config.latencyConfig)
+            ->Unit(benchmark::kMicrosecond)
+            ->UseRealTime();
+      }
+
+    if (not config.instances.empty())
+    {
+      // ordered by cores so the single-threaded single instance of every plan, the efficiency baseline, runs before the others
+      std::vector<std::pair<PlanKey, i32>> runs;
+      for (const auto& key : GetPlanKeys(config, size))
+      {
+        const auto baseline = std::pair{ThroughputBaselines::GetBaselineKey(key), 1};
+        if (std::ranges::find(runs, baseline) == runs.end())
+          runs.push_back(baseline);
+        for (const auto instances : config.instances)
+          if (std::ranges::find(runs, std::pair{key, instances}) == runs.end())
+            runs.push_back({key, instances});
+      }
+      std::ranges::stable_sort(runs, {}, [](const auto& run) { return run.first.threads * run.second; });
+      for (const auto& [key, instances] : runs)
+      {
+        const auto variant = fmt::format("{} instance{}", instances, instances == 1 ? "" : "s");
+        RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", size, GetPlanName(key), variant), {size, key, "", variant}, ThroughputBenchmark, key, config.instanceCores)
+            ->Threads(instances)
+            ->Unit(timeunit)
+            ->UseRealTime();
+      }
+    }
+
+    if (config.planBenchmarks)
+      for (const auto& key : GetPlanKeys(config, size))
+        for (const bool warm : {false, true})
+        {
+          const auto variant = fmt::format("plan {}", warm ? "warm" : "cold");
+          RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", size, GetPlanName(key), variant), {size, key, "", variant}, PlanBenchmark, key, warm)->Unit(benchmark::kMicrosecond);
+        }
+  }
+
+  if (not config.stream.path.empty())
+    for (const auto size : config.streamSizes)
+      for (const auto& key : GetPlanKeys(config, size))
+      {
+        const auto variant = GetStreamName(config.stream);
+        RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", size, GetPlanName(key), variant), {size, key, "", variant}, StreamBenchmark, key, config.stream)
+            ->Unit(timeunit)
+            ->UseRealTime();
+      }
+
+  for (const auto size : config.stft.sizes)
+    for (const auto& key : GetPlanKeys(config, size))
+      for (const auto kernels : {StftKernels::Fused, StftKernels::Separate})
+        for (const bool pipelined : {false, true})
+        {
+          const auto variant = fmt::format("stft overlap {} {}{}", config.stft.overlap, GetStftKernelsName(kernels), pipelined ? " pipelined" : "");
+          RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", size, GetPlanName(key), variant), {size, key, "", variant}, StftBenchmark, key, kernels, pipelined, config.stft)
+              ->Unit(benchmark::kMicrosecond)
+              ->UseRealTime();
+        }
 
-#ifdef ENABLE_OPENCV
-    benchmark::RegisterBenchmark(fmt::format("{:>8} | OpenCV", size).c_str(), OpenCVBenchmark, input)->Unit(timeunit);
-#endif
+  // the four-step engine over every backend, all threaded by the engine, against the strongest direct plans at the same thread counts
+  const auto forwardSizes = config.fourStepSizes.empty() ? std::vector<usize>{} : GetForwardSizes(config);
+  for (const auto size : config.fourStepSizes)
+  {
+    for (auto key : GetPlanKeys(config, size, config.backends))
+    {
+      key.algorithm = Algorithm::FourStep;
+      if (IsFourStepSupported(key.backend, size))
+        RegisterLabeledBenchmark(fmt::format("{:>8} | {}", size, GetPlanName(key)), {size, key}, ForwardBenchmark, key, CacheMode::Warm, config.bufferStrategies.front())->Unit(timeunit);
+    }
+    if (std::ranges::find(forwardSizes, size) != forwardSizes.end())
+      continue; // the direct plans are registered above already
+    for (const auto nthreads : config.threads)
+      for (const PlanKey key : {PlanKey{.backend = Backend::FFTW, .size = size, .threads = nthreads, .flags = FFTW_PATIENT},
+                                PlanKey{.backend = Backend::IPP, .size = size, .threads = nthreads, .flags = config.ippHints.front()}})
+        if (config.HasBackend(key.backend) and IsSizeSupported(key.backend, size))
+          RegisterLabeledBenchmark(fmt::format("{:>8} | {}", size, GetPlanName(key)), {size, key}, ForwardBenchmark, key, CacheMode::Warm, config.bufferStrategies.front())->Unit(timeunit);
   }
+
+  for (const auto size : config.outOfCore.sizes)
+    for (auto key : GetPlanKeys(config, size, config.backends))
+      if (IsFourStepSupported(key.backend, size))
+      {
+        const auto plan = fmt::format("{} out-of-core {}", GetPlanBaseName(key), GetThreadsName(key.threads));
+        const auto variant = fmt::format("{:g} MiB", config.outOfCore.memoryBytes / 1048576.0);
+        RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", size, plan, variant), {size, key, plan, variant}, OutOfCoreBenchmark, key, config.outOfCore)
+            ->Unit(timeunit)
+            ->UseRealTime();
+      }
+
+  // the executor and its baseline on the single-threaded plans of the backends that handle every job size
+  if (not config.jobs.sizes.empty())
+    for (const auto& key : GetPlanKeys(config, config.jobs.sizes.front().first, {}))
+      if (std::ranges::all_of(config.jobs.sizes, [&](const auto& size) { return IsSizeSupported(key.backend, size.first); }))
+        for (const auto rate : config.jobs.rates)
+          for (const bool executor : {false, true})
+          {
+            const auto variant = fmt::format("jobs {} {}", GetJobRateName(rate), executor ? fmt::format("executor {} workers", config.jobs.workers) : "thread per job");
+            RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", "mixed", GetPlanName(key), variant), {0, key, "", variant}, JobBenchmark, key, config.jobs, rate, executor)
+                ->Unit(timeunit)
+                ->UseManualTime();
+          }
+
+  for (const auto size : config.setupSizes)
+    for (const auto& key : GetPlanKeys(config, size))
+      for (const bool cold : {true, false})
+      {
+        const auto variant = fmt::format("setup {}", cold ? "cold" : "warm");
+        auto* benchmark = RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", size, GetPlanName(key), variant), {size, key, "", variant}, SetupBenchmark, key, cold, config.wisdomPath);
+        benchmark->Unit(benchmark::kMillisecond)->UseManualTime();
+        if (cold)
+          benchmark->Iterations(coldSetupIterations);
+      }
+
+  for (const auto size : config.doubleSizes)
+    for (const auto& key : GetPlanKeys(config, size, {Backend::FFTW, Backend::IPP}, Precision::F64))
+      RegisterLabeledBenchmark(fmt::format("{:>8} | {}", size, GetPlanName(key)), {size, key}, DoubleBenchmark, key)->Unit(timeunit);
+
+  for (const auto& shape : config.multidimShapes)
+    for (const auto& key : GetPlanKeys(config, GetElementCount(shape), multidimThreadedBackends))
+    {
+      if (not IsMultidimSupported(key.backend, shape))
+        continue;
+      const bool threaded = std::ranges::find(multidimThreadedBackends, key.backend) != multidimThreadedBackends.end();
+      const auto name = threaded ? fmt::format("{} {}", GetPlanBaseName(key), GetThreadsName(key.threads)) : GetPlanBaseName(key);
+      const auto variant = fmt::format("{}D {}", shape.size(), GetShapeName(shape));
+      RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", GetElementCount(shape), variant, name), {GetElementCount(shape), key, name, variant}, MultidimBenchmark, key, shape)
+          ->Unit(timeunit)
+          ->UseRealTime();
+    }
+
+  for (const auto size : config.batchSizes)
+    for (const auto count : config.batchCounts)
+      for (const auto& layout : config.batchLayouts)
+        for (const auto& key : GetPlanKeys(config, size, config.backends))
+          for (const bool native : {true, false})
+            if (not native or HasNativeBatching(key.backend))
+            {
+              const auto variant = fmt::format("batch {} {}", count, layout);
+              RegisterLabeledBenchmark(fmt::format("{:>8} | {} | {}", size, variant, GetBatchPlanName(key, native)), {size, key, GetBatchPlanName(key, native), variant}, BatchBenchmark, key, count,
+                                       layout, native)
+                  ->Unit(timeunit)
+                  ->UseRealTime();
+            }
 }
\ No newline at end of file
@@ -0,0 +1,266 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "utils/MemoryTracker.hpp"
+#include <deque>
+#include <sched.h>
+#include <linux/mman.h>
+#include <sys/mman.h>
+
+// How the memory of AlignedBuffer is obtained. malloc allocates and frees every buffer, so each benchmark faults its buffers in anew. The
+// other strategies map pages and keep released buffers for the next request of the same size, so benchmarks run on buffers the previous
+// ones already faulted in: pool with 4 KiB pages (transparent huge pages disabled for them), thp with 2 MiB aligned mappings advised for
+// transparent huge pages, hugetlb with pages of the 2 MiB hugetlbfs pool (/proc/sys/vm/nr_hugepages). Buffers below 1 MiB gain little
+// from huge pages and use 4 KiB pages under every mapped strategy.
+enum class PageStrategy
+{
+  Malloc,
+  Pool,
+  THP,
+  HugeTLB,
+};
+
+inline std::string GetPageStrategyName(PageStrategy strategy)
+{
+  switch (strategy)
+  {
+  case PageStrategy::Malloc:
+    return "malloc";
+  case PageStrategy::Pool:
+    return "pool";
+  case PageStrategy::THP:
+    return "thp";
+  case PageStrategy::HugeTLB:
+    return "hugetlb";
+  }
+  return "unknown";
+}
+
+inline PageStrategy ParsePageStrategy(const std::string& str)
+{
+  static const std::map<std::string, PageStrategy> strategies{
+      {"malloc", PageStrategy::Malloc}, {"pool", PageStrategy::Pool}, {"thp", PageStrategy::THP}, {"hugetlb", PageStrategy::HugeTLB}};
+  if (const auto it = strategies.find(str); it != strategies.end())
+    return it->second;
+  throw std::invalid_argument(fmt::format("Unknown buffer strategy '{}'", str));
+}
+
+// Process-wide source of the AlignedBuffer memory, shared by the caller buffers of the benchmarks and the scratch of the plans. Memory
+// is NUMA-local by first touch: AlignedBuffer zeroes its buffer in the allocating thread, and released buffers are only handed out
+// again to threads running on the node they were faulted in on. Released buffers are kept up to the retain limit, the oldest are unmapped
+// first. Buffers in use count as heap in MemoryTracker, as the malloc strategy's do through the malloc hooks.
+class BufferArena
+{
+public:
+  static constexpr usize alignment = 64;
+  static constexpr usize pageBytes = 4096;
+  static constexpr usize hugePageBytes = 2 << 20;
+
+  struct Block
+  {
+    void* data = nullptr;
+    usize bytes = 0; // the requested size rounded up to the alignment or the pages of the strategy
+    PageStrategy strategy = PageStrategy::Malloc;
+    i32 node = 0;
+  };
+
+  struct Stats
+  {
+    usize mapped = 0;
+    usize reused = 0;
+    usize hugeTLBFallbacks = 0;
+    usize retainedBytes = 0;
+  };
+
+  static BufferArena& Global()
+  {
+    // never destroyed, buffers held by other statics (plan cache, plans of the tests) may be released after the end of main
+    static auto* arena = new BufferArena();
+    return *arena;
+  }
+
+  // strategy of the following allocations, buffers allocated before keep theirs
+  void SetStrategy(PageStrategy newStrategy) { strategy.store(newStrategy, std::memory_order_relaxed); }
+  PageStrategy GetStrategy() const { return strategy.load(std::memory_order_relaxed); }
+
+  void SetRetainLimit(usize bytes)
+  {
+    std::scoped_lock lock(mutex);
+    retainLimit = bytes;
+    Evict();
+  }
+
+  Block Allocate(usize bytes)
+  {
+    Block block{.strategy = GetStrategy(), .node = GetCurrentNode()};
+    if (block.strategy == PageStrategy::Malloc)
+    {
+      block.bytes = RoundUp(std::max(bytes, alignment), alignment);
+      block.data = std::aligned_alloc(alignment, block.bytes);
+      if (not block.data)
+        throw std::bad_alloc();
+      return block;
+    }
+
+    const bool huge = block.strategy != PageStrategy::Pool and bytes >= hugePageBytes / 2;
+    block.bytes = RoundUp(std::max(bytes, alignment), huge ? hugePageBytes : pageBytes);
+    {
+      // the most recently released buffer first, it is the most likely to be still cached
+      std::scoped_lock lock(mutex);
+      const auto it = std::find_if(released.rbegin(), released.rend(), [&](const Block& other)
+                                   { return other.bytes == block.bytes and other.strategy == block.strategy and other.node == block.node; });
+      if (it != released.rend())
+      {
+        block = *it;
+        released.erase(std::next(it).base());
+        retainedBytes -= block.bytes;
+        ++stats.reused;
+        MemoryTracker::AddExternal(block.bytes);
+        return block;
+      }
+    }
+    block.data = Map(block.bytes, block.strategy, huge);
+    {
+      std::scoped_lock lock(mutex);
+      ++stats.mapped;
+    }
+    MemoryTracker::AddExternal(block.bytes);
+    return block;
+  }
+
+  void Release(const Block& block)
+  {
+    if (not block.data)
+      return;
+    if (block.strategy == PageStrategy::Malloc)
+      return std::free(block.data);
+
+    MemoryTracker::RemoveExternal(block.bytes);
+    std::scoped_lock lock(mutex);
+    released.push_back(block);
+    retainedBytes += block.bytes;
+    Evict();
+  }
+
+  // unmaps all released buffers
+  void Trim()
+  {
+    std::scoped_lock lock(mutex);
+    for (const auto& block : released)
+      munmap(block.data, block.bytes);
+    released.clear();
+    retainedBytes = 0;
+  }
+
+  Stats GetStats() const
+  {
+    std::scoped_lock lock(mutex);
+    auto result = stats;
+    result.retainedBytes = retainedBytes;
+    return result;
+  }
+
+  // bytes of the mapping containing the address that are backed by huge pages, transparent or hugetlbfs, read from /proc/self/smaps; the
+  // kernel may merge adjacent mappings, so the value can include neighbouring buffers
+  static usize GetHugePageBytes(const void* data)
+  {
+    std::ifstream smaps("/proc/self/smaps");
+    const auto address = reinterpret_cast<uintptr_t>(data);
+    bool inside = false;
+    usize bytes = 0;
+    std::string line;
+    while (std::getline(smaps, line))
+    {
+      uintptr_t start = 0, end = 0;
+      if (std::sscanf(line.c_str(), "%lx-%lx ", &start, &end) == 2)
+      {
+        if (inside)
+          break;
+        inside = address >= start and address < end;
+        continue;
+      }
+      usize kilobytes = 0;
+      if (inside and (line.starts_with("AnonHugePages:") or line.starts_with("Private_Hugetlb:") or line.starts_with("Shared_Hugetlb:")) and
+          std::sscanf(line.c_str() + line.find(':') + 1, "%zu", &kilobytes) == 1)
+        bytes += kilobytes * 1024;
+    }
+    return bytes;
+  }
+
+private:
+  std::atomic<PageStrategy> strategy = PageStrategy::Pool;
+  mutable std::mutex mutex;
+  std::deque<Block> released; // released buffers, oldest first
+  usize retainedBytes = 0;
+  usize retainLimit = usize(1) << 31;
+  Stats stats;
+
+  BufferArena() = default;
+
+  static usize RoundUp(usize value, usize multiple) { return (value + multiple - 1) / multiple * multiple; }
+
+  static i32 GetCurrentNode()
+  {
+    unsigned cpu = 0, node = 0;
+    return getcpu(&cpu, &node) == 0 ? static_cast<i32>(node) : 0;
+  }
+
+  void Evict()
+  {
+    while (retainedBytes > retainLimit and not released.empty())
+    {
+      munmap(released.front().data, released.front().bytes);
+      retainedBytes -= released.front().bytes;
+      released.pop_front();
+    }
+  }
+
+  void* Map(usize bytes, PageStrategy blockStrategy, bool huge)
+  {
+    static constexpr int protection = PROT_READ | PROT_WRITE;
+    static constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (huge and blockStrategy == PageStrategy::HugeTLB)
+    {
+      if (void* data = mmap(nullptr, bytes, protection, flags | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0); data != MAP_FAILED)
+        return data;
+      std::scoped_lock lock(mutex);
+      if (stats.hugeTLBFallbacks++ == 0)
+        fmt::print("No 2 MiB hugetlbfs pages available (/proc/sys/vm/nr_hugepages), hugetlb buffers fall back to transparent huge pages\n");
+    }
+
+    if (huge)
+    {
+      // transparent huge pages only back 2 MiB aligned ranges, so map one huge page more and cut an aligned range out of it
+      const usize mappedBytes = bytes + hugePageBytes;
+      auto* mapped = static_cast<u8*>(mmap(nullptr, mappedBytes, protection, flags, -1, 0));
+      if (mapped == MAP_FAILED)
+        throw std::bad_alloc();
+      auto* data = reinterpret_cast<u8*>(RoundUp(reinterpret_cast<uintptr_t>(mapped), hugePageBytes));
+      if (data > mapped)
+        munmap(mapped, data - mapped);
+      if (mapped + mappedBytes > data + bytes)
+        munmap(data + bytes, mapped + mappedBytes - (data + bytes));
+      madvise(data, bytes, MADV_HUGEPAGE);
+      return data;
+    }
+
+    void* data = mmap(nullptr, bytes, protection, flags, -1, 0);
+    if (data == MAP_FAILED)
+      throw std::bad_alloc();
+    if (blockStrategy == PageStrategy::Pool)
+      madvise(data, bytes, MADV_NOHUGEPAGE); // 4 KiB pages even where transparent huge pages are enabled for all mappings
+    return data;
+  }
+};
+
+// makes the benchmark's buffers and the plans it creates use a strategy, the previous one is restored at the end of the scope
+class BufferStrategyScope
+{
+public:
+  explicit BufferStrategyScope(PageStrategy strategy) : previous(BufferArena::Global().GetStrategy()) { BufferArena::Global().SetStrategy(strategy); }
+  ~BufferStrategyScope() { BufferArena::Global().SetStrategy(previous); }
+  BufferStrategyScope(const BufferStrategyScope&) = delete;
+  BufferStrategyScope& operator=(const BufferStrategyScope&) = delete;
+
+private:
+  PageStrategy previous;
+};
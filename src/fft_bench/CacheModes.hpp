@@ -0,0 +1,81 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+
+// Cache state the forward transforms see. Warm reuses one buffer pair in a tight loop, so sizes up to a few hundred kilobytes run from
+// L1/L2. Rotate cycles through a ring of buffer pairs that together exceed the last level cache, so every transform reads input that was
+// evicted since its last use while the plan itself stays warm. Flush evicts everything including the plan's twiddles before every
+// transform, like the first transform of a frame after unrelated work.
+enum class CacheMode
+{
+  Warm,
+  Rotate,
+  Flush,
+};
+
+inline const char* GetCacheModeName(CacheMode mode)
+{
+  switch (mode)
+  {
+  case CacheMode::Warm:
+    return "warm";
+  case CacheMode::Rotate:
+    return "rotate";
+  case CacheMode::Flush:
+    return "flush";
+  }
+  return "unknown";
+}
+
+inline CacheMode ParseCacheMode(const std::string& str)
+{
+  for (const auto mode : {CacheMode::Warm, CacheMode::Rotate, CacheMode::Flush})
+    if (str == GetCacheModeName(mode))
+      return mode;
+  throw std::invalid_argument(fmt::format("Unknown cache mode '{}'", str));
+}
+
+// size of the last level data cache, 32 MiB when the system does not report it
+inline usize GetLastLevelCacheBytes()
+{
+  static const usize bytes = []
+  {
+    for (const auto level : {_SC_LEVEL4_CACHE_SIZE, _SC_LEVEL3_CACHE_SIZE, _SC_LEVEL2_CACHE_SIZE})
+      if (const auto size = sysconf(level); size > 0)
+        return static_cast<usize>(size);
+    return usize{32} << 20;
+  }();
+  return bytes;
+}
+
+// number of buffer pairs of the given size that together take twice the last level cache, at least two
+inline usize GetRingSize(usize pairBytes)
+{
+  return std::max<usize>((2 * GetLastLevelCacheBytes() + pairBytes - 1) / pairBytes, 2);
+}
+
+// Flush runs a fixed number of iterations. The eviction before every transform is excluded from the manual time, so google-benchmark would
+// size the run by the transforms alone and evict millions of times at small sizes.
+inline constexpr benchmark::IterationCount flushIterations = 200;
+
+// Writes every cache line of a buffer twice the size of the last level cache, which evicts all other data from the cache hierarchy of
+// the calling core with any replacement policy in practice.
+class CacheEvictor
+{
+public:
+  CacheEvictor() : buffer(2 * GetLastLevelCacheBytes()) {}
+
+  void Evict()
+  {
+    ++value;
+    for (usize i = 0; i < buffer.Size(); i += AlignedBuffer<u8>::alignment)
+      buffer[i] = value;
+    benchmark::ClobberMemory();
+  }
+
+  usize Bytes() const { return buffer.Bytes(); }
+
+private:
+  AlignedBuffer<u8> buffer;
+  u8 value = 0;
+};
@@ -0,0 +1,527 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "Backends.hpp"
+#include "Batched.hpp"
+#include "Executor.hpp"
+#include "CacheModes.hpp"
+#include "Latency.hpp"
+#include "Multidim.hpp"
+#include "SignalFile.hpp"
+#include "OutOfCore.hpp"
+#include "Stft.hpp"
+#include "SizeAdvisor.hpp"
+#include "utils/FFTWWisdom.hpp"
+
+// Benchmark matrix selected at runtime. Options are given either on the command line next to the google-benchmark flags
+// (--fft_sizes=2^8:2^24) or in a config file passed via --fft_config, one "fft_sizes = 2^8:2^24" per line, '#' starts a comment.
+// Command line options override the config file.
+//
+// --fft_sizes=<list>         sizes, each item is N, 2^k, A:B (powers of two from A to B) or A:B:S (A, A+S, ... up to B)
+// --fft_backends=<list>      fftw, ipp, pffft, pocketfft, kfr, opencv, simd (in-tree kernels for powers of two from 64 to 16384)
+// --fft_sweep=<list>         3smooth, 5smooth, 7smooth or prime, sizes of each family added to --fft_sizes
+// --fft_sweep_range=<A:B>    range of the sweep, default 2^8:2^16
+// --fft_sweep_density=<N>    sweep points per octave
+// --fft_advise=<list>        required lengths, measures the padding candidates of each and prints the fastest size >= length per plan
+// --fft_fftw_flags=<list>    estimate, measure, patient, exhaustive
+// --fft_ipp_hints=<list>     fast, accurate
+// --fft_threads=<list>       thread counts, each item is N, A:B or max (std::thread::hardware_concurrency)
+// --fft_transforms=<list>    forward, inverse, roundtrip (forward, normalize, inverse) or roundtrip_inplace
+// --fft_cache_modes=<list>   warm, rotate (ring of buffers exceeding the last level cache) or flush (before every transform) for forward
+// --fft_test_size=<N>        size of the correctness tests run before the benchmarks, 0 disables them
+// --fft_plan_cache=<N>       capacity of the plan cache shared by the benchmarks
+// --fft_plan_benchmarks=<b>  also measure cold planning vs warm plan cache lookups, true or false
+// --fft_batch_counts=<list>  numbers of transforms per batch for the batched throughput mode, empty disables it
+// --fft_batch_sizes=<list>   transform sizes of the batched mode, same syntax as --fft_sizes
+// --fft_batch_layouts=<list> contiguous, padded (each transform aligned), interleaved (stride = batch count, distance = 1) or
+//                            strided:<stride>:<distance>[:<output distance>], distances in reals and complex values, e.g. strided:1:4160
+// --fft_md_shapes=<list>     2D/3D shapes such as 2048x2048 or 256x256x256, empty disables the multidimensional benchmarks
+// --fft_latency=<b>          per-transform latency percentiles of the forward transforms, true or false
+// --fft_latency_cores=<list> cores such as 2-5 or 2,4: the benchmark thread runs on the first, library workers on all of them
+// --fft_latency_load=<list>  cores that run a background load during the latency benchmarks
+// --fft_latency_load_kind=<k> compute or memory (streams a 64 MiB buffer per core)
+// --fft_instances=<list>     numbers of concurrent plan instances for the throughput mode, e.g. 1:max, empty disables it
+// --fft_instance_cores=<list> cores the instances are pinned to, each instance gets as many consecutive cores as its plan has threads
+// --fft_stream=<path>        signal file streamed through every plan: raw float32, raw int16 (.i16, .s16, .pcm) or 16-bit/float WAV
+// --fft_stream_format=<f>    auto (by extension), f32, i16 or wav
+// --fft_stream_sizes=<list>  frame sizes of the streaming mode, same syntax as --fft_sizes
+// --fft_stream_hop=<N>       samples between the starts of consecutive frames, default the frame size
+// --fft_stream_cold=<b>      drop the file from the page cache before every pass, so it is read from storage
+// --fft_stft_sizes=<list>    frame sizes of the STFT pipeline benchmarks, empty disables them
+// --fft_stft_overlap=<N>     frames covering each sample, the hop is the frame size / N, default 4
+// --fft_stft_rate=<Hz>       sample rate the real-time factor refers to, default 48000
+// --fft_four_step_sizes=<list> sizes of the four-step engine over every backend, next to FFTW_PATIENT and IPP, empty disables it
+// --fft_ooc_sizes=<list>     sizes of the out-of-core transforms through a scratch file, e.g. 2^30:2^32, empty disables them
+// --fft_ooc_dir=<path>       directory of the scratch files, default data/, should be on the storage under test, not tmpfs
+// --fft_ooc_memory=<bytes>   memory for the blocks of the out-of-core passes, e.g. 2^30 (default)
+// --fft_f64_sizes=<list>     sizes of the double precision track, timed against the single precision plans, empty disables it
+// --fft_setup_sizes=<list>   sizes of the setup benchmarks, time to first transform in a fresh process and in this one, empty disables them
+// --fft_job_sizes=<list>     sizes of the job executor benchmarks, each item as in --fft_sizes with an optional relative frequency after
+//                            '@', e.g. 2^9:2^12@8,2^16:2^20, empty disables them
+// --fft_job_rates=<list>     job arrivals per second, Poisson distributed, 0 (default) submits all jobs at once
+// --fft_job_count=<N>        jobs per run, default 2000
+// --fft_job_workers=<N>      executor threads, default std::thread::hardware_concurrency
+// --fft_job_split=<N>        smallest job size split across the workers as a four-step transform, default 2^16
+// --fft_job_batch=<N>        most queued jobs of one smaller size that a worker runs as one task, default 16
+// --fft_buffers=<list>       malloc, pool (default), thp or hugetlb, memory of the buffers, see BufferArena.hpp; the first is used by every
+//                            benchmark, the forward benchmarks are repeated for the others
+// --fft_buffer_retain=<bytes> released buffers the arena keeps for reuse, default 2^31
+// --fft_results=<path>       results file with machine metadata and one JSON line per run, default ../data/fftbench.jsonl, none disables it
+// --fft_wisdom=<path>        FFTW wisdom file written by fftw_wisdom, default ../data/fftw.wisdom, none disables it
+// --fft_dispatch=<path>      dispatch table written by fft_autotune, default ../data/dispatch.table
+// --fft_config=<path>        config file
+enum class Transform
+{
+  Forward,
+  Inverse,
+  RoundTrip,
+  RoundTripInPlace,
+};
+
+inline std::string GetTransformName(Transform transform)
+{
+  switch (transform)
+  {
+  case Transform::Forward:
+    return "forward";
+  case Transform::Inverse:
+    return "inverse";
+  case Transform::RoundTrip:
+    return "roundtrip";
+  case Transform::RoundTripInPlace:
+    return "roundtrip in-place";
+  }
+  return "unknown";
+}
+
+inline Transform ParseTransform(const std::string& str)
+{
+  static const std::map<std::string, Transform> transforms{
+      {"forward", Transform::Forward}, {"inverse", Transform::Inverse}, {"roundtrip", Transform::RoundTrip}, {"roundtrip_inplace", Transform::RoundTripInPlace}};
+  if (const auto it = transforms.find(str); it != transforms.end())
+    return it->second;
+  throw std::invalid_argument(fmt::format("Unknown transform '{}'", str));
+}
+
+struct BenchmarkConfig
+{
+  std::vector<usize> sizes;
+  std::vector<Backend> backends{Backend::FFTW, Backend::IPP, Backend::PFFFT, Backend::KFR, Backend::OpenCV, Backend::Simd};
+  std::vector<u32> fftwFlags{FFTW_MEASURE, FFTW_PATIENT};
+  std::vector<IppHintAlgorithm> ippHints{ippAlgHintFast};
+  std::vector<i32> threads{1, 2, 3, 4};
+  std::vector<SizeFamily> sweepFamilies;
+  usize sweepFirst = 1 << 8;
+  usize sweepLast = 1 << 16;
+  usize sweepDensity = 4;
+  std::vector<usize> adviseLengths;
+  std::vector<Transform> transforms{Transform::Forward};
+  std::vector<CacheMode> cacheModes{CacheMode::Warm};
+  usize testSize = 1024;
+  usize planCacheCapacity = 8;
+  bool planBenchmarks = false;
+  std::vector<usize> batchCounts;
+  std::vector<usize> batchSizes{256, 512, 1024, 2048, 4096};
+  std::vector<std::string> batchLayouts{"contiguous"};
+  std::vector<Shape> multidimShapes;
+  bool latency = false;
+  LatencyConfig latencyConfig;
+  std::vector<i32> instances;
+  CoreSet instanceCores;
+  StreamConfig stream;
+  std::vector<usize> streamSizes{1024, 4096};
+  StftConfig stft;
+  std::vector<usize> fourStepSizes;
+  OutOfCoreConfig outOfCore;
+  std::vector<usize> doubleSizes;
+  std::vector<usize> setupSizes;
+  JobConfig jobs;
+  std::vector<PageStrategy> bufferStrategies{PageStrategy::Pool};
+  usize bufferRetainBytes = usize(1) << 31;
+  std::string wisdomPath = GetDefaultWisdomPath().string();
+  std::string dispatchPath = (std::filesystem::current_path().parent_path() / "data" / "dispatch.table").string();
+  std::string resultsPath = (std::filesystem::current_path().parent_path() / "data" / "fftbench.jsonl").string();
+
+  BenchmarkConfig()
+  {
+    for (usize exponent = 8; exponent <= 24; ++exponent) // 2^8=512 ... 2^24=16M
+      sizes.push_back(1 << exponent);
+  }
+
+  bool HasBackend(Backend backend) const { return std::ranges::find(backends, backend) != backends.end(); }
+};
+
+inline std::string Trim(const std::string& str)
+{
+  const auto first = str.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos)
+    return "";
+  const auto last = str.find_last_not_of(" \t\r\n");
+  return str.substr(first, last - first + 1);
+}
+
+inline std::vector<std::string> Split(const std::string& str, char delimiter)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(str);
+  std::string item;
+  while (std::getline(stream, item, delimiter))
+    if (const auto trimmed = Trim(item); not trimmed.empty())
+      items.push_back(trimmed);
+  return items;
+}
+
+template <typename T>
+std::vector<T> RemoveDuplicates(const std::vector<T>& values)
+{
+  std::vector<T> unique;
+  for (const auto& value : values)
+    if (std::ranges::find(unique, value) == unique.end())
+      unique.push_back(value);
+  return unique;
+}
+
+inline usize ParseSize(const std::string& str)
+{
+  try
+  {
+    if (const auto caret = str.find('^'); caret != std::string::npos)
+      return static_cast<usize>(std::pow(std::stoull(str.substr(0, caret)), std::stoull(str.substr(caret + 1))));
+    return std::stoull(str);
+  }
+  catch (const std::logic_error&)
+  {
+    throw std::invalid_argument(fmt::format("Invalid number '{}'", str));
+  }
+}
+
+inline std::vector<usize> ParseSizes(const std::string& str)
+{
+  std::vector<usize> sizes;
+  for (const auto& item : Split(str, ','))
+  {
+    const auto bounds = Split(item, ':');
+    if (bounds.size() == 1)
+    {
+      sizes.push_back(ParseSize(bounds[0]));
+      continue;
+    }
+    if (bounds.size() > 3)
+      throw std::invalid_argument(fmt::format("Invalid size range '{}'", item));
+
+    const auto first = ParseSize(bounds[0]);
+    const auto last = ParseSize(bounds[1]);
+    if (first == 0 or first > last)
+      throw std::invalid_argument(fmt::format("Invalid size range '{}'", item));
+    if (bounds.size() == 2)
+      for (usize size = std::bit_ceil(first); size <= last; size *= 2)
+        sizes.push_back(size);
+    else
+      for (usize size = first, step = std::max<usize>(ParseSize(bounds[2]), 1); size <= last; size += step)
+        sizes.push_back(size);
+  }
+  if (std::ranges::find(sizes, 0) != sizes.end())
+    throw std::invalid_argument("Transform size must be positive");
+  return RemoveDuplicates(sizes);
+}
+
+inline Shape ParseShape(const std::string& str)
+{
+  Shape shape;
+  std::ranges::transform(Split(str, 'x'), std::back_inserter(shape), ParseSize);
+  if (shape.size() < 2 or shape.size() > 3 or std::ranges::find(shape, 0) != shape.end())
+    throw std::invalid_argument(fmt::format("Invalid 2D/3D shape '{}'", str));
+  return shape;
+}
+
+inline std::vector<i32> ParseThreads(const std::string& str)
+{
+  const i32 maxThreads = std::max<i32>(std::thread::hardware_concurrency(), 1);
+  const auto parse = [&](const std::string& item) { return item == "max" ? maxThreads : static_cast<i32>(ParseSize(item)); };
+  std::vector<i32> threads;
+  for (const auto& item : Split(str, ','))
+  {
+    const auto bounds = Split(item, ':');
+    if (bounds.empty() or bounds.size() > 2)
+      throw std::invalid_argument(fmt::format("Invalid thread range '{}'", item));
+    for (i32 nthreads = parse(bounds.front()); nthreads <= parse(bounds.back()); ++nthreads)
+      threads.push_back(nthreads);
+  }
+  if (threads.empty() or std::ranges::any_of(threads, [](auto nthreads) { return nthreads <= 0; }))
+    throw std::invalid_argument(fmt::format("Invalid thread counts '{}'", str));
+  return RemoveDuplicates(threads);
+}
+
+inline CoreSet ParseCores(const std::string& str)
+{
+  CoreSet cores;
+  for (const auto& item : Split(str, ','))
+  {
+    const auto bounds = Split(item, '-');
+    if (bounds.empty() or bounds.size() > 2)
+      throw std::invalid_argument(fmt::format("Invalid core range '{}'", item));
+    for (auto core = ParseSize(bounds.front()); core <= ParseSize(bounds.back()); ++core)
+      cores.push_back(static_cast<i32>(core));
+  }
+  if (std::ranges::any_of(cores, [](auto core) { return core >= CPU_SETSIZE; }))
+    throw std::invalid_argument(fmt::format("Invalid cores '{}'", str));
+  return RemoveDuplicates(cores);
+}
+
+inline u32 ParseFFTWFlag(const std::string& str)
+{
+  static const std::map<std::string, u32> flags{{"estimate", FFTW_ESTIMATE}, {"measure", FFTW_MEASURE}, {"patient", FFTW_PATIENT}, {"exhaustive", FFTW_EXHAUSTIVE}};
+  if (const auto it = flags.find(str); it != flags.end())
+    return it->second;
+  throw std::invalid_argument(fmt::format("Unknown FFTW planner flag '{}'", str));
+}
+
+inline IppHintAlgorithm ParseIPPHint(const std::string& str)
+{
+  if (str == "fast")
+    return ippAlgHintFast;
+  if (str == "accurate")
+    return ippAlgHintAccurate;
+  throw std::invalid_argument(fmt::format("Unknown IPP hint '{}'", str));
+}
+
+inline bool ParseBool(const std::string& str)
+{
+  if (str == "true" or str == "1")
+    return true;
+  if (str == "false" or str == "0")
+    return false;
+  throw std::invalid_argument(fmt::format("Invalid boolean '{}'", str));
+}
+
+// sizes with an optional relative frequency after '@' each, 1 by default
+inline std::vector<std::pair<usize, f64>> ParseJobSizes(const std::string& str)
+{
+  std::vector<std::pair<usize, f64>> sizes;
+  for (const auto& item : Split(str, ','))
+  {
+    const auto at = item.find('@');
+    const f64 weight = at == std::string::npos ? 1 : std::stod(item.substr(at + 1));
+    if (not(weight > 0))
+      throw std::invalid_argument(fmt::format("Invalid job size frequency '{}'", item));
+    for (const auto size : ParseSizes(item.substr(0, at)))
+      sizes.emplace_back(size, weight);
+  }
+  return sizes;
+}
+
+// --fft_sizes followed by the sweep and the padding candidates of the advised lengths, in ascending order
+inline std::vector<usize> GetForwardSizes(const BenchmarkConfig& config)
+{
+  std::vector<usize> extra;
+  for (const auto family : config.sweepFamilies)
+    std::ranges::copy(GenerateSizeSweep(family, config.sweepFirst, config.sweepLast, config.sweepDensity), std::back_inserter(extra));
+  for (const auto length : config.adviseLengths)
+    std::ranges::copy(GetPaddingCandidates(length), std::back_inserter(extra));
+  std::ranges::sort(extra);
+
+  auto sizes = config.sizes;
+  std::ranges::copy(extra, std::back_inserter(sizes));
+  return RemoveDuplicates(sizes);
+}
+
+inline void ApplyConfigOption(BenchmarkConfig& config, const std::string& key, const std::string& value)
+{
+  if (key == "fft_sizes")
+    config.sizes = ParseSizes(value);
+  else if (key == "fft_backends")
+  {
+    config.backends.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.backends), ParseBackend);
+  }
+  else if (key == "fft_fftw_flags")
+  {
+    config.fftwFlags.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.fftwFlags), ParseFFTWFlag);
+  }
+  else if (key == "fft_ipp_hints")
+  {
+    config.ippHints.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.ippHints), ParseIPPHint);
+  }
+  else if (key == "fft_threads")
+    config.threads = ParseThreads(value);
+  else if (key == "fft_transforms")
+  {
+    config.transforms.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.transforms), ParseTransform);
+    config.transforms = RemoveDuplicates(config.transforms);
+  }
+  else if (key == "fft_cache_modes")
+  {
+    config.cacheModes.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.cacheModes), ParseCacheMode);
+    config.cacheModes = RemoveDuplicates(config.cacheModes);
+  }
+  else if (key == "fft_sweep")
+  {
+    config.sweepFamilies.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.sweepFamilies), ParseSizeFamily);
+  }
+  else if (key == "fft_sweep_range")
+  {
+    const auto bounds = Split(value, ':');
+    if (bounds.size() != 2 or ParseSize(bounds[0]) == 0 or ParseSize(bounds[0]) > ParseSize(bounds[1]))
+      throw std::invalid_argument(fmt::format("Invalid sweep range '{}'", value));
+    config.sweepFirst = ParseSize(bounds[0]);
+    config.sweepLast = ParseSize(bounds[1]);
+  }
+  else if (key == "fft_sweep_density")
+    config.sweepDensity = std::max<usize>(ParseSize(value), 1);
+  else if (key == "fft_advise")
+    config.adviseLengths = ParseSizes(value);
+  else if (key == "fft_latency")
+    config.latency = ParseBool(value);
+  else if (key == "fft_latency_cores")
+    config.latencyConfig.cores = ParseCores(value);
+  else if (key == "fft_latency_load")
+    config.latencyConfig.loadCores = ParseCores(value);
+  else if (key == "fft_latency_load_kind")
+  {
+    if (value != "compute" and value != "memory")
+      throw std::invalid_argument(fmt::format("Unknown load kind '{}'", value));
+    config.latencyConfig.loadKind = value == "compute" ? LoadKind::Compute : LoadKind::Memory;
+  }
+  else if (key == "fft_instances")
+    config.instances = ParseThreads(value);
+  else if (key == "fft_instance_cores")
+    config.instanceCores = ParseCores(value);
+  else if (key == "fft_stream")
+    config.stream.path = value;
+  else if (key == "fft_stream_format")
+    config.stream.format = ParseSignalFormat(value);
+  else if (key == "fft_stream_sizes")
+    config.streamSizes = ParseSizes(value);
+  else if (key == "fft_stream_hop")
+    config.stream.hop = ParseSize(value);
+  else if (key == "fft_stream_cold")
+    config.stream.cold = ParseBool(value);
+  else if (key == "fft_stft_sizes")
+    config.stft.sizes = ParseSizes(value);
+  else if (key == "fft_stft_overlap")
+    config.stft.overlap = ParseSize(value);
+  else if (key == "fft_stft_rate")
+    config.stft.sampleRate = std::stod(value);
+  else if (key == "fft_four_step_sizes")
+    config.fourStepSizes = ParseSizes(value);
+  else if (key == "fft_ooc_sizes")
+    config.outOfCore.sizes = ParseSizes(value);
+  else if (key == "fft_ooc_dir")
+    config.outOfCore.directory = value;
+  else if (key == "fft_ooc_memory")
+    config.outOfCore.memoryBytes = ParseSize(value);
+  else if (key == "fft_f64_sizes")
+    config.doubleSizes = ParseSizes(value);
+  else if (key == "fft_setup_sizes")
+    config.setupSizes = ParseSizes(value);
+  else if (key == "fft_job_sizes")
+    config.jobs.sizes = ParseJobSizes(value);
+  else if (key == "fft_job_rates")
+  {
+    config.jobs.rates.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.jobs.rates), [](const std::string& rate) { return std::stod(rate); });
+    if (config.jobs.rates.empty() or std::ranges::any_of(config.jobs.rates, [](f64 rate) { return not(rate >= 0); }))
+      throw std::invalid_argument(fmt::format("Invalid job rates '{}'", value));
+  }
+  else if (key == "fft_job_count")
+    config.jobs.count = std::max<usize>(ParseSize(value), 1);
+  else if (key == "fft_job_workers")
+    config.jobs.workers = ParseThreads(value).front();
+  else if (key == "fft_job_split")
+    config.jobs.splitSize = ParseSize(value);
+  else if (key == "fft_job_batch")
+    config.jobs.batchLimit = std::max<usize>(ParseSize(value), 1);
+  else if (key == "fft_buffers")
+  {
+    config.bufferStrategies.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.bufferStrategies), ParsePageStrategy);
+    config.bufferStrategies = RemoveDuplicates(config.bufferStrategies);
+    if (config.bufferStrategies.empty())
+      throw std::invalid_argument("--fft_buffers requires at least one strategy");
+  }
+  else if (key == "fft_buffer_retain")
+    config.bufferRetainBytes = ParseSize(value);
+  else if (key == "fft_wisdom")
+    config.wisdomPath = value;
+  else if (key == "fft_dispatch")
+    config.dispatchPath = value;
+  else if (key == "fft_results")
+    config.resultsPath = value;
+  else if (key == "fft_test_size")
+    config.testSize = ParseSize(value);
+  else if (key == "fft_plan_cache")
+    config.planCacheCapacity = ParseSize(value);
+  else if (key == "fft_plan_benchmarks")
+    config.planBenchmarks = ParseBool(value);
+  else if (key == "fft_batch_counts")
+    config.batchCounts = ParseSizes(value);
+  else if (key == "fft_batch_sizes")
+    config.batchSizes = ParseSizes(value);
+  else if (key == "fft_md_shapes")
+  {
+    config.multidimShapes.clear();
+    std::ranges::transform(Split(value, ','), std::back_inserter(config.multidimShapes), ParseShape);
+  }
+  else if (key == "fft_batch_layouts")
+  {
+    config.batchLayouts = Split(value, ',');
+    for (const auto& layout : config.batchLayouts)
+      BatchLayout::Parse(layout, 1, 1);
+  }
+  else
+    throw std::invalid_argument(fmt::format("Unknown option '{}'", key));
+}
+
+inline void LoadConfigFile(BenchmarkConfig& config, const std::filesystem::path& path)
+{
+  std::ifstream file(path);
+  if (not file)
+    throw std::runtime_error(fmt::format("Failed to open config file {}", path.string()));
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    line = Trim(line.substr(0, line.find('#')));
+    if (line.empty())
+      continue;
+    const auto separator = line.find('=');
+    if (separator == std::string::npos)
+      throw std::invalid_argument(fmt::format("Invalid config line '{}'", line));
+    ApplyConfigOption(config, Trim(line.substr(0, separator)), Trim(line.substr(separator + 1)));
+  }
+}
+
+// consumes the --fft_* options and leaves the remaining arguments for benchmark::Initialize
+inline BenchmarkConfig ParseConfig(int& argc, char** argv)
+{
+  BenchmarkConfig config;
+  std::vector<std::pair<std::string, std::string>> options;
+  int remaining = 1;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    if (not arg.starts_with("--fft_"))
+    {
+      argv[remaining++] = argv[i];
+      continue;
+    }
+    const auto separator = arg.find('=');
+    if (separator == std::string::npos)
+      throw std::invalid_argument(fmt::format("Option '{}' requires a value", arg));
+    options.emplace_back(arg.substr(2, separator - 2), arg.substr(separator + 1));
+  }
+  argc = remaining;
+  argv[argc] = nullptr;
+
+  for (const auto& [key, value] : options)
+    if (key == "fft_config")
+      LoadConfigFile(config, value);
+  for (const auto& [key, value] : options)
+    if (key != "fft_config")
+      ApplyConfigOption(config, key, value);
+  return config;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "Backends.hpp"
+#include "PlanCache.hpp"
+#include "utils/FFTWWisdom.hpp"
+
+// Fastest plan per transform size as measured by fft_autotune. The file starts with the machine key of the host it was measured on,
+// followed by one "size backend flags threads" line per size. Sizes without an entry use the entry of the nearest measured size.
+class DispatchTable
+{
+public:
+  void Set(const PlanKey& key) { entries[key.size] = key; }
+  bool Empty() const { return entries.empty(); }
+  const std::map<usize, PlanKey>& GetEntries() const { return entries; }
+
+  // nearest entry in log2 distance whose backend supports the size, PocketFFT when there is none
+  PlanKey Lookup(usize size) const
+  {
+    if (const auto it = entries.find(size); it != entries.end())
+      return it->second;
+
+    PlanKey best{.backend = Backend::PocketFFT, .size = size};
+    f64 bestDistance = std::numeric_limits<f64>::infinity();
+    for (const auto& [entrySize, key] : entries)
+    {
+      const f64 distance = std::abs(std::log2(static_cast<f64>(entrySize) / size));
+      if (distance < bestDistance and IsBackendAvailable(key.backend) and IsSizeSupported(key.backend, size))
+      {
+        best = key;
+        best.size = size;
+        bestDistance = distance;
+      }
+    }
+    return best;
+  }
+
+  void Save(const std::filesystem::path& path) const
+  {
+    std::ofstream file(path);
+    file << GetMachineKey() << "\n";
+    for (const auto& [size, key] : entries)
+      file << fmt::format("{} {} {} {}\n", size, GetBackendName(key.backend), key.flags, key.threads);
+    if (not file)
+      throw std::runtime_error(fmt::format("Failed to write dispatch table to {}", path.string()));
+  }
+
+  static DispatchTable Load(const std::filesystem::path& path)
+  {
+    std::ifstream file(path);
+    if (not file)
+      throw std::runtime_error(fmt::format("Failed to open dispatch table {}", path.string()));
+
+    std::string line;
+    std::getline(file, line);
+    if (line != GetMachineKey())
+      throw std::runtime_error(fmt::format("Dispatch table {} was measured on another machine: {}", path.string(), line));
+
+    DispatchTable table;
+    while (std::getline(file, line))
+    {
+      std::istringstream stream(line);
+      PlanKey key;
+      std::string backend;
+      if (not(stream >> key.size >> backend >> key.flags >> key.threads))
+        throw std::runtime_error(fmt::format("Invalid dispatch table line '{}'", line));
+      key.backend = ParseBackend(backend);
+      table.Set(key);
+    }
+    return table;
+  }
+
+private:
+  std::map<usize, PlanKey> entries;
+};
+
+// Real-to-complex forward transform of any size routed to the plan the dispatch table measured fastest for that size. The output is always
+// the FFTW half spectrum of size/2+1 values regardless of the backend's native layout. Plans are kept in an own cache and executed without
+// locking, so use one instance per thread.
+class DispatchingFFT
+{
+public:
+  explicit DispatchingFFT(DispatchTable table, usize planCacheCapacity = 8) : table(std::move(table)), cache(planCacheCapacity) {}
+
+  void Forward(const f32* input, std::complex<f32>* output, usize size)
+  {
+    const auto plan = cache.Get(table.Lookup(size));
+    plan->Forward(input, output);
+    plan->UnpackSpectrum(output);
+  }
+
+  PlanKey GetPlanKey(usize size) const { return table.Lookup(size); }
+
+private:
+  DispatchTable table;
+  PlanCache cache;
+};
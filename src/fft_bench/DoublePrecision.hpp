@@ -0,0 +1,261 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+#include "Backends.hpp"
+
+// Double precision counterpart of FFTPlan for the backends that ship one: the double FFTW build, IPP _64f, pffft::Fft<double>, PocketFFT
+// and KFR. Same contract as FFTPlan (unnormalized, caller-owned aligned buffers, native spectrum layout, no concurrent execution) without
+// the in-place transforms. The in-tree SIMD kernels and OpenCV stay single precision.
+class FFTPlan64
+{
+public:
+  explicit FFTPlan64(usize size) : size(size) {}
+  virtual ~FFTPlan64() = default;
+
+  virtual void Forward(const f64* input, std::complex<f64>* output) = 0;
+  virtual void Inverse(std::complex<f64>* input, f64* output) = 0;
+
+  // converts the native layout written by Forward to the FFTW half spectrum of size/2+1 values, in place
+  virtual void UnpackSpectrum(std::complex<f64>* spectrum) const {}
+
+  usize GetSize() const { return size; }
+
+protected:
+  usize size;
+};
+
+class FFTWPlan64 : public FFTPlan64
+{
+public:
+  FFTWPlan64(usize size, u32 flags, i32 nthreads) : FFTPlan64(size)
+  {
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    AlignedBuffer<f64> real(size);
+    AlignedBuffer<std::complex<f64>> complex(size / 2 + 1);
+    fftw_plan_with_nthreads(nthreads);
+    forward = fftw_plan_dft_r2c_1d(size, real.Data(), reinterpret_cast<fftw_complex*>(complex.Data()), flags);
+    inverse = fftw_plan_dft_c2r_1d(size, reinterpret_cast<fftw_complex*>(complex.Data()), real.Data(), flags);
+    if (not forward or not inverse)
+    {
+      Free();
+      throw std::runtime_error(fmt::format("Failed to create double FFTW plan of size {}", size));
+    }
+  }
+  ~FFTWPlan64() override
+  {
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    Free();
+  }
+
+  void Forward(const f64* input, std::complex<f64>* output) override
+  {
+    fftw_execute_dft_r2c(forward, const_cast<f64*>(input), reinterpret_cast<fftw_complex*>(output));
+  }
+
+  void Inverse(std::complex<f64>* input, f64* output) override { fftw_execute_dft_c2r(inverse, reinterpret_cast<fftw_complex*>(input), output); }
+
+private:
+  fftw_plan forward = nullptr;
+  fftw_plan inverse = nullptr;
+
+  // with the planner lock held
+  void Free()
+  {
+    if (forward)
+      fftw_destroy_plan(forward);
+    if (inverse)
+      fftw_destroy_plan(inverse);
+  }
+};
+
+class IPPPlan64 : public FFTPlan64
+{
+public:
+  IPPPlan64(usize size, IppHintAlgorithm hint, i32 nthreads) : FFTPlan64(size), nthreads(nthreads)
+  {
+    const auto flag = IPP_FFT_NODIV_BY_ANY;
+    int sizeDFTSpec, sizeDFTInitBuf, sizeDFTWorkBuf;
+    ippsDFTGetSize_R_64f(size, flag, hint, &sizeDFTSpec, &sizeDFTInitBuf, &sizeDFTWorkBuf);
+    pDFTSpec = (IppsDFTSpec_R_64f*)ippsMalloc_8u(sizeDFTSpec);
+    workBuffer = AlignedBuffer<u8>(sizeDFTWorkBuf);
+    auto pDFTInitBuf = ippsMalloc_8u(sizeDFTInitBuf);
+    const auto status = ippsDFTInit_R_64f(size, flag, hint, pDFTSpec, pDFTInitBuf);
+    if (pDFTInitBuf)
+      ippFree(pDFTInitBuf);
+    if (status != ippStsNoErr)
+    {
+      Free();
+      throw std::runtime_error(fmt::format("Failed to initialize double IPP DFT of size {}: {}", size, ippGetStatusString(status)));
+    }
+  }
+  ~IPPPlan64() override { Free(); }
+
+  void Forward(const f64* input, std::complex<f64>* output) override
+  {
+    SetIPPThreads(nthreads);
+    ippsDFTFwd_RToCCS_64f(input, reinterpret_cast<f64*>(output), pDFTSpec, workBuffer.Data());
+  }
+
+  void Inverse(std::complex<f64>* input, f64* output) override
+  {
+    SetIPPThreads(nthreads);
+    ippsDFTInv_CCSToR_64f(reinterpret_cast<const f64*>(input), output, pDFTSpec, workBuffer.Data());
+  }
+
+private:
+  i32 nthreads;
+  IppsDFTSpec_R_64f* pDFTSpec = nullptr;
+  AlignedBuffer<u8> workBuffer;
+
+  void Free()
+  {
+    if (pDFTSpec)
+      ippFree(pDFTSpec);
+  }
+};
+
+// the double pffft build processes half as many values per SIMD register, the size requirements follow from that
+class PFFFTPlan64 : public FFTPlan64
+{
+public:
+  explicit PFFFTPlan64(usize size) : FFTPlan64(size), fft(size)
+  {
+    if (not fft.isValid())
+      throw std::invalid_argument(fmt::format("Error: transformation length {} is not supported by double pffft. Next valid transform size is: {}", size,
+          pffft::Fft<f64>::nearestTransformSize(size)));
+  }
+
+  void Forward(const f64* input, std::complex<f64>* output) override { fft.forward(input, output); }
+  void Inverse(std::complex<f64>* input, f64* output) override { fft.inverse(input, output); }
+
+  void UnpackSpectrum(std::complex<f64>* spectrum) const override
+  {
+    spectrum[size / 2] = {spectrum[0].imag(), 0};
+    spectrum[0] = {spectrum[0].real(), 0};
+  }
+
+private:
+  pffft::Fft<f64> fft;
+};
+
+// PocketFFT in any floating point type, long double serves as the accuracy reference
+template <typename T>
+class PocketFFTPlanT
+{
+public:
+  explicit PocketFFTPlanT(usize size) : shape{size} {}
+
+  void Forward(const T* input, std::complex<T>* output) const
+  {
+    pocketfft::r2c(shape, strideReal, strideComplex, axis, pocketfft::FORWARD, input, output, static_cast<T>(1), nthreads);
+  }
+
+  void Inverse(const std::complex<T>* input, T* output) const
+  {
+    pocketfft::c2r(shape, strideComplex, strideReal, axis, pocketfft::BACKWARD, input, output, static_cast<T>(1), nthreads);
+  }
+
+private:
+  pocketfft::shape_t shape;
+  const pocketfft::stride_t strideReal{sizeof(T)};
+  const pocketfft::stride_t strideComplex{sizeof(std::complex<T>)};
+  static constexpr size_t axis = 0;
+  static constexpr size_t nthreads = 1;
+};
+
+class PocketFFTPlan64 : public FFTPlan64
+{
+public:
+  explicit PocketFFTPlan64(usize size) : FFTPlan64(size), plan(size) {}
+
+  void Forward(const f64* input, std::complex<f64>* output) override { plan.Forward(input, output); }
+  void Inverse(std::complex<f64>* input, f64* output) override { plan.Inverse(input, output); }
+
+private:
+  PocketFFTPlanT<f64> plan;
+};
+
+#ifdef ENABLE_KFR
+class KFRPlan64 : public FFTPlan64
+{
+public:
+  explicit KFRPlan64(usize size) : FFTPlan64(size), plan(size), temp(plan.temp_size) {}
+
+  void Forward(const f64* input, std::complex<f64>* output) override { plan.execute(reinterpret_cast<kfr::complex<f64>*>(output), input, temp.Data()); }
+  void Inverse(std::complex<f64>* input, f64* output) override { plan.execute(output, reinterpret_cast<const kfr::complex<f64>*>(input), temp.Data()); }
+
+private:
+  kfr::dft_plan_real<f64> plan;
+  AlignedBuffer<u8> temp;
+};
+#endif
+
+// the double pffft build has its own size rule, see PFFFTPlan64
+inline bool IsDoubleSupported(Backend backend, usize size)
+{
+  switch (backend)
+  {
+  case Backend::FFTW:
+  case Backend::IPP:
+  case Backend::PocketFFT:
+    return true;
+  case Backend::PFFFT:
+    return pffft::Fft<f64>::nearestTransformSize(size) == static_cast<int>(size);
+  case Backend::KFR:
+    return IsBackendAvailable(backend);
+  default:
+    return false;
+  }
+}
+
+inline std::unique_ptr<FFTPlan64> CreatePlan64(const PlanKey& key)
+{
+  if (key.precision != Precision::F64 or key.algorithm != Algorithm::Direct)
+    throw std::invalid_argument(fmt::format("{} is not a direct double precision plan", GetPlanName(key)));
+
+  switch (key.backend)
+  {
+  case Backend::FFTW:
+    return std::make_unique<FFTWPlan64>(key.size, key.flags, key.threads);
+  case Backend::IPP:
+    return std::make_unique<IPPPlan64>(key.size, static_cast<IppHintAlgorithm>(key.flags), key.threads);
+  case Backend::PFFFT:
+    return std::make_unique<PFFFTPlan64>(key.size);
+  case Backend::PocketFFT:
+    return std::make_unique<PocketFFTPlan64>(key.size);
+#ifdef ENABLE_KFR
+  case Backend::KFR:
+    return std::make_unique<KFRPlan64>(key.size);
+#endif
+  default:
+    throw std::invalid_argument(fmt::format("Backend {} has no double precision plans", GetBackendName(key.backend)));
+  }
+}
+
+// half spectrum of the input computed in long double, the reference both precisions are measured against
+inline std::vector<std::complex<f128>> GetReferenceSpectrum(const std::vector<f32>& input)
+{
+  const std::vector<f128> real(input.begin(), input.end());
+  std::vector<std::complex<f128>> spectrum(input.size() / 2 + 1);
+  PocketFFTPlanT<f128>(input.size()).Forward(real.data(), spectrum.data());
+  return spectrum;
+}
+
+// relative RMS error of a half spectrum in the FFTW layout against the reference
+template <typename T>
+f64 GetSpectrumError(const std::complex<T>* spectrum, const std::vector<std::complex<f128>>& reference)
+{
+  f128 error = 0, norm = 0;
+  for (usize k = 0; k < reference.size(); ++k)
+  {
+    error += std::norm(std::complex<f128>(spectrum[k].real(), spectrum[k].imag()) - reference[k]);
+    norm += std::norm(reference[k]);
+  }
+  return norm > 0 ? static_cast<f64>(std::sqrt(error / norm)) : 0;
+}
+
+// significant decimal digits an error corresponds to, capped where the error vanishes
+inline f64 GetAccurateDigits(f64 error)
+{
+  return error > 0 ? -std::log10(error) : std::numeric_limits<f128>::digits10;
+}
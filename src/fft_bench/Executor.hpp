@@ -0,0 +1,413 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+#include "Backends.hpp"
+#include "FourStep.hpp"
+#include "Latency.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <latch>
+#include <random>
+
+// Mixed-size job load of a service that receives forward transforms from many clients, see JobExecutor for the executor under test
+struct JobConfig
+{
+  std::vector<std::pair<usize, f64>> sizes; // sizes with their relative frequency, empty disables the job benchmarks
+  std::vector<f64> rates{0};                // arrivals per second, Poisson distributed, 0 submits all jobs at once
+  usize count = 2000;                       // jobs per run
+  i32 workers = std::max<i32>(std::thread::hardware_concurrency(), 1);
+  usize splitSize = usize(1) << 16; // jobs from this size on are split across the workers
+  usize batchLimit = 16;            // queued jobs of one size below splitSize run as one task
+};
+
+inline std::string GetJobRateName(f64 rate)
+{
+  return rate > 0 ? fmt::format("{:g}/s", rate) : "burst";
+}
+
+struct JobRecord
+{
+  usize size = 0;
+  std::chrono::steady_clock::duration offset{}; // arrival after the start of the run
+  std::chrono::steady_clock::time_point arrival;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point done;
+};
+
+// count jobs with sizes drawn by weight and exponentially distributed gaps between arrivals
+inline std::vector<JobRecord> GenerateJobs(const JobConfig& config, f64 rate, u64 seed)
+{
+  std::mt19937_64 generator(seed);
+  std::vector<f64> weights;
+  std::ranges::transform(config.sizes, std::back_inserter(weights), [](const auto& size) { return size.second; });
+  std::discrete_distribution<usize> sizes(weights.begin(), weights.end());
+  std::exponential_distribution<f64> gaps(rate > 0 ? rate : 1);
+
+  std::vector<JobRecord> jobs(config.count);
+  f64 seconds = 0;
+  for (auto& job : jobs)
+  {
+    job.size = config.sizes[sizes(generator)].first;
+    job.offset = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<f64>(seconds));
+    if (rate > 0)
+      seconds += gaps(generator);
+  }
+  return jobs;
+}
+
+// Submits every job at its arrival time. The arrival is the scheduled time, so a late submission shows as queueing time of the job.
+template <typename Submit>
+void DispatchJobs(std::vector<JobRecord>& jobs, std::chrono::steady_clock::time_point start, Submit&& submit)
+{
+  for (auto& job : jobs)
+  {
+    job.arrival = start + job.offset;
+    if (job.arrival > std::chrono::steady_clock::now())
+      std::this_thread::sleep_until(job.arrival);
+    submit(job);
+  }
+}
+
+// Thread pool running the jobs on single-threaded plans of a backend. Jobs enter a shared queue; a worker that takes a job below splitSize
+// also takes the queued jobs of the same size up to batchLimit and runs them back to back on the same plan and buffers. Jobs from splitSize
+// on run as four-step transforms whose loops become chunks on the deque of the worker, which idle and waiting workers steal, so one large
+// job is spread over all workers while the small ones keep flowing. Each worker owns its plans and buffers, created and first touched by
+// itself before the first job, so nothing on the path of a small job is shared or locked besides the queue. The spectrum of every job can
+// be handed to a callback, which runs on the worker after the job is done.
+class JobExecutor
+{
+public:
+  using OutputCallback = std::function<void(const JobRecord& job, const std::complex<f32>* output)>;
+
+  struct Stats
+  {
+    usize tasks = 0;  // batches and split jobs taken from the queue
+    usize splits = 0; // jobs run as four-step transforms across the workers
+    usize steals = 0; // chunks of split jobs run by another worker than the one owning the job
+  };
+
+  JobExecutor(const PlanKey& key, const JobConfig& config, const std::map<usize, std::vector<f32>>& inputs, OutputCallback onOutput = {})
+      : key(key), config(config), inputs(inputs), onOutput(std::move(onOutput)), workers(config.workers), ready(config.workers)
+  {
+    // one plan per worker, as many split jobs as can run at once, so no split job plans on its way; the plans of a size share one set of
+    // sub-plans and scratch, a worker runs one chunk at a time, so each further plan only adds its work matrix and twiddles
+    for (const auto& [size, input] : inputs)
+      if (IsSplit(size))
+      {
+        auto& idle = splitPlans[size];
+        idle.push_back(CreateSplitPlan(size, nullptr));
+        while (idle.size() < static_cast<usize>(config.workers))
+          idle.push_back(CreateSplitPlan(size, idle.front()->GetThreadState()));
+      }
+
+    for (i32 worker = 0; worker < config.workers; ++worker)
+      threads.emplace_back([this, worker] { Run(worker); });
+    ready.wait();
+    if (error)
+    {
+      Stop();
+      std::rethrow_exception(error);
+    }
+  }
+
+  ~JobExecutor() { Stop(); }
+
+  void Submit(JobRecord& job)
+  {
+    {
+      std::scoped_lock lock(queueMutex);
+      queue.push_back(&job);
+      ++submitted;
+    }
+    queueReady.notify_one();
+  }
+
+  // until every submitted job is done, rethrows the first error of a job
+  void Wait()
+  {
+    std::unique_lock lock(queueMutex);
+    allDone.wait(lock, [&] { return completed == submitted; });
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  Stats GetStats() const { return {taskCount.load(), splitCount.load(), stealCount.load()}; }
+
+private:
+  using Task = std::function<void(i32 worker)>;
+
+  struct Worker
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks; // chunks of split jobs, the owner takes the newest, thieves the oldest
+    std::map<usize, std::unique_ptr<FFTPlan>> plans;
+    std::map<usize, std::pair<AlignedBuffer<f32>, AlignedBuffer<std::complex<f32>>>> buffers;
+  };
+
+  PlanKey key;
+  JobConfig config;
+  const std::map<usize, std::vector<f32>>& inputs;
+  OutputCallback onOutput;
+  std::vector<Worker> workers;
+  std::latch ready; // workers that created their plans and buffers
+  std::vector<std::thread> threads;
+  std::mutex splitMutex;
+  std::map<usize, std::vector<std::unique_ptr<FourStepPlan>>> splitPlans; // idle plans, a split job takes one for its duration
+
+  std::mutex queueMutex;
+  std::condition_variable queueReady;
+  std::condition_variable allDone;
+  std::deque<JobRecord*> queue;
+  usize submitted = 0;
+  usize completed = 0;
+  bool stopping = false;
+  std::exception_ptr error;
+
+  std::atomic<usize> pendingTasks = 0;
+  std::atomic<usize> taskCount = 0;
+  std::atomic<usize> splitCount = 0;
+  std::atomic<usize> stealCount = 0;
+
+  bool IsSplit(usize size) const { return size >= config.splitSize and config.workers > 1 and IsFourStepSupported(key.backend, size); }
+
+  std::unique_ptr<FourStepPlan> CreateSplitPlan(usize size, std::shared_ptr<FourStepPlan::ThreadState> threadState) const
+  {
+    const PlanKey splitKey{.backend = key.backend, .size = size, .threads = config.workers, .flags = key.flags, .algorithm = Algorithm::FourStep};
+    return std::make_unique<FourStepPlan>(splitKey, std::move(threadState));
+  }
+
+  void Stop()
+  {
+    {
+      std::scoped_lock lock(queueMutex);
+      stopping = true;
+    }
+    queueReady.notify_all();
+    for (auto& thread : threads)
+      if (thread.joinable())
+        thread.join();
+  }
+
+  void Run(i32 worker)
+  {
+    try
+    {
+      auto& self = workers[worker];
+      for (const auto& [size, input] : inputs)
+      {
+        PlanKey workerKey = key;
+        workerKey.size = size;
+        workerKey.threads = 1;
+        if (not IsSplit(size))
+          self.plans[size] = CreatePlan(workerKey);
+        self.buffers.try_emplace(size, AlignedBuffer<f32>(size), AlignedBuffer<std::complex<f32>>(size / 2 + 1));
+      }
+    }
+    catch (...)
+    {
+      std::scoped_lock lock(queueMutex);
+      if (not error)
+        error = std::current_exception();
+    }
+    ready.count_down();
+
+    while (true)
+    {
+      if (RunTask(worker))
+        continue;
+      std::vector<JobRecord*> batch;
+      {
+        std::unique_lock lock(queueMutex);
+        queueReady.wait(lock, [&] { return stopping or not queue.empty() or pendingTasks.load() > 0; });
+        if (queue.empty())
+        {
+          if (stopping)
+            return;
+          continue;
+        }
+        batch = TakeBatch();
+      }
+      RunJobs(worker, batch);
+    }
+  }
+
+  // the oldest queued job and, below splitSize, the following jobs of the same size up to batchLimit
+  std::vector<JobRecord*> TakeBatch()
+  {
+    std::vector<JobRecord*> batch{queue.front()};
+    queue.pop_front();
+    if (IsSplit(batch.front()->size))
+      return batch;
+    for (auto it = queue.begin(); it != queue.end() and batch.size() < config.batchLimit;)
+      if ((*it)->size == batch.front()->size)
+      {
+        batch.push_back(*it);
+        it = queue.erase(it);
+      }
+      else
+        ++it;
+    return batch;
+  }
+
+  void RunJobs(i32 worker, const std::vector<JobRecord*>& batch)
+  {
+    ++taskCount;
+    try
+    {
+      const usize size = batch.front()->size;
+      auto& [input, output] = workers[worker].buffers.at(size);
+      const auto& signal = inputs.at(size);
+      for (auto* job : batch)
+      {
+        job->start = std::chrono::steady_clock::now();
+        std::memcpy(input.Data(), signal.data(), size * sizeof(f32));
+        if (IsSplit(size))
+          RunSplit(worker, size, input.Data(), output.Data());
+        else
+          workers[worker].plans.at(size)->Forward(input.Data(), output.Data());
+        job->done = std::chrono::steady_clock::now();
+        if (onOutput)
+          onOutput(*job, output.Data());
+      }
+    }
+    catch (...)
+    {
+      std::scoped_lock lock(queueMutex);
+      if (not error)
+        error = std::current_exception();
+    }
+    {
+      std::scoped_lock lock(queueMutex);
+      completed += batch.size();
+    }
+    allDone.notify_all();
+  }
+
+  void RunSplit(i32 worker, usize size, const f32* input, std::complex<f32>* output)
+  {
+    // every worker runs at most one split job, so the plans created up front always leave one idle
+    std::unique_ptr<FourStepPlan> plan;
+    {
+      std::scoped_lock lock(splitMutex);
+      auto& idle = splitPlans.at(size);
+      plan = std::move(idle.back());
+      idle.pop_back();
+    }
+
+    ++splitCount;
+    plan->Forward(input, output, [&](usize count, const auto& body) { ParallelFor(worker, count, body); });
+
+    std::scoped_lock lock(splitMutex);
+    splitPlans[size].push_back(std::move(plan));
+  }
+
+  // body(thread, index) for every index below count in about four chunks per worker, pushed to the deque of this worker, which runs and
+  // steals chunks until all of them are done
+  template <typename Body>
+  void ParallelFor(i32 worker, usize count, const Body& body)
+  {
+    const usize chunks = std::min<usize>(count, 4 * workers.size());
+    std::atomic<usize> remaining = chunks;
+    {
+      std::scoped_lock lock(workers[worker].mutex);
+      for (usize chunk = 0; chunk < chunks; ++chunk)
+        workers[worker].tasks.emplace_back(
+            [&, chunk, worker](i32 thread)
+            {
+              if (thread != worker)
+                ++stealCount;
+              for (usize index = count * chunk / chunks; index < count * (chunk + 1) / chunks; ++index)
+                body(thread, index);
+              remaining.fetch_sub(1, std::memory_order_release);
+            });
+    }
+    pendingTasks += chunks;
+    {
+      std::scoped_lock lock(queueMutex); // orders the new tasks with the predicate check of sleeping workers
+    }
+    queueReady.notify_all();
+
+    while (remaining.load(std::memory_order_acquire) > 0)
+      if (not RunTask(worker))
+        std::this_thread::yield();
+  }
+
+  // runs the newest task of this worker or the oldest of another one, false when there is none
+  bool RunTask(i32 worker)
+  {
+    if (pendingTasks.load() == 0)
+      return false;
+    for (usize offset = 0; offset < workers.size(); ++offset)
+    {
+      auto& victim = workers[(worker + offset) % workers.size()];
+      Task task;
+      {
+        std::scoped_lock lock(victim.mutex);
+        if (victim.tasks.empty())
+          continue;
+        if (offset == 0)
+        {
+          task = std::move(victim.tasks.back());
+          victim.tasks.pop_back();
+        }
+        else
+        {
+          task = std::move(victim.tasks.front());
+          victim.tasks.pop_front();
+        }
+      }
+      --pendingTasks;
+      task(worker);
+      return true;
+    }
+    return false;
+  }
+};
+
+// The baseline of the executor: every job starts a thread that creates its plan and buffers, transforms and exits. Creating and destroying
+// FFTW plans takes the planner lock (GetFFTWPlannerMutex), so the concurrent jobs are safe with FFTW and wait for each other's planning,
+// which is part of what the baseline costs.
+inline void RunThreadPerJob(const PlanKey& key, std::vector<JobRecord>& jobs, const std::map<usize, std::vector<f32>>& inputs,
+                            std::chrono::steady_clock::time_point start)
+{
+  std::mutex mutex;
+  std::condition_variable allDone;
+  usize completed = 0;
+  std::exception_ptr error;
+  DispatchJobs(jobs, start,
+               [&](JobRecord& job)
+               {
+                 std::thread(
+                     [&, jobPtr = &job]
+                     {
+                       try
+                       {
+                         jobPtr->start = std::chrono::steady_clock::now();
+                         PlanKey jobKey = key;
+                         jobKey.size = jobPtr->size;
+                         jobKey.threads = 1;
+                         const auto plan = CreatePlan(jobKey);
+                         AlignedBuffer<f32> input(jobPtr->size);
+                         AlignedBuffer<std::complex<f32>> output(jobPtr->size / 2 + 1);
+                         std::memcpy(input.Data(), inputs.at(jobPtr->size).data(), jobPtr->size * sizeof(f32));
+                         plan->Forward(input.Data(), output.Data());
+                         jobPtr->done = std::chrono::steady_clock::now();
+                       }
+                       catch (...)
+                       {
+                         std::scoped_lock lock(mutex);
+                         if (not error)
+                           error = std::current_exception();
+                       }
+                       std::scoped_lock lock(mutex);
+                       ++completed;
+                       allDone.notify_all();
+                     })
+                     .detach();
+               });
+  std::unique_lock lock(mutex);
+  allDone.wait(lock, [&] { return completed == jobs.size(); });
+  if (error)
+    std::rethrow_exception(error);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Precompiled.hpp"
+
+// Input signals shared read-only by every benchmark of a given size. The signal for a size is generated when the first benchmark of
+// that size asks for it. Benchmarks run in registration order, which groups them by size, so once a benchmark of another size asks for
+// its input, the fixtures drop the previous signal, which is freed as soon as no benchmark holds it anymore. This keeps a single size
+// resident. Suites that do not use the fixtures call Clear to free the signal of the last size before they run.
+class InputFixtures
+{
+public:
+  static std::shared_ptr<const std::vector<f32>> Acquire(usize size)
+  {
+    auto& fixtures = Instance();
+    std::scoped_lock lock(fixtures.mutex);
+    if (not fixtures.input or fixtures.input->size() != size)
+    {
+      fixtures.input.reset(); // free the previous signal before generating the next one unless a benchmark still holds it
+      fixtures.input = std::make_shared<const std::vector<f32>>(GenerateRandomVector(size));
+    }
+    return fixtures.input;
+  }
+
+  static void Clear()
+  {
+    auto& fixtures = Instance();
+    std::scoped_lock lock(fixtures.mutex);
+    fixtures.input.reset();
+  }
+
+private:
+  std::mutex mutex;
+  std::shared_ptr<const std::vector<f32>> input;
+
+  static InputFixtures& Instance()
+  {
+    static InputFixtures fixtures;
+    return fixtures;
+  }
+};
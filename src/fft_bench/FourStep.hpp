@@ -0,0 +1,453 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+#include "Backends.hpp"
+
+// Forward complex-to-complex transform used as the sub-FFT of the four-step engine. Single-threaded, plans keep work buffers, so every
+// thread needs its own instance.
+class ComplexPlan
+{
+public:
+  explicit ComplexPlan(usize size) : size(size) {}
+  virtual ~ComplexPlan() = default;
+
+  virtual void Forward(const std::complex<f32>* input, std::complex<f32>* output) = 0;
+
+  usize GetSize() const { return size; }
+
+protected:
+  usize size;
+};
+
+class FFTWComplexPlan : public ComplexPlan
+{
+public:
+  FFTWComplexPlan(usize size, u32 flags) : ComplexPlan(size)
+  {
+    AlignedBuffer<std::complex<f32>> input(size), output(size);
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    fftwf_plan_with_nthreads(1);
+    plan = fftwf_plan_dft_1d(size, reinterpret_cast<fftwf_complex*>(input.Data()), reinterpret_cast<fftwf_complex*>(output.Data()), FFTW_FORWARD, flags);
+    if (not plan)
+      throw std::runtime_error(fmt::format("Failed to create FFTW complex plan of size {}", size));
+  }
+  ~FFTWComplexPlan() override
+  {
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    fftwf_destroy_plan(plan);
+  }
+
+  void Forward(const std::complex<f32>* input, std::complex<f32>* output) override
+  {
+    fftwf_execute_dft(plan, reinterpret_cast<fftwf_complex*>(const_cast<std::complex<f32>*>(input)), reinterpret_cast<fftwf_complex*>(output));
+  }
+
+private:
+  fftwf_plan plan;
+};
+
+class IPPComplexPlan : public ComplexPlan
+{
+public:
+  IPPComplexPlan(usize size, IppHintAlgorithm hint) : ComplexPlan(size)
+  {
+    const auto flag = IPP_FFT_NODIV_BY_ANY;
+    int sizeDFTSpec, sizeDFTInitBuf, sizeDFTWorkBuf;
+    ippsDFTGetSize_C_32fc(size, flag, hint, &sizeDFTSpec, &sizeDFTInitBuf, &sizeDFTWorkBuf);
+    pDFTSpec = (IppsDFTSpec_C_32fc*)ippsMalloc_8u(sizeDFTSpec);
+    workBuffer = AlignedBuffer<u8>(sizeDFTWorkBuf);
+    auto pDFTInitBuf = ippsMalloc_8u(sizeDFTInitBuf);
+    const auto status = ippsDFTInit_C_32fc(size, flag, hint, pDFTSpec, pDFTInitBuf);
+    if (pDFTInitBuf)
+      ippFree(pDFTInitBuf);
+    if (status != ippStsNoErr)
+    {
+      Free();
+      throw std::runtime_error(fmt::format("Failed to initialize IPP complex DFT of size {}: {}", size, ippGetStatusString(status)));
+    }
+  }
+  ~IPPComplexPlan() override { Free(); }
+
+  void Forward(const std::complex<f32>* input, std::complex<f32>* output) override
+  {
+    ippsDFTFwd_CToC_32fc(reinterpret_cast<const Ipp32fc*>(input), reinterpret_cast<Ipp32fc*>(output), pDFTSpec, workBuffer.Data());
+  }
+
+private:
+  IppsDFTSpec_C_32fc* pDFTSpec = nullptr;
+  AlignedBuffer<u8> workBuffer;
+
+  void Free()
+  {
+    if (pDFTSpec)
+      ippFree(pDFTSpec);
+  }
+};
+
+class PFFFTComplexPlan : public ComplexPlan
+{
+public:
+  explicit PFFFTComplexPlan(usize size) : ComplexPlan(size), fft(size)
+  {
+    if (not fft.isValid())
+      throw std::invalid_argument(fmt::format("PFFFT has no complex transform of length {}", size));
+  }
+
+  void Forward(const std::complex<f32>* input, std::complex<f32>* output) override { fft.forward(input, output); }
+
+private:
+  pffft::Fft<std::complex<f32>> fft;
+};
+
+class PocketFFTComplexPlan : public ComplexPlan
+{
+public:
+  explicit PocketFFTComplexPlan(usize size) : ComplexPlan(size), shape{size} {}
+
+  void Forward(const std::complex<f32>* input, std::complex<f32>* output) override
+  {
+    pocketfft::c2c(shape, stride, stride, axes, pocketfft::FORWARD, input, output, 1.0f, 1);
+  }
+
+private:
+  pocketfft::shape_t shape;
+  const pocketfft::stride_t stride{sizeof(std::complex<f32>)};
+  const pocketfft::shape_t axes{0};
+};
+
+#ifdef ENABLE_KFR
+class KFRComplexPlan : public ComplexPlan
+{
+public:
+  explicit KFRComplexPlan(usize size) : ComplexPlan(size), plan(size), temp(plan.temp_size) {}
+
+  void Forward(const std::complex<f32>* input, std::complex<f32>* output) override
+  {
+    plan.execute(reinterpret_cast<kfr::complex<f32>*>(output), reinterpret_cast<const kfr::complex<f32>*>(input), temp.Data());
+  }
+
+private:
+  kfr::dft_plan<f32> plan;
+  AlignedBuffer<u8> temp;
+};
+#endif
+
+#ifdef ENABLE_OPENCV
+class OpenCVComplexPlan : public ComplexPlan
+{
+public:
+  explicit OpenCVComplexPlan(usize size) : ComplexPlan(size) {}
+
+  void Forward(const std::complex<f32>* input, std::complex<f32>* output) override
+  {
+    const cv::Mat in(1, size, CV_32FC2, const_cast<std::complex<f32>*>(input));
+    cv::Mat out(1, size, CV_32FC2, output);
+    cv::dft(in, out);
+  }
+};
+#endif
+
+// PFFFT needs lengths of 2, 3 and 5 with a multiple of 16 for complex transforms, SIMD has real kernels only, the other backends handle
+// every length
+inline bool IsComplexSizeSupported(Backend backend, usize size)
+{
+  if (backend == Backend::PFFFT)
+    return static_cast<usize>(pffft::Fft<std::complex<f32>>::nearestTransformSize(size)) == size;
+  return IsBackendAvailable(backend) and backend != Backend::Simd;
+}
+
+// key.size is the length of the sub-FFT, flags are the FFTW planner flags or the IPP hint as for the real plans
+inline std::unique_ptr<ComplexPlan> CreateComplexPlan(const PlanKey& key)
+{
+  switch (key.backend)
+  {
+  case Backend::FFTW:
+    return std::make_unique<FFTWComplexPlan>(key.size, key.flags);
+  case Backend::IPP:
+    return std::make_unique<IPPComplexPlan>(key.size, static_cast<IppHintAlgorithm>(key.flags));
+  case Backend::PFFFT:
+    return std::make_unique<PFFFTComplexPlan>(key.size);
+  case Backend::PocketFFT:
+    return std::make_unique<PocketFFTComplexPlan>(key.size);
+#ifdef ENABLE_KFR
+  case Backend::KFR:
+    return std::make_unique<KFRComplexPlan>(key.size);
+#endif
+#ifdef ENABLE_OPENCV
+  case Backend::OpenCV:
+    return std::make_unique<OpenCVComplexPlan>(key.size);
+#endif
+  default:
+    throw std::invalid_argument(fmt::format("Backend {} is not enabled in this build", GetBackendName(key.backend)));
+  }
+}
+
+// std::complex multiplication checks for infinities and NaNs unless compiled with -ffast-math
+inline std::complex<f32> Multiply(std::complex<f32> a, std::complex<f32> b)
+{
+  return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+// exp(-2 pi i j / n) as the product of a coarse and a fine table of about sqrt(n) entries each, which stay in cache where a full table
+// would double the memory traffic of the passes using it
+class TwiddleTable
+{
+public:
+  explicit TwiddleTable(usize n) : shift(std::bit_width(static_cast<usize>(std::sqrt(n))) - 1), fine(usize{1} << shift), coarse((n >> shift) + 1)
+  {
+    for (usize j = 0; j < fine.Size(); ++j)
+      fine[j] = std::polar(1.0, -2 * std::numbers::pi * j / n);
+    for (usize j = 0; j < coarse.Size(); ++j)
+      coarse[j] = std::polar(1.0, -2 * std::numbers::pi * (j << shift) / n);
+  }
+
+  std::complex<f32> operator()(usize j) const { return Multiply(coarse[j >> shift], fine[j & (fine.Size() - 1)]); }
+
+private:
+  usize shift;
+  AlignedBuffer<std::complex<f32>> fine;
+  AlignedBuffer<std::complex<f32>> coarse;
+};
+
+// columns x rows of the complex transform of length m, the columns being the shorter side closest to sqrt(m), nullopt when m has no such
+// factorization into lengths the backend supports
+inline std::optional<std::pair<usize, usize>> GetFourStepFactors(Backend backend, usize m)
+{
+  for (auto columns = static_cast<usize>(std::sqrt(m)); columns >= 2; --columns)
+    if (m % columns == 0 and IsComplexSizeSupported(backend, columns) and IsComplexSizeSupported(backend, m / columns))
+      return std::pair{columns, m / columns};
+  return std::nullopt;
+}
+
+inline bool IsFourStepSupported(Backend backend, usize size)
+{
+  return size % 2 == 0 and GetFourStepFactors(backend, size / 2).has_value();
+}
+
+// Real transform of size N as a complex transform of the even and odd samples, z[m] = x[2m] + i x[2m+1] of length M = N/2, computed with
+// Bailey's four-step algorithm for M = C x R. The input is read as a matrix of R rows and C columns, m = c + C r:
+//   1. C column FFTs of length R, gathered in blocks of columnBlock columns, so every row read is a full cache line
+//   2. multiplication with the twiddles exp(-2 pi i c k / M) while scattering the columns back
+//   3. R row FFTs of length C, in place through a per-thread scratch row
+//   4. cache-blocked transpose into the natural order k = r + R c
+// and finally the split of the complex spectrum into the real one. Every step is an OpenMP loop over one sub-plan per thread, so the sub
+// transforms are single-threaded plans of the backend and only the engine threads. Inverse runs the same steps on the conjugated merged
+// spectrum. The output is the FFTW half spectrum for every backend.
+class FourStepPlan : public FFTPlan
+{
+public:
+  static constexpr usize columnBlock = 16;
+  static constexpr usize transposeTile = 32;
+  static constexpr usize splitChunk = 4096;
+
+  // the sub-plans and scratch of every thread, see GetThreadState
+  struct ThreadState
+  {
+    std::vector<std::unique_ptr<ComplexPlan>> columnPlans;
+    std::vector<std::unique_ptr<ComplexPlan>> rowPlans;
+    std::vector<AlignedBuffer<std::complex<f32>>> columnScratch;
+    std::vector<AlignedBuffer<std::complex<f32>>> rowScratch;
+  };
+
+  // shares the thread state of another plan of the same key when given one, only the work matrix and the twiddles are the plan's own
+  explicit FourStepPlan(const PlanKey& key, std::shared_ptr<ThreadState> sharedState = nullptr)
+      : FFTPlan(key.size), nthreads(key.threads), half(key.size / 2), twiddlesHalf(std::max<usize>(half, 1)), twiddlesFull(key.size), threadState(std::move(sharedState))
+  {
+    const auto factors = size % 2 == 0 ? GetFourStepFactors(key.backend, half) : std::nullopt;
+    if (not factors)
+      throw std::invalid_argument(fmt::format("{} has no four-step factorization of size {}", GetPlanBaseName(key), size));
+    std::tie(columns, rows) = *factors;
+    // keeps every gathered column and scratch row aligned
+    columnStride = (rows + 7) / 8 * 8;
+    rowStride = (columns + 7) / 8 * 8;
+
+    work = AlignedBuffer<std::complex<f32>>(half);
+    if (threadState)
+    {
+      if (threadState->columnPlans.size() != static_cast<usize>(nthreads) or threadState->columnPlans.front()->GetSize() != rows)
+        throw std::invalid_argument(fmt::format("Shared four-step thread state does not match {}", GetPlanName(key)));
+      return;
+    }
+    threadState = std::make_shared<ThreadState>();
+    PlanKey subKey = key;
+    subKey.threads = 1;
+    subKey.algorithm = Algorithm::Direct;
+    for (i32 thread = 0; thread < nthreads; ++thread)
+    {
+      subKey.size = rows;
+      threadState->columnPlans.push_back(CreateComplexPlan(subKey));
+      subKey.size = columns;
+      threadState->rowPlans.push_back(CreateComplexPlan(subKey));
+      threadState->columnScratch.emplace_back(2 * columnBlock * columnStride);
+      threadState->rowScratch.emplace_back(2 * rowStride);
+    }
+  }
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    Transform(reinterpret_cast<const std::complex<f32>*>(input), output, false);
+    SplitSpectrum(output);
+  }
+
+  void Inverse(std::complex<f32>* input, f32* output) override
+  {
+    MergeSpectrum(input);
+    Transform(input, reinterpret_cast<std::complex<f32>*>(output), true);
+  }
+
+  // Forward with the loops of the steps run by the caller instead of OpenMP, e.g. by the workers of a job executor: parallelFor(count, body)
+  // has to call body(thread, index) for every index below count, with threads below the thread count of the plan, and return when all
+  // calls are done. Calls running at the same time need distinct threads, since every thread has its own sub-plans and scratch.
+  template <typename ParallelFor>
+  void Forward(const f32* input, std::complex<f32>* output, const ParallelFor& parallelFor)
+  {
+    const auto* complexInput = reinterpret_cast<const std::complex<f32>*>(input);
+    parallelFor((columns + columnBlock - 1) / columnBlock, [&](i32 thread, usize block) { TransformColumns(complexInput, thread, block * columnBlock); });
+    parallelFor(rows, [&](i32 thread, usize row) { TransformRow(thread, row); });
+    parallelFor((rows + transposeTile - 1) / transposeTile, [&](i32, usize tile) { Transpose(output, tile * transposeTile, false); });
+    SplitSpectrumEnds(output);
+    const usize pairs = half / 2;
+    const usize chunks = (pairs + splitChunk - 1) / splitChunk;
+    parallelFor(chunks, [&](i32, usize chunk)
+                {
+                  for (usize k = chunk * splitChunk + 1; k <= std::min((chunk + 1) * splitChunk, pairs); ++k)
+                    SplitSpectrumPair(output, k);
+                });
+  }
+
+  usize GetColumns() const { return columns; }
+  usize GetRows() const { return rows; }
+  i32 GetThreads() const { return nthreads; }
+
+  // Plans of the same key can share their thread state as long as no thread runs a loop of two of them at the same time, e.g. the split
+  // jobs of the job executor, whose workers run one chunk at a time whichever job it belongs to.
+  std::shared_ptr<ThreadState> GetThreadState() const { return threadState; }
+
+private:
+  i32 nthreads;
+  usize half;
+  usize columns = 0;
+  usize rows = 0;
+  usize columnStride = 0;
+  usize rowStride = 0;
+  TwiddleTable twiddlesHalf;
+  TwiddleTable twiddlesFull;
+  AlignedBuffer<std::complex<f32>> work;
+  std::shared_ptr<ThreadState> threadState;
+
+  static bool IsAligned(const void* ptr) { return reinterpret_cast<uintptr_t>(ptr) % AlignedBuffer<f32>::alignment == 0; }
+
+  // complex DFT of length half from input to output in natural order, conjugated on the way out when asked to
+  void Transform(const std::complex<f32>* input, std::complex<f32>* output, bool conjugate)
+  {
+    const usize columnBlocks = (columns + columnBlock - 1) / columnBlock;
+    const usize rowTiles = (rows + transposeTile - 1) / transposeTile;
+#pragma omp parallel num_threads(nthreads)
+    {
+      const auto thread = omp_get_thread_num();
+#pragma omp for schedule(static)
+      for (usize block = 0; block < columnBlocks; ++block)
+        TransformColumns(input, thread, block * columnBlock);
+#pragma omp for schedule(static)
+      for (usize row = 0; row < rows; ++row)
+        TransformRow(thread, row);
+#pragma omp for schedule(static)
+      for (usize tile = 0; tile < rowTiles; ++tile)
+        Transpose(output, tile * transposeTile, conjugate);
+    }
+  }
+
+  void TransformColumns(const std::complex<f32>* input, i32 thread, usize first)
+  {
+    const usize count = std::min(columnBlock, columns - first);
+    auto* gathered = threadState->columnScratch[thread].Data();
+    auto* transformed = gathered + columnBlock * columnStride;
+    for (usize r = 0; r < rows; ++r)
+      for (usize c = 0; c < count; ++c)
+        gathered[c * columnStride + r] = input[r * columns + first + c];
+    for (usize c = 0; c < count; ++c)
+      threadState->columnPlans[thread]->Forward(gathered + c * columnStride, transformed + c * columnStride);
+    for (usize r = 0; r < rows; ++r)
+      for (usize c = 0; c < count; ++c)
+        work[r * columns + first + c] = Multiply(transformed[c * columnStride + r], twiddlesHalf((first + c) * r));
+  }
+
+  void TransformRow(i32 thread, usize row)
+  {
+    auto* line = work.Data() + row * columns;
+    auto* input = threadState->rowScratch[thread].Data();
+    auto* output = input + rowStride;
+    if (IsAligned(line))
+      input = line;
+    else
+      std::memcpy(input, line, columns * sizeof(std::complex<f32>));
+    threadState->rowPlans[thread]->Forward(input, output);
+    std::memcpy(line, output, columns * sizeof(std::complex<f32>));
+  }
+
+  // rows [first, first + transposeTile) of the work matrix become the same columns of the output
+  void Transpose(std::complex<f32>* output, usize first, bool conjugate)
+  {
+    const usize last = std::min(first + transposeTile, rows);
+    for (usize c0 = 0; c0 < columns; c0 += transposeTile)
+      for (usize c = c0; c < std::min(c0 + transposeTile, columns); ++c)
+        for (usize r = first; r < last; ++r)
+        {
+          const auto value = work[r * columns + c];
+          output[c * rows + r] = conjugate ? std::conj(value) : value;
+        }
+  }
+
+  // Z = DFT(even + i odd) in place into the half spectrum X[k] = E[k] + W^k O[k] with E[k] = (Z[k] + conj(Z[M-k])) / 2 and
+  // O[k] = (Z[k] - conj(Z[M-k])) / 2i, computing X[k] and X[M-k] from the same pair of inputs
+  void SplitSpectrum(std::complex<f32>* spectrum) const
+  {
+    SplitSpectrumEnds(spectrum);
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (usize k = 1; k <= half / 2; ++k)
+      SplitSpectrumPair(spectrum, k);
+  }
+
+  void SplitSpectrumEnds(std::complex<f32>* spectrum) const
+  {
+    const auto z0 = spectrum[0];
+    spectrum[0] = {z0.real() + z0.imag(), 0};
+    spectrum[half] = {z0.real() - z0.imag(), 0};
+  }
+
+  void SplitSpectrumPair(std::complex<f32>* spectrum, usize k) const
+  {
+    const auto a = spectrum[k];
+    const auto b = std::conj(spectrum[half - k]);
+    const auto even = (a + b) * 0.5f;
+    const auto odd = Multiply(a - b, {0, -0.5f});
+    const auto rotated = Multiply(twiddlesFull(k), odd);
+    spectrum[k] = even + rotated;
+    spectrum[half - k] = std::conj(even - rotated);
+  }
+
+  // inverse of SplitSpectrum without the factors 1/2, so the unnormalized inverse scales by N like the other backends, conjugated for
+  // the forward transform
+  void MergeSpectrum(std::complex<f32>* spectrum) const
+  {
+    const f32 x0 = spectrum[0].real(), xm = spectrum[half].real();
+    spectrum[0] = {x0 + xm, -(x0 - xm)};
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (usize k = 1; k <= half / 2; ++k)
+    {
+      const auto a = spectrum[k];
+      const auto b = std::conj(spectrum[half - k]);
+      const auto even = a + b;
+      const auto odd = Multiply(a - b, std::conj(twiddlesFull(k)));
+      const std::complex<f32> iOdd{-odd.imag(), odd.real()};
+      const std::complex<f32> iOddConj{odd.imag(), odd.real()}; // i conj(odd)
+      spectrum[k] = std::conj(even + iOdd);
+      spectrum[half - k] = std::conj(std::conj(even) + iOddConj);
+    }
+  }
+};
+
+inline std::unique_ptr<FFTPlan> CreateFourStepPlan(const PlanKey& key)
+{
+  return std::make_unique<FourStepPlan>(key);
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include "Precompiled.hpp"
+#include <pthread.h>
+#include <sched.h>
+
+// Log-linear histogram of durations in nanoseconds in the style of HdrHistogram: values below 2^subBucketBits are exact, above that every
+// power of two is split into 2^subBucketBits buckets, so percentiles are accurate to better than 1% from nanoseconds to hours.
+class LatencyHistogram
+{
+public:
+  static constexpr u32 subBucketBits = 7;
+  static constexpr u64 subBuckets = u64{1} << subBucketBits;
+
+  LatencyHistogram() : counts((64 - subBucketBits + 1) * subBuckets) {}
+
+  void Record(u64 nanoseconds)
+  {
+    ++counts[GetIndex(nanoseconds)];
+    ++count;
+    max = std::max(max, nanoseconds);
+  }
+
+  u64 GetCount() const { return count; }
+  u64 GetMax() const { return max; }
+
+  // highest value of the bucket holding the given fraction of all values, e.g. 0.99 for p99
+  u64 GetPercentile(f64 fraction) const
+  {
+    if (count == 0)
+      return 0;
+    const u64 target = std::max<u64>(static_cast<u64>(std::ceil(fraction * count)), 1);
+    u64 cumulative = 0;
+    for (usize index = 0; index < counts.size(); ++index)
+    {
+      cumulative += counts[index];
+      if (cumulative >= target)
+        return std::min(GetUpperBound(index), max);
+    }
+    return max;
+  }
+
+private:
+  std::vector<u64> counts;
+  u64 count = 0;
+  u64 max = 0;
+
+  static usize GetIndex(u64 value)
+  {
+    if (value < subBuckets)
+      return value;
+    const u32 shift = std::bit_width(value) - subBucketBits - 1;
+    return (shift + 1) * subBuckets + ((value >> shift) - subBuckets);
+  }
+
+  static u64 GetUpperBound(usize index)
+  {
+    if (index < subBuckets)
+      return index;
+    const u32 shift = index / subBuckets - 1;
+    const u64 lower = (index % subBuckets + subBuckets) << shift;
+    return lower + (u64{1} << shift) - 1;
+  }
+};
+
+using CoreSet = std::vector<i32>;
+
+inline CoreSet GetThreadAffinity()
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    throw std::runtime_error("Failed to get thread affinity");
+  CoreSet cores;
+  for (i32 core = 0; core < CPU_SETSIZE; ++core)
+    if (CPU_ISSET(core, &set))
+      cores.push_back(core);
+  return cores;
+}
+
+// restricts the calling thread to the cores, threads it creates afterwards inherit the mask
+inline void SetThreadAffinity(const CoreSet& cores)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const auto core : cores)
+    CPU_SET(core, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    throw std::runtime_error(fmt::format("Failed to pin thread to cores {}", fmt::join(cores, ",")));
+}
+
+// pins OpenMP thread t of a team of nthreads to cores[t % cores.size()], the pool is reused by later parallel regions of the same size,
+// which covers FFTW built with OpenMP and the OpenMP loops of the benchmarks
+inline void PinOpenMPThreads(const CoreSet& cores, i32 nthreads)
+{
+#pragma omp parallel num_threads(nthreads)
+  SetThreadAffinity({cores[omp_get_thread_num() % cores.size()]});
+}
+
+// gives every OpenMP thread of a team of nthreads the cores again, undoing PinOpenMPThreads for the benchmarks that follow
+inline void UnpinOpenMPThreads(const CoreSet& cores, i32 nthreads)
+{
+#pragma omp parallel num_threads(nthreads)
+  SetThreadAffinity(cores);
+}
+
+enum class LoadKind
+{
+  Compute,
+  Memory,
+};
+
+// Busy threads pinned to the given cores for the lifetime of the object, either spinning on arithmetic or streaming through a buffer
+// larger than the last level cache to compete for memory bandwidth.
+class BackgroundLoad
+{
+public:
+  BackgroundLoad(const CoreSet& cores, LoadKind kind)
+  {
+    for (const auto core : cores)
+      threads.emplace_back(
+          [this, core, kind]
+          {
+            SetThreadAffinity({core});
+            kind == LoadKind::Compute ? Compute() : Stream();
+          });
+  }
+
+  ~BackgroundLoad()
+  {
+    stop = true;
+    for (auto& thread : threads)
+      thread.join();
+  }
+
+private:
+  std::atomic<bool> stop = false;
+  std::vector<std::thread> threads;
+
+  void Compute() const
+  {
+    f64 x = 1.0001;
+    while (not stop.load(std::memory_order_relaxed))
+    {
+      for (i32 i = 0; i < 4096; ++i)
+        x = x * 1.0000001 + 1e-9;
+      benchmark::DoNotOptimize(x);
+    }
+  }
+
+  void Stream() const
+  {
+    std::vector<f32> buffer(64 << 20 >> 2); // 64 MiB
+    while (not stop.load(std::memory_order_relaxed))
+    {
+      f32 sum = 0;
+      for (auto& value : buffer)
+        sum += value += 1;
+      benchmark::DoNotOptimize(sum);
+    }
+  }
+};
+
+// core layout of the latency benchmarks, empty sets mean unpinned and no background load
+struct LatencyConfig
+{
+  CoreSet cores; // the first runs the benchmark thread, all of them the library workers
+  CoreSet loadCores;
+  LoadKind loadKind = LoadKind::Compute;
+};
+
+// e.g. "latency", "latency pinned 2,3" or "latency pinned 2,3 + memory load 4,5"
+inline std::string GetLatencyName(const LatencyConfig& config)
+{
+  const auto formatCores = [](const CoreSet& cores) { return fmt::format("{}", fmt::join(cores, ",")); };
+  std::string name = "latency";
+  if (not config.cores.empty())
+    name += fmt::format(" pinned {}", formatCores(config.cores));
+  if (not config.loadCores.empty())
+    name += fmt::format(" + {} load {}", config.loadKind == LoadKind::Compute ? "compute" : "memory", formatCores(config.loadCores));
+  return name;
+}
@@ -1,33 +1,60 @@
 #include "Benchmarks.hpp"
 #include "Tests.hpp"
+#include "utils/MallocHooks.hpp"
 
-static void Init()
-{
-  if (not fftwf_init_threads())
-    throw std::runtime_error("Failed to initialize FFTW threads");
-
-  ippInit();
-  const auto libVersion = ippGetLibVersion();
-  fmt::print("IPP version: {} {}\n", libVersion->Name, libVersion->Version);
-}
-
+// --fft_* options select the benchmark matrix, see Config.hpp
+// --fft_results=<path> structured results, see Results.hpp, compared across runs by fft_compare
 // --benchmark_out_format={json|console|csv}
 // --benchmark_out=<filename>
 // --benchmark_out_format=csv --benchmark_out=../data/fftbench.csv
 int main(int argc, char** argv)
 try
 {
-  Init();
+  if (argc > 1 and std::string_view(argv[1]) == setupProbeOption)
+    return RunSetupProbe(argc, argv);
 
-  static constexpr usize testSize = 1024;
-  if constexpr (testSize > 0)
-    RunTests(testSize);
+  const auto config = ParseConfig(argc, argv);
+  AddMachineContext(config);
+  InitBackends(config);
+  PlanCache::Global().SetCapacity(config.planCacheCapacity);
+  PlanCache64::Global().SetCapacity(config.planCacheCapacity);
+  BufferArena::Global().SetStrategy(config.bufferStrategies.front());
+  BufferArena::Global().SetRetainLimit(config.bufferRetainBytes);
 
-  RegisterBenchmarks();
+  if (config.testSize > 0)
+    RunTests(config.testSize);
 
+  RegisterBenchmarks(config);
+
+  auto display = CreateDisplayReporter(argc, argv);
   benchmark::Initialize(&argc, argv);
-  benchmark::RunSpecifiedBenchmarks();
+  if (config.resultsPath == "none")
+    benchmark::RunSpecifiedBenchmarks();
+  else
+  {
+    ResultsReporter reporter(config.resultsPath, std::move(display));
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+  }
   benchmark::Shutdown();
+  InputFixtures::Clear();
+
+  for (const auto length : config.adviseLengths)
+    SizeAdvisor::Global().PrintAdvice(length);
+  SetupAdvisor::Global().Print();
+
+  const auto stats = PlanCache::Global().GetStats();
+  fmt::print("Plan cache: {} hits, {} misses, {} evictions, {:.1f} ms planning\n", stats.hits, stats.misses, stats.evictions, stats.planSeconds * 1e3);
+  PlanCache::Global().Clear();
+  PlanCache64::Global().Clear();
+  BatchPlanCache::Global().Clear();
+  const auto arena = BufferArena::Global().GetStats();
+  fmt::print("Buffer arena: {} mapped, {} reused, {:.1f} MiB retained{}\n", arena.mapped, arena.reused, arena.retainedBytes / 1048576.0,
+             arena.hugeTLBFallbacks > 0 ? fmt::format(", {} hugetlb fallbacks", arena.hugeTLBFallbacks) : "");
+  BufferArena::Global().Trim();
+  fftwf_cleanup_threads();
+  fftw_cleanup_threads();
+
+  fmt::print("Peak resident memory: {:.1f} MiB\n", static_cast<f64>(GetPeakResidentMemory()) / (1024 * 1024));
 
   return EXIT_SUCCESS;
 }
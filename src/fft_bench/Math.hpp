@@ -15,3 +15,9 @@ inline std::vector<f32> GenerateRandomVector(usize size)
   std::ranges::for_each(vec, [](auto& x) { x = static_cast<f32>(rand()) / RAND_MAX; });
   return vec;
 }
+
+// conventional operation count of a real FFT of the given size, half of the 5 N log2(N) of a complex FFT
+inline f64 GetFFTFlops(usize size)
+{
+  return 2.5 * size * std::log2(static_cast<f64>(size));
+}
@@ -0,0 +1,267 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "Backends.hpp"
+
+// row-major dimensions, the last one is contiguous
+using Shape = std::vector<usize>;
+
+inline usize GetElementCount(const Shape& shape)
+{
+  return std::accumulate(shape.begin(), shape.end(), usize{1}, std::multiplies<>());
+}
+
+// number of complex values of the non-redundant half spectrum, the last dimension shrinks to n/2+1
+inline usize GetHalfSpectrumCount(const Shape& shape)
+{
+  return GetElementCount(shape) / shape.back() * (shape.back() / 2 + 1);
+}
+
+inline std::string GetShapeName(const Shape& shape)
+{
+  return fmt::format("{}", fmt::join(shape, "x"));
+}
+
+// Multidimensional real-to-complex forward transform. The output is written in the backend's native layout into a caller-owned buffer of
+// GetOutputCount() complex values, HalfSpectrum converts it to the FFTW half spectrum layout for comparisons.
+class MultidimPlan
+{
+public:
+  explicit MultidimPlan(const Shape& shape) : shape(shape) {}
+  virtual ~MultidimPlan() = default;
+
+  virtual void Forward(const f32* input, std::complex<f32>* output) = 0;
+  virtual usize GetOutputCount() const { return GetHalfSpectrumCount(shape); }
+  virtual std::vector<std::complex<f32>> HalfSpectrum(const std::complex<f32>* output) const { return {output, output + GetHalfSpectrumCount(shape)}; }
+
+  const Shape& GetShape() const { return shape; }
+
+protected:
+  Shape shape;
+
+  // keeps the first n/2+1 columns of a full M x N (x K) complex spectrum
+  std::vector<std::complex<f32>> CropFullSpectrum(const std::complex<f32>* full) const
+  {
+    const usize columns = shape.back();
+    const usize halfColumns = columns / 2 + 1;
+    const usize rows = GetElementCount(shape) / columns;
+    std::vector<std::complex<f32>> half(rows * halfColumns);
+    for (usize row = 0; row < rows; ++row)
+      std::copy_n(full + row * columns, halfColumns, half.begin() + row * halfColumns);
+    return half;
+  }
+};
+
+class FFTWMultidimPlan : public MultidimPlan
+{
+public:
+  FFTWMultidimPlan(const Shape& shape, u32 flags, i32 nthreads) : MultidimPlan(shape)
+  {
+    AlignedBuffer<f32> input(GetElementCount(shape));
+    AlignedBuffer<std::complex<f32>> output(GetHalfSpectrumCount(shape));
+    const std::vector<int> n(shape.begin(), shape.end());
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    fftwf_plan_with_nthreads(nthreads);
+    plan = fftwf_plan_dft_r2c(n.size(), n.data(), input.Data(), reinterpret_cast<fftwf_complex*>(output.Data()), flags);
+    if (not plan)
+      throw std::runtime_error(fmt::format("Failed to create FFTW plan of shape {}", GetShapeName(shape)));
+  }
+  ~FFTWMultidimPlan() override
+  {
+    std::scoped_lock lock(GetFFTWPlannerMutex());
+    fftwf_destroy_plan(plan);
+  }
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    fftwf_execute_dft_r2c(plan, const_cast<f32*>(input), reinterpret_cast<fftwf_complex*>(output));
+  }
+
+private:
+  fftwf_plan plan;
+};
+
+class PocketFFTMultidimPlan : public MultidimPlan
+{
+public:
+  PocketFFTMultidimPlan(const Shape& shape, i32 nthreads) : MultidimPlan(shape), nthreads(nthreads)
+  {
+    Shape outputShape = shape;
+    outputShape.back() = shape.back() / 2 + 1;
+    strideInput.resize(shape.size());
+    strideOutput.resize(shape.size());
+    std::ptrdiff_t inputStride = sizeof(f32), outputStride = sizeof(std::complex<f32>);
+    for (usize axis = shape.size(); axis-- > 0;)
+    {
+      axes.insert(axes.begin(), axis);
+      strideInput[axis] = inputStride;
+      strideOutput[axis] = outputStride;
+      inputStride *= shape[axis];
+      outputStride *= outputShape[axis];
+    }
+  }
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    const f32 factor = 1;
+    pocketfft::r2c(shape, strideInput, strideOutput, axes, pocketfft::FORWARD, input, output, factor, nthreads);
+  }
+
+private:
+  usize nthreads;
+  pocketfft::shape_t axes;
+  pocketfft::stride_t strideInput;
+  pocketfft::stride_t strideOutput;
+};
+
+// 2D only, IPP has no 3D DFT
+class IPPMultidimPlan : public MultidimPlan
+{
+public:
+  IPPMultidimPlan(const Shape& shape, IppHintAlgorithm hint, i32 nthreads) : MultidimPlan(shape), nthreads(nthreads)
+  {
+    if (shape.size() != 2)
+      throw std::invalid_argument(fmt::format("IPP supports 2D transforms only, got {}", GetShapeName(shape)));
+
+    roi = {static_cast<int>(shape[1]), static_cast<int>(shape[0])};
+    const auto flag = IPP_FFT_NODIV_BY_ANY;
+    int sizeDFTSpec, sizeDFTInitBuf, sizeDFTWorkBuf;
+    ippiDFTGetSize_R_32f(roi, flag, hint, &sizeDFTSpec, &sizeDFTInitBuf, &sizeDFTWorkBuf);
+    pDFTSpec = (IppiDFTSpec_R_32f*)ippsMalloc_8u(sizeDFTSpec);
+    workBuffer = AlignedBuffer<u8>(sizeDFTWorkBuf);
+    auto pDFTInitBuf = ippsMalloc_8u(sizeDFTInitBuf);
+    const auto status = ippiDFTInit_R_32f(roi, flag, hint, pDFTSpec, pDFTInitBuf);
+    if (pDFTInitBuf)
+      ippFree(pDFTInitBuf);
+    if (status != ippStsNoErr)
+    {
+      Free();
+      throw std::runtime_error(fmt::format("Failed to initialize IPP DFT of shape {}: {}", GetShapeName(shape), ippGetStatusString(status)));
+    }
+  }
+  ~IPPMultidimPlan() override { Free(); }
+
+  // RCPack2D layout: M x N reals
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    SetIPPThreads(nthreads);
+    const int step = roi.width * sizeof(f32);
+    ippiDFTFwd_RToPack_32f_C1R(input, step, reinterpret_cast<f32*>(output), step, pDFTSpec, workBuffer.Data());
+  }
+
+  usize GetOutputCount() const override { return GetElementCount(shape) / 2 + 1; }
+
+  std::vector<std::complex<f32>> HalfSpectrum(const std::complex<f32>* output) const override
+  {
+    std::vector<std::complex<f32>> full(GetElementCount(shape));
+    ippiPackToCplxExtend_32f32fc_C1R(reinterpret_cast<const f32*>(output), roi, roi.width * sizeof(f32), reinterpret_cast<Ipp32fc*>(full.data()), roi.width * sizeof(Ipp32fc));
+    return CropFullSpectrum(full.data());
+  }
+
+private:
+  i32 nthreads;
+  IppiSize roi;
+  IppiDFTSpec_R_32f* pDFTSpec = nullptr;
+  AlignedBuffer<u8> workBuffer;
+
+  void Free()
+  {
+    if (pDFTSpec)
+      ippFree(pDFTSpec);
+  }
+};
+
+#if defined(ENABLE_KFR) and KFR_VERSION_MAJOR >= 5
+// multidimensional plans were added in KFR 5
+template <usize Dims>
+class KFRMultidimPlan : public MultidimPlan
+{
+public:
+  explicit KFRMultidimPlan(const Shape& shape) : MultidimPlan(shape), plan(ToKFRShape(shape)), temp(plan.temp_size) {}
+
+  void Forward(const f32* input, std::complex<f32>* output) override { plan.execute(reinterpret_cast<kfr::complex<f32>*>(output), input, temp.Data()); }
+
+private:
+  kfr::dft_plan_md_real<f32, Dims> plan;
+  AlignedBuffer<u8> temp;
+
+  static kfr::shape<Dims> ToKFRShape(const Shape& shape)
+  {
+    kfr::shape<Dims> kfrShape;
+    for (usize axis = 0; axis < Dims; ++axis)
+      kfrShape[axis] = shape[axis];
+    return kfrShape;
+  }
+};
+#endif
+
+#ifdef ENABLE_OPENCV
+// 2D only, written as the full complex spectrum (DFT_COMPLEX_OUTPUT) instead of the packed CCS layout
+class OpenCVMultidimPlan : public MultidimPlan
+{
+public:
+  explicit OpenCVMultidimPlan(const Shape& shape) : MultidimPlan(shape)
+  {
+    if (shape.size() != 2)
+      throw std::invalid_argument(fmt::format("OpenCV supports 2D transforms only, got {}", GetShapeName(shape)));
+  }
+
+  void Forward(const f32* input, std::complex<f32>* output) override
+  {
+    const cv::Mat in(shape[0], shape[1], CV_32F, const_cast<f32*>(input));
+    cv::Mat out(shape[0], shape[1], CV_32FC2, output);
+    cv::dft(in, out, cv::DFT_COMPLEX_OUTPUT);
+  }
+
+  usize GetOutputCount() const override { return GetElementCount(shape); }
+
+  std::vector<std::complex<f32>> HalfSpectrum(const std::complex<f32>* output) const override { return CropFullSpectrum(output); }
+};
+#endif
+
+// key.size is ignored, the plan takes the backend, threads and flags from the key
+inline std::unique_ptr<MultidimPlan> CreateMultidimPlan(const PlanKey& key, const Shape& shape)
+{
+  switch (key.backend)
+  {
+  case Backend::FFTW:
+    return std::make_unique<FFTWMultidimPlan>(shape, key.flags, key.threads);
+  case Backend::PocketFFT:
+    return std::make_unique<PocketFFTMultidimPlan>(shape, key.threads);
+  case Backend::IPP:
+    return std::make_unique<IPPMultidimPlan>(shape, static_cast<IppHintAlgorithm>(key.flags), key.threads);
+#if defined(ENABLE_KFR) and KFR_VERSION_MAJOR >= 5
+  case Backend::KFR:
+    if (shape.size() == 2)
+      return std::make_unique<KFRMultidimPlan<2>>(shape);
+    return std::make_unique<KFRMultidimPlan<3>>(shape);
+#endif
+#ifdef ENABLE_OPENCV
+  case Backend::OpenCV:
+    return std::make_unique<OpenCVMultidimPlan>(shape);
+#endif
+  default:
+    throw std::invalid_argument(fmt::format("{} has no multidimensional real transform in this build", GetPlanBaseName(key)));
+  }
+}
+
+inline bool IsMultidimSupported(Backend backend, const Shape& shape)
+{
+  switch (backend)
+  {
+  case Backend::FFTW:
+  case Backend::PocketFFT:
+    return true;
+  case Backend::IPP:
+  case Backend::OpenCV:
+    return shape.size() == 2 and IsBackendAvailable(backend);
+#if defined(ENABLE_KFR) and KFR_VERSION_MAJOR >= 5
+  case Backend::KFR:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+// backends that thread a single multidimensional transform internally
+inline const std::vector<Backend> multidimThreadedBackends{Backend::FFTW, Backend::IPP, Backend::PocketFFT};
@@ -0,0 +1,356 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+#include "Backends.hpp"
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <semaphore>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+
+// Runs load -> compute -> store over a sequence of blocks with the loads and stores on an I/O thread, so reading the next block and writing
+// back the previous one overlap the compute of the current one. Three slots let the I/O thread store block b - 3 and load block b while the
+// compute works on b - 1 or b - 2. Compute may swap the slot buffer with the scratch buffer, e.g. after transposing into it.
+class BlockPipeline
+{
+public:
+  static constexpr usize slots = 3;
+
+  explicit BlockPipeline(usize slotElements) : scratch(slotElements)
+  {
+    for (auto& buffer : buffers)
+      buffer = AlignedBuffer<std::complex<f32>>(slotElements);
+  }
+
+  template <typename Load, typename Compute, typename Store>
+  void Run(usize blocks, Load&& load, Compute&& compute, Store&& store)
+  {
+    std::counting_semaphore<> loaded(0), computed(0);
+    std::thread io(
+        [&]
+        {
+          usize stored = 0;
+          for (usize block = 0; block < blocks; ++block)
+          {
+            if (block >= slots) // the slot of block is free once block - slots is stored
+            {
+              computed.acquire();
+              store(stored, buffers[stored % slots]);
+              ++stored;
+            }
+            load(block, buffers[block % slots]);
+            loaded.release();
+          }
+          for (; stored < blocks; ++stored)
+          {
+            computed.acquire();
+            store(stored, buffers[stored % slots]);
+          }
+        });
+    for (usize block = 0; block < blocks; ++block)
+    {
+      loaded.acquire();
+      compute(block, buffers[block % slots], scratch);
+      computed.release();
+    }
+    io.join();
+  }
+
+  usize GetSlotElements() const { return scratch.Size(); }
+  usize GetBytes() const { return (slots + 1) * scratch.Bytes(); }
+
+private:
+  std::array<AlignedBuffer<std::complex<f32>>, slots> buffers;
+  AlignedBuffer<std::complex<f32>> scratch;
+};
+
+// Real-to-complex transform of data that does not fit in memory. Input and output live in an unlinked scratch file in the given directory,
+// memory mapped, and the transform is the four-step algorithm of FourStepPlan in three passes over the file, each streaming blocks that
+// fit the memory budget through a BlockPipeline:
+//   1. blocks of columns: column FFTs and twiddles, written back in place into the input
+//   2. blocks of rows: row FFTs, transposed into the output in natural order
+//   3. blocks of bin pairs k and M - k from both ends of the output: the split into the real spectrum, in place
+// The input is size floats read as size/2 complex values and is overwritten, the output the FFTW half spectrum. Loads tell the kernel about
+// the block after the next one with MADV_WILLNEED, stores start the write-back of what they wrote with sync_file_range, so dirty pages do
+// not pile up beyond the memory of the machine.
+class OutOfCoreFFT
+{
+public:
+  OutOfCoreFFT(const PlanKey& key, const std::filesystem::path& directory, usize memoryBytes)
+      : size(key.size), half(key.size / 2), nthreads(key.threads), twiddlesHalf(std::max<usize>(half, 1)), twiddlesFull(key.size)
+  {
+    const auto factors = size % 2 == 0 ? GetFourStepFactors(key.backend, half) : std::nullopt;
+    if (not factors)
+      throw std::invalid_argument(fmt::format("{} has no four-step factorization of size {}", GetPlanBaseName(key), size));
+    std::tie(columns, rows) = *factors;
+
+    const usize slotElements = memoryBytes / sizeof(std::complex<f32>) / (BlockPipeline::slots + 1);
+    if (slotElements < 2 * std::max(rows, columns))
+      throw std::invalid_argument(fmt::format("Out-of-core memory of {} bytes is too small for size {}", memoryBytes, size));
+    columnsPerBlock = std::min(slotElements / rows, columns);
+    rowsPerBlock = std::min(slotElements / columns, rows);
+    pairsPerBlock = slotElements / 2;
+    pipeline = std::make_unique<BlockPipeline>(slotElements);
+
+    PlanKey subKey = key;
+    subKey.threads = 1;
+    subKey.algorithm = Algorithm::Direct;
+    const usize stride = (std::max(rows, columns) + 7) / 8 * 8;
+    for (i32 thread = 0; thread < nthreads; ++thread)
+    {
+      subKey.size = rows;
+      columnPlans.push_back(CreateComplexPlan(subKey));
+      subKey.size = columns;
+      rowPlans.push_back(CreateComplexPlan(subKey));
+      threadScratch.emplace_back(2 * stride);
+    }
+
+    MapScratchFile(directory);
+  }
+
+  ~OutOfCoreFFT()
+  {
+    munmap(mapping, fileBytes);
+    close(fd);
+  }
+
+  OutOfCoreFFT(const OutOfCoreFFT&) = delete;
+  OutOfCoreFFT& operator=(const OutOfCoreFFT&) = delete;
+
+  // size values, overwritten by Forward
+  f32* GetInput() { return reinterpret_cast<f32*>(mapping); }
+  // size/2+1 values
+  std::complex<f32>* GetOutput() { return reinterpret_cast<std::complex<f32>*>(static_cast<u8*>(mapping) + outputOffset); }
+
+  usize GetSize() const { return size; }
+  usize GetFileBytes() const { return fileBytes; }
+  usize GetMemoryBytes() const { return pipeline->GetBytes(); }
+
+  void Forward()
+  {
+    TransformColumns();
+    TransformRows();
+    SplitSpectrum();
+  }
+
+private:
+  usize size;
+  usize half;
+  i32 nthreads;
+  usize columns = 0;
+  usize rows = 0;
+  usize columnsPerBlock = 0;
+  usize rowsPerBlock = 0;
+  usize pairsPerBlock = 0;
+  TwiddleTable twiddlesHalf;
+  TwiddleTable twiddlesFull;
+  std::unique_ptr<BlockPipeline> pipeline;
+  std::vector<std::unique_ptr<ComplexPlan>> columnPlans;
+  std::vector<std::unique_ptr<ComplexPlan>> rowPlans;
+  std::vector<AlignedBuffer<std::complex<f32>>> threadScratch;
+  int fd = -1;
+  void* mapping = nullptr;
+  usize fileBytes = 0;
+  usize outputOffset = 0;
+
+  std::complex<f32>* GetMatrix() { return reinterpret_cast<std::complex<f32>*>(mapping); }
+
+  void MapScratchFile(const std::filesystem::path& directory)
+  {
+    const usize pageSize = sysconf(_SC_PAGESIZE);
+    outputOffset = (size * sizeof(f32) + pageSize - 1) / pageSize * pageSize;
+    fileBytes = outputOffset + (half + 1) * sizeof(std::complex<f32>);
+    fd = open(directory.c_str(), O_TMPFILE | O_RDWR, 0600);
+    if (fd < 0)
+      throw std::runtime_error(fmt::format("Failed to create a scratch file in {}", directory.string()));
+    // reserves the blocks up front, so a full disk fails here instead of with SIGBUS in the middle of a pass
+    if (const int error = posix_fallocate(fd, 0, fileBytes); error != 0)
+    {
+      close(fd);
+      throw std::runtime_error(fmt::format("Failed to allocate a scratch file of {} MiB in {}: {}", fileBytes >> 20, directory.string(), std::strerror(error)));
+    }
+    mapping = mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+      close(fd);
+      throw std::runtime_error(fmt::format("Failed to map a scratch file of {} MiB", fileBytes >> 20));
+    }
+  }
+
+  // hints at the pages of [begin, end) elements of the mapping, MADV_WILLNEED starts reading them asynchronously
+  void Prefetch(const std::complex<f32>* begin, const std::complex<f32>* end)
+  {
+    const usize pageSize = sysconf(_SC_PAGESIZE);
+    const auto first = reinterpret_cast<uintptr_t>(begin) / pageSize * pageSize;
+    madvise(reinterpret_cast<void*>(first), reinterpret_cast<uintptr_t>(end) - first, MADV_WILLNEED);
+  }
+
+  // starts the write-back of the dirty pages of [begin, end) elements without waiting for it
+  void WriteBack(const std::complex<f32>* begin, const std::complex<f32>* end)
+  {
+    const auto offset = reinterpret_cast<const u8*>(begin) - static_cast<const u8*>(mapping);
+    sync_file_range(fd, offset, reinterpret_cast<const u8*>(end) - reinterpret_cast<const u8*>(begin), SYNC_FILE_RANGE_WRITE);
+  }
+
+  // FFT of a contiguous line through the thread scratch, since the lines of a block are only aligned when their length is
+  void ForwardLine(ComplexPlan& plan, std::complex<f32>* line, usize length)
+  {
+    auto* input = threadScratch[omp_get_thread_num()].Data();
+    auto* output = input + threadScratch[omp_get_thread_num()].Size() / 2;
+    std::memcpy(input, line, length * sizeof(std::complex<f32>));
+    plan.Forward(input, output);
+    std::memcpy(line, output, length * sizeof(std::complex<f32>));
+  }
+
+  // transposes a matrix of height x width elements in tiles that fit the L1 cache
+  void Transpose(const std::complex<f32>* input, std::complex<f32>* output, usize height, usize width)
+  {
+    static constexpr usize tile = 32;
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (usize r0 = 0; r0 < height; r0 += tile)
+      for (usize c0 = 0; c0 < width; c0 += tile)
+        for (usize r = r0; r < std::min(r0 + tile, height); ++r)
+          for (usize c = c0; c < std::min(c0 + tile, width); ++c)
+            output[c * height + r] = input[r * width + c];
+  }
+
+  // columns [first, first + count) of all rows, stored row by row
+  void TransformColumns()
+  {
+    auto* matrix = GetMatrix();
+    const usize blocks = (columns + columnsPerBlock - 1) / columnsPerBlock;
+    const auto count = [&](usize block) { return std::min(columnsPerBlock, columns - block * columnsPerBlock); };
+    pipeline->Run(
+        blocks,
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer)
+        {
+          const usize first = block * columnsPerBlock, width = count(block);
+          for (usize r = 0; r < rows; ++r)
+            std::memcpy(buffer.Data() + r * width, matrix + r * columns + first, width * sizeof(std::complex<f32>));
+        },
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer, AlignedBuffer<std::complex<f32>>& scratch)
+        {
+          const usize first = block * columnsPerBlock, width = count(block);
+          Transpose(buffer.Data(), scratch.Data(), rows, width);
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+          for (usize c = 0; c < width; ++c)
+          {
+            auto* column = scratch.Data() + c * rows;
+            ForwardLine(*columnPlans[omp_get_thread_num()], column, rows);
+            for (usize r = 0; r < rows; ++r)
+              column[r] = Multiply(column[r], twiddlesHalf((first + c) * r));
+          }
+          Transpose(scratch.Data(), buffer.Data(), width, rows);
+        },
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer)
+        {
+          const usize first = block * columnsPerBlock, width = count(block);
+          for (usize r = 0; r < rows; ++r)
+            std::memcpy(matrix + r * columns + first, buffer.Data() + r * width, width * sizeof(std::complex<f32>));
+          WriteBack(matrix + first, matrix + (rows - 1) * columns + first + width);
+        });
+  }
+
+  // rows [first, first + count), written to the output transposed, i.e. column c of the block to output[c * rows + first, + count)
+  void TransformRows()
+  {
+    auto* matrix = GetMatrix();
+    auto* output = GetOutput();
+    const usize blocks = (rows + rowsPerBlock - 1) / rowsPerBlock;
+    const auto count = [&](usize block) { return std::min(rowsPerBlock, rows - block * rowsPerBlock); };
+    pipeline->Run(
+        blocks,
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer)
+        {
+          const usize first = block * rowsPerBlock;
+          if (const usize next = first + 2 * rowsPerBlock; next < rows)
+            Prefetch(matrix + next * columns, matrix + std::min(next + rowsPerBlock, rows) * columns);
+          std::memcpy(buffer.Data(), matrix + first * columns, count(block) * columns * sizeof(std::complex<f32>));
+        },
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer, AlignedBuffer<std::complex<f32>>& scratch)
+        {
+          const usize height = count(block);
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+          for (usize r = 0; r < height; ++r)
+            ForwardLine(*rowPlans[omp_get_thread_num()], buffer.Data() + r * columns, columns);
+          Transpose(buffer.Data(), scratch.Data(), height, columns);
+          std::swap(buffer, scratch);
+        },
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer)
+        {
+          const usize first = block * rowsPerBlock, height = count(block);
+          for (usize c = 0; c < columns; ++c)
+            std::memcpy(output + c * rows + first, buffer.Data() + c * height, height * sizeof(std::complex<f32>));
+          WriteBack(output + first, output + (columns - 1) * rows + first + height);
+        });
+  }
+
+  // bins [first, first + count) and their mirrors (half - first - count, half - first], the slot holds the bins followed by the mirrors
+  // in reverse order, so pair i is (slot[i], slot[count + i]); FourStepPlan::SplitSpectrum has the math
+  void SplitSpectrum()
+  {
+    auto* spectrum = GetOutput();
+    const auto z0 = spectrum[0];
+    spectrum[0] = {z0.real() + z0.imag(), 0};
+    spectrum[half] = {z0.real() - z0.imag(), 0};
+
+    const usize pairs = half / 2; // k = 1 .. half / 2
+    const usize blocks = (pairs + pairsPerBlock - 1) / pairsPerBlock;
+    const auto count = [&](usize block) { return std::min(pairsPerBlock, pairs - block * pairsPerBlock); };
+    pipeline->Run(
+        blocks,
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer)
+        {
+          const usize first = 1 + block * pairsPerBlock, n = count(block);
+          if (const usize next = first + 2 * pairsPerBlock; next <= pairs)
+          {
+            const usize last = std::min(next + pairsPerBlock, pairs + 1);
+            Prefetch(spectrum + next, spectrum + last);
+            Prefetch(spectrum + half + 1 - last, spectrum + half + 1 - next);
+          }
+          std::memcpy(buffer.Data(), spectrum + first, n * sizeof(std::complex<f32>));
+          std::reverse_copy(spectrum + half + 1 - first - n, spectrum + half + 1 - first, buffer.Data() + n);
+        },
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer, AlignedBuffer<std::complex<f32>>&)
+        {
+          const usize first = 1 + block * pairsPerBlock, n = count(block);
+          auto* front = buffer.Data();
+          auto* back = buffer.Data() + n;
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+          for (usize i = 0; i < n; ++i)
+          {
+            const auto a = front[i];
+            const auto b = std::conj(back[i]);
+            const auto even = (a + b) * 0.5f;
+            const auto odd = Multiply(a - b, {0, -0.5f});
+            const auto rotated = Multiply(twiddlesFull(first + i), odd);
+            front[i] = even + rotated;
+            back[i] = std::conj(even - rotated);
+          }
+        },
+        [&](usize block, AlignedBuffer<std::complex<f32>>& buffer)
+        {
+          const usize first = 1 + block * pairsPerBlock, n = count(block);
+          std::memcpy(spectrum + first, buffer.Data(), n * sizeof(std::complex<f32>));
+          std::reverse_copy(buffer.Data() + n, buffer.Data() + 2 * n, spectrum + half + 1 - first - n);
+          WriteBack(spectrum + first, spectrum + first + n);
+          WriteBack(spectrum + half + 1 - first - n, spectrum + half + 1 - first);
+        });
+  }
+};
+
+// out-of-core benchmark layout, empty sizes disable it. The scratch file goes to data/ next to the results, the temporary directory is
+// tmpfs on most distributions.
+struct OutOfCoreConfig
+{
+  std::vector<usize> sizes;
+  std::string directory = (std::filesystem::current_path().parent_path() / "data").string();
+  usize memoryBytes = usize{1} << 30;
+};
+
+// tmpfs and ramfs keep files in memory, out-of-core benchmarks there never touch storage
+inline bool IsMemoryFilesystem(const std::filesystem::path& directory)
+{
+  struct statfs info{};
+  return statfs(directory.c_str(), &info) == 0 and (info.f_type == TMPFS_MAGIC or info.f_type == RAMFS_MAGIC);
+}
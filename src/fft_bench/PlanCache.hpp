@@ -0,0 +1,111 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "Backends.hpp"
+#include "DoublePrecision.hpp"
+#include "utils/MemoryTracker.hpp"
+
+// Thread-safe LRU cache of plans keyed by (backend, size, precision, threads, flags) and the current buffer strategy, which provides the
+// scratch of plans created on a miss, see BufferArena.hpp. Plans are created on a miss while holding the lock. Handed out plans stay alive
+// after eviction until their last user is done. PlanCache holds the single precision plans, PlanCache64 the
+// double precision ones.
+template <typename Plan, std::unique_ptr<Plan> (*Create)(const PlanKey&)>
+class PlanCacheT
+{
+public:
+  struct Stats
+  {
+    usize hits = 0;
+    usize misses = 0;
+    usize evictions = 0;
+    f64 planSeconds = 0; // total time spent creating plans on misses
+  };
+
+  explicit PlanCacheT(usize capacity = 8) : capacity(std::max<usize>(capacity, 1)) {}
+
+  static PlanCacheT& Global()
+  {
+    static PlanCacheT cache;
+    return cache;
+  }
+
+  std::shared_ptr<Plan> Get(const PlanKey& key)
+  {
+    const CacheKey cacheKey{key, BufferArena::Global().GetStrategy()};
+    std::scoped_lock lock(mutex);
+    if (const auto it = index.find(cacheKey); it != index.end())
+    {
+      ++stats.hits;
+      entries.splice(entries.begin(), entries, it->second);
+      return it->second->plan;
+    }
+
+    ++stats.misses;
+    const auto heapBefore = MemoryTracker::GetCurrentBytes();
+    const auto tic = std::chrono::steady_clock::now();
+    std::shared_ptr<Plan> plan = Create(key);
+    stats.planSeconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - tic).count();
+    const auto heapAfter = MemoryTracker::GetCurrentBytes();
+
+    entries.push_front({cacheKey, plan, heapAfter > heapBefore ? heapAfter - heapBefore : 0});
+    index[cacheKey] = entries.begin();
+    while (entries.size() > capacity)
+    {
+      index.erase(entries.back().key);
+      entries.pop_back();
+      ++stats.evictions;
+    }
+    return plan;
+  }
+
+  void SetCapacity(usize newCapacity)
+  {
+    std::scoped_lock lock(mutex);
+    capacity = std::max<usize>(newCapacity, 1);
+    while (entries.size() > capacity)
+    {
+      index.erase(entries.back().key);
+      entries.pop_back();
+      ++stats.evictions;
+    }
+  }
+
+  void Clear()
+  {
+    std::scoped_lock lock(mutex);
+    entries.clear();
+    index.clear();
+  }
+
+  // heap retained by creating the plan of a cached key under the current buffer strategy, see MemoryTracker
+  usize GetPlanBytes(const PlanKey& key) const
+  {
+    std::scoped_lock lock(mutex);
+    const auto it = index.find({key, BufferArena::Global().GetStrategy()});
+    return it != index.end() ? it->second->planBytes : 0;
+  }
+
+  Stats GetStats() const
+  {
+    std::scoped_lock lock(mutex);
+    return stats;
+  }
+
+private:
+  using CacheKey = std::pair<PlanKey, PageStrategy>;
+
+  struct Entry
+  {
+    CacheKey key;
+    std::shared_ptr<Plan> plan;
+    usize planBytes;
+  };
+
+  mutable std::mutex mutex;
+  usize capacity;
+  std::list<Entry> entries; // most recently used first
+  std::map<CacheKey, typename std::list<Entry>::iterator> index;
+  Stats stats;
+};
+
+using PlanCache = PlanCacheT<FFTPlan, CreatePlan>;
+using PlanCache64 = PlanCacheT<FFTPlan64, CreatePlan64>;
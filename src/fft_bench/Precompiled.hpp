@@ -1,10 +1,32 @@
 #include <iostream>
 #include <vector>
+#include <array>
+#include <optional>
+#include <limits>
 #include <string>
 #include <exception>
 #include <complex>
+#include <mutex>
+#include <thread>
+#include <map>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <list>
+#include <numeric>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <omp.h>
+#include <unistd.h>
 
 #include <fmt/format.h>
+#include <fmt/ranges.h>
 #include <benchmark/benchmark.h>
 #include <fftw/api/fftw3.h>
 #include <ipp.h>
@@ -0,0 +1,255 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "Backends.hpp"
+#include "Config.hpp"
+#include "utils/CpuInfo.hpp"
+#include "utils/Json.hpp"
+
+// Results file written next to the console output, one JSON object per line. The first line ("type": "context") describes the machine,
+// the libraries and the configuration, every following line ("type": "run") one repetition of a benchmark with its structured fields, the
+// time per iteration in seconds and all counters. Aggregates are left out, fft_compare derives its statistics from the repetitions.
+
+// structured fields of a benchmark recorded at registration, so that readers of the results never parse the display name
+struct BenchmarkLabels
+{
+  usize size = 0; // 0 for benchmarks over several sizes, e.g. the mixed jobs, which the results file lists without a size
+  PlanKey key;
+  std::string plan;    // display name of the plan, GetPlanName(key) unless a benchmark names it differently
+  std::string variant; // what the name adds besides size and plan: transform, cache mode, latency setup, instances, batch, shape ...
+};
+
+inline std::string GetPrecisionName(Precision precision)
+{
+  return precision == Precision::F64 ? "f64" : "f32";
+}
+
+inline std::string GetAlgorithmName(Algorithm algorithm)
+{
+  return algorithm == Algorithm::FourStep ? "four-step" : "direct";
+}
+
+class ResultsStore
+{
+public:
+  static ResultsStore& Global()
+  {
+    static ResultsStore store;
+    return store;
+  }
+
+  void SetLabels(const std::string& name, BenchmarkLabels labels)
+  {
+    if (labels.plan.empty())
+      labels.plan = GetPlanName(labels.key);
+    this->labels[name] = std::move(labels);
+  }
+
+  const BenchmarkLabels* GetLabels(const std::string& name) const
+  {
+    const auto it = labels.find(name);
+    return it != labels.end() ? &it->second : nullptr;
+  }
+
+  // also shown in the console context and the --benchmark_out files of google-benchmark
+  void AddContext(const std::string& key, const std::string& value)
+  {
+    context.emplace_back(key, value);
+    benchmark::AddCustomContext(key, value);
+  }
+
+  const std::vector<std::pair<std::string, std::string>>& GetContext() const { return context; }
+
+private:
+  std::map<std::string, BenchmarkLabels> labels;
+  std::vector<std::pair<std::string, std::string>> context;
+};
+
+// registers a benchmark under its display name and records its structured fields for the results file
+template <typename... Args>
+benchmark::internal::Benchmark* RegisterLabeledBenchmark(const std::string& name, const BenchmarkLabels& labels, Args&&... args)
+{
+  ResultsStore::Global().SetLabels(name, labels);
+  return benchmark::RegisterBenchmark(name.c_str(), std::forward<Args>(args)...);
+}
+
+// machine, build and library versions, the wisdom state and the IPP version are added by InitBackends
+inline void AddMachineContext(const BenchmarkConfig& config)
+{
+  auto& store = ResultsStore::Global();
+  const auto cpu = ReadCpuInfo();
+  store.AddContext("cpu", cpu.model);
+  store.AddContext("cpuFlags", cpu.isa);
+  store.AddContext("hardwareThreads", std::to_string(std::thread::hardware_concurrency()));
+  store.AddContext("buildIsa", simdIsaName);
+#ifdef NDEBUG
+  store.AddContext("buildType", "release");
+#else
+  store.AddContext("buildType", "debug");
+#endif
+  store.AddContext("compiler", __VERSION__);
+  store.AddContext("fftw", fftwf_version);
+  store.AddContext("fftwDouble", fftw_version);
+#ifdef ENABLE_KFR
+  store.AddContext("kfr", kfr::library_version());
+#endif
+#ifdef ENABLE_OPENCV
+  store.AddContext("opencv", CV_VERSION);
+#endif
+  store.AddContext("threads", fmt::format("{}", fmt::join(config.threads, ",")));
+  std::vector<std::string> backends;
+  std::ranges::transform(config.backends, std::back_inserter(backends), GetBackendName);
+  store.AddContext("backends", fmt::format("{}", fmt::join(backends, ",")));
+  std::vector<std::string> strategies;
+  std::ranges::transform(config.bufferStrategies, std::back_inserter(strategies), GetPageStrategyName);
+  store.AddContext("buffers", fmt::format("{}", fmt::join(strategies, ",")));
+  std::string thp = "unknown";
+  std::getline(std::ifstream("/sys/kernel/mm/transparent_hugepage/enabled"), thp);
+  store.AddContext("thp", thp);
+}
+
+// the reporter google-benchmark would display with for --benchmark_format and --benchmark_counters_tabular, it ignores both flags when
+// given a reporter of its own; reads the flags from the arguments left for benchmark::Initialize, before it consumes them
+inline std::unique_ptr<benchmark::BenchmarkReporter> CreateDisplayReporter(int argc, char** argv)
+{
+  std::string format = "console";
+  bool tabular = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const auto value = arg.substr(arg.find('=') + 1);
+    if (arg.starts_with("--benchmark_format="))
+      format = value;
+    else if (arg == "--benchmark_counters_tabular")
+      tabular = true;
+    else if (arg.starts_with("--benchmark_counters_tabular="))
+      tabular = ParseBool(value);
+  }
+
+  if (format == "console")
+  {
+    auto options = isatty(STDOUT_FILENO) ? benchmark::ConsoleReporter::OO_Color : benchmark::ConsoleReporter::OO_None;
+    if (tabular)
+      options = static_cast<benchmark::ConsoleReporter::OutputOptions>(options | benchmark::ConsoleReporter::OO_Tabular);
+    return std::make_unique<benchmark::ConsoleReporter>(options);
+  }
+  if (format == "json")
+    return std::make_unique<benchmark::JSONReporter>();
+  if (format == "csv")
+  {
+    BENCHMARK_DISABLE_DEPRECATED_WARNING // still what google-benchmark itself displays for csv
+    return std::make_unique<benchmark::CSVReporter>();
+    BENCHMARK_RESTORE_DEPRECATED_WARNING
+  }
+  throw std::invalid_argument(fmt::format("Unknown benchmark format '{}'", format));
+}
+
+// the display reporter's output plus the results file, which is flushed after every run so that an aborted run keeps its results
+class ResultsReporter : public benchmark::BenchmarkReporter
+{
+public:
+  ResultsReporter(const std::filesystem::path& path, std::unique_ptr<benchmark::BenchmarkReporter> display) : path(path), display(std::move(display))
+  {
+    if (path.has_parent_path())
+      std::filesystem::create_directories(path.parent_path());
+    file.open(path);
+    if (not file)
+      throw std::runtime_error(fmt::format("Failed to open results file {}", path.string()));
+  }
+
+  bool ReportContext(const Context& context) override
+  {
+    std::string line = fmt::format(R"({{"type": "context", "date": {}, "host": {}, "mhz": {}, "cpus": {}, "cpuScaling": {})",
+        JsonString(GetDate()), JsonString(context.sys_info.name), JsonNumber(context.cpu_info.cycles_per_second / 1e6), context.cpu_info.num_cpus,
+        JsonString(GetScalingName(context.cpu_info.scaling)));
+    std::vector<std::string> caches;
+    for (const auto& cache : context.cpu_info.caches)
+      caches.push_back(JsonString(fmt::format("L{} {} {} KiB x{}", cache.level, cache.type, cache.size / 1024, cache.num_sharing)));
+    line += fmt::format(R"(, "caches": [{}])", fmt::join(caches, ", "));
+    for (const auto& [key, value] : ResultsStore::Global().GetContext())
+      line += fmt::format(", {}: {}", JsonString(key), JsonString(value));
+    Write(line + "}");
+    return display->ReportContext(context);
+  }
+
+  void ReportRuns(const std::vector<Run>& reports) override
+  {
+    display->ReportRuns(reports);
+    for (const auto& run : reports)
+      if (run.run_type == Run::RT_Iteration)
+        Write(FormatRun(run));
+  }
+
+  void Finalize() override
+  {
+    display->Finalize();
+    fmt::print("Results: {}\n", path.string());
+  }
+
+private:
+  std::filesystem::path path;
+  std::unique_ptr<benchmark::BenchmarkReporter> display;
+  std::ofstream file;
+
+  void Write(const std::string& line)
+  {
+    file << line << '\n';
+    file.flush();
+  }
+
+  static std::string GetDate()
+  {
+    const auto now = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&now, &tm);
+    char buffer[64];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S%z", &tm);
+    return buffer;
+  }
+
+  static std::string GetScalingName(benchmark::CPUInfo::Scaling scaling)
+  {
+    switch (scaling)
+    {
+    case benchmark::CPUInfo::ENABLED:
+      return "enabled";
+    case benchmark::CPUInfo::DISABLED:
+      return "disabled";
+    default:
+      return "unknown";
+    }
+  }
+
+  // google-benchmark 1.8 replaced error_occurred and error_message of the runs by skipped and skip_message
+  template <typename R>
+  static std::optional<std::string> GetErrorMessage(const R& run)
+  {
+    if constexpr (requires { run.skipped; })
+      return run.skipped ? std::optional(run.skip_message) : std::nullopt;
+    else
+      return run.error_occurred ? std::optional(run.error_message) : std::nullopt;
+  }
+
+  static std::string FormatRun(const Run& run)
+  {
+    const f64 iterations = std::max<f64>(run.iterations, 1);
+    std::string line = fmt::format(R"({{"type": "run", "name": {}, "repetition": {}, "repetitions": {}, "threads": {}, "iterations": {}, "realTime": {}, "cpuTime": {})",
+        JsonString(run.benchmark_name()), std::max<i64>(run.repetition_index, 0), run.repetitions, run.threads, run.iterations,
+        JsonNumber(run.real_accumulated_time / iterations), JsonNumber(run.cpu_accumulated_time / iterations));
+
+    if (const auto labels = ResultsStore::Global().GetLabels(run.run_name.function_name))
+    {
+      if (labels->size > 0)
+        line += fmt::format(R"(, "size": {})", labels->size);
+      line += fmt::format(R"(, "backend": {}, "plan": {}, "planThreads": {}, "precision": {}, "algorithm": {}, "variant": {})",
+          JsonString(GetBackendName(labels->key.backend)), JsonString(labels->plan), labels->key.threads, JsonString(GetPrecisionName(labels->key.precision)),
+          JsonString(GetAlgorithmName(labels->key.algorithm)), JsonString(labels->variant));
+    }
+    if (const auto error = GetErrorMessage(run))
+      line += fmt::format(R"(, "error": {})", JsonString(*error));
+
+    std::vector<std::string> counters;
+    for (const auto& [name, counter] : run.counters)
+      counters.push_back(fmt::format("{}: {}", JsonString(name), JsonNumber(counter.value)));
+    return line + fmt::format(R"(, "counters": {{{}}}}})", fmt::join(counters, ", "));
+  }
+};
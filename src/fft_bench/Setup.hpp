@@ -0,0 +1,241 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+#include "Backends.hpp"
+#include "Math.hpp"
+#include "utils/FFTWWisdom.hpp"
+#include "utils/Memory.hpp"
+#include "utils/MemoryTracker.hpp"
+#include <sys/wait.h>
+
+// Time to first transform of a plan. Process-cold setup runs in a fresh fft_bench process started with setupProbeOption, which
+// initializes the libraries (FFTW threads, IPP CPU dispatch, FFTW wisdom), creates the plan and transforms once, the way a short-lived
+// job does. Process-warm setup repeats plan creation and first transform in the benchmark process, where the libraries are initialized
+// and FFTW remembers the plans it measured before. Both also time the steady-state transform, so the setup can be expressed in transforms.
+struct SetupCost
+{
+  f64 initSeconds = 0;      // fftwf_init_threads and ippInit, process-cold only
+  f64 wisdomSeconds = 0;    // loading the FFTW wisdom file, process-cold only
+  f64 planSeconds = 0;      // plan creation
+  f64 firstSeconds = 0;     // first transform, including lazily created plans and buffers and first-touch page faults
+  f64 transformSeconds = 0; // median steady-state transform
+  f64 spawnSeconds = 0;     // fork of the probe to the end of its first transform, with exec, loading and static initialization, process-cold only
+  usize planBytes = 0;      // heap retained by the plan, see MemoryTracker
+  usize residentBytes = 0;  // peak resident memory growth from the start of the setup to the first transform, process-cold only
+
+  // everything before the first transform plus what the first transform costs on top of a steady-state one
+  f64 GetSetupSeconds() const { return initSeconds + wisdomSeconds + planSeconds + std::max(firstSeconds - transformSeconds, 0.0); }
+  f64 GetFirstTransformSeconds() const { return initSeconds + wisdomSeconds + planSeconds + firstSeconds; }
+
+  // transforms that take as long as the setup, beyond them the setup is less than half of the total time
+  f64 GetBreakEven() const { return transformSeconds > 0 ? GetSetupSeconds() / transformSeconds : 0; }
+};
+
+inline constexpr const char* setupProbeOption = "--fft_setup_probe";
+
+// plan creation, first transform and the median of steady-state transforms for up to 20 transforms or 0.2 s
+inline SetupCost MeasureSetup(const PlanKey& key, std::chrono::steady_clock::time_point* firstDone = nullptr)
+{
+  const auto pattern = GenerateRandomVector(key.size);
+  AlignedBuffer<f32> input(key.size);
+  AlignedBuffer<std::complex<f32>> output(key.size / 2 + 1);
+  std::memcpy(input.Data(), pattern.data(), key.size * sizeof(f32));
+  const auto seconds = [](auto tic) { return std::chrono::duration<f64>(std::chrono::steady_clock::now() - tic).count(); };
+
+  SetupCost cost;
+  const auto heapBefore = MemoryTracker::GetCurrentBytes();
+  auto tic = std::chrono::steady_clock::now();
+  const auto plan = CreatePlan(key);
+  cost.planSeconds = seconds(tic);
+  const auto heapAfter = MemoryTracker::GetCurrentBytes();
+  cost.planBytes = heapAfter > heapBefore ? heapAfter - heapBefore : 0;
+
+  tic = std::chrono::steady_clock::now();
+  plan->Forward(input.Data(), output.Data());
+  cost.firstSeconds = seconds(tic);
+  if (firstDone)
+    *firstDone = std::chrono::steady_clock::now();
+
+  std::vector<f64> times;
+  const auto start = std::chrono::steady_clock::now();
+  while (times.size() < 3 or (times.size() < 20 and seconds(start) < 0.2))
+  {
+    tic = std::chrono::steady_clock::now();
+    plan->Forward(input.Data(), output.Data());
+    times.push_back(seconds(tic));
+  }
+  std::ranges::nth_element(times, times.begin() + times.size() / 2);
+  cost.transformSeconds = times[times.size() / 2];
+  return cost;
+}
+
+// entry point of the probe process: fft_bench --fft_setup_probe <size> <backend> <flags> <threads> <wisdom path or none>, writes one line
+// with the SetupCost fields and the steady clock at the end of the first transform, which is CLOCK_MONOTONIC and comparable across processes
+inline int RunSetupProbe(int argc, char** argv)
+try
+{
+  const auto residentBefore = GetPeakResidentMemory();
+  if (argc != 7)
+    throw std::invalid_argument(fmt::format("{} expects size, backend, flags, threads and wisdom path", setupProbeOption));
+  PlanKey key{.backend = ParseBackend(argv[3]), .size = std::stoull(argv[2]), .threads = std::stoi(argv[5]), .flags = static_cast<u32>(std::stoul(argv[4]))};
+  const std::string wisdomPath = argv[6];
+
+  auto tic = std::chrono::steady_clock::now();
+  if (not fftwf_init_threads())
+    throw std::runtime_error("Failed to initialize FFTW threads");
+  ippInit();
+  const f64 initSeconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - tic).count();
+
+  tic = std::chrono::steady_clock::now();
+  if (wisdomPath != "none")
+    LoadWisdom(wisdomPath);
+  const f64 wisdomSeconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - tic).count();
+
+  std::chrono::steady_clock::time_point firstDone;
+  auto cost = MeasureSetup(key, &firstDone);
+  cost.initSeconds = initSeconds;
+  cost.wisdomSeconds = wisdomSeconds;
+  cost.residentBytes = GetPeakResidentMemory() - residentBefore;
+  fmt::print("{} {} {} {} {} {} {} {}\n", cost.initSeconds, cost.wisdomSeconds, cost.planSeconds, cost.firstSeconds, cost.transformSeconds, cost.planBytes,
+             cost.residentBytes, firstDone.time_since_epoch().count());
+  return EXIT_SUCCESS;
+}
+catch (const std::exception& e)
+{
+  fmt::print(stderr, "{}\n", e.what());
+  return EXIT_FAILURE;
+}
+
+// Cold setup runs a fixed number of probes. Only the probe's time to first transform is the manual time, so google-benchmark would size the
+// run without the process start and the library initialization and spawn far more processes than needed for a stable mean.
+inline constexpr benchmark::IterationCount coldSetupIterations = 10;
+
+// runs the probe in a fresh process of this executable, the child only execs after the fork since this process may run library threads
+inline SetupCost MeasureColdSetup(const PlanKey& key, const std::string& wisdomPath)
+{
+  const std::vector<std::string> args{"/proc/self/exe", setupProbeOption, std::to_string(key.size), GetBackendName(key.backend), std::to_string(key.flags),
+                                      std::to_string(key.threads), wisdomPath};
+  std::vector<char*> argv;
+  for (const auto& arg : args)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  int fds[2];
+  if (pipe(fds) != 0)
+    throw std::runtime_error("Failed to create the setup probe pipe");
+  const auto tic = std::chrono::steady_clock::now();
+  const pid_t pid = fork();
+  if (pid < 0)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    throw std::runtime_error("Failed to fork the setup probe");
+  }
+  if (pid == 0)
+  {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+
+  close(fds[1]);
+  std::string output;
+  char buffer[256];
+  for (ssize_t count; (count = read(fds[0], buffer, sizeof(buffer))) != 0;)
+    if (count > 0)
+      output.append(buffer, count);
+    else if (errno != EINTR)
+      break;
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  SetupCost cost;
+  std::chrono::steady_clock::rep firstDone = 0;
+  std::istringstream stream(output);
+  if (not WIFEXITED(status) or WEXITSTATUS(status) != EXIT_SUCCESS or
+      not(stream >> cost.initSeconds >> cost.wisdomSeconds >> cost.planSeconds >> cost.firstSeconds >> cost.transformSeconds >> cost.planBytes >> cost.residentBytes >> firstDone))
+    throw std::runtime_error(fmt::format("Setup probe of {} size {} failed", GetPlanName(key), key.size));
+  cost.spawnSeconds = std::chrono::duration<f64>(std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(firstDone)) - tic).count();
+  return cost;
+}
+
+// Setup and transform times measured by the setup benchmarks. For a job of n transforms of one size, the total time of a plan is
+// setup + n * transform, so the best plan changes with n: cheap setups win short jobs, fast transforms long ones. Print lists for
+// every size the plans on the lower envelope of these lines and the job lengths each of them wins.
+class SetupAdvisor
+{
+public:
+  static SetupAdvisor& Global()
+  {
+    static SetupAdvisor advisor;
+    return advisor;
+  }
+
+  void Record(const PlanKey& key, bool cold, const SetupCost& cost)
+  {
+    std::scoped_lock lock(mutex);
+    entries[{key.size, cold}][key] = {cost.GetSetupSeconds(), cost.transformSeconds};
+  }
+
+  void Print() const
+  {
+    std::scoped_lock lock(mutex);
+    if (not entries.empty())
+      fmt::print("Best plan by transforms per job:\n");
+    for (const auto& [group, plans] : entries)
+    {
+      const auto& [size, cold] = group;
+      std::vector<std::string> ranges;
+      for (const auto& [key, first, last] : GetEnvelope(plans))
+        ranges.push_back(fmt::format("{} {}", GetPlanName(key), last == 0 ? fmt::format("{}+", first) : fmt::format("{}-{}", first, last)));
+      fmt::print("  {:>8} {:<13} {}\n", size, cold ? "process-cold" : "process-warm", fmt::join(ranges, ", "));
+    }
+  }
+
+private:
+  struct Line
+  {
+    f64 setup;
+    f64 transform;
+  };
+
+  mutable std::mutex mutex;
+  std::map<std::pair<usize, bool>, std::map<PlanKey, Line>> entries;
+
+  // plans with the lowest setup + n * transform and the first and last n they win, last 0 for unbounded
+  static std::vector<std::tuple<PlanKey, u64, u64>> GetEnvelope(const std::map<PlanKey, Line>& plans)
+  {
+    const auto total = [](const Line& line, f64 n) { return line.setup + n * line.transform; };
+    std::vector<std::tuple<PlanKey, u64, u64>> envelope;
+    auto current = std::ranges::min_element(plans, {}, [&](const auto& plan) { return total(plan.second, 1); });
+    u64 first = 1;
+    while (true)
+    {
+      // the next plan overtaking the current one is the one with a faster transform whose line crosses first
+      f64 crossing = std::numeric_limits<f64>::infinity();
+      auto next = plans.end();
+      for (auto it = plans.begin(); it != plans.end(); ++it)
+        if (it->second.transform < current->second.transform)
+        {
+          const f64 n = (it->second.setup - current->second.setup) / (current->second.transform - it->second.transform);
+          if (n < crossing)
+          {
+            crossing = n;
+            next = it;
+          }
+        }
+      if (next == plans.end() or crossing >= static_cast<f64>(std::numeric_limits<u64>::max() / 2))
+      {
+        envelope.emplace_back(current->first, first, 0);
+        return envelope;
+      }
+      const auto last = static_cast<u64>(std::max(std::floor(crossing), static_cast<f64>(first)));
+      envelope.emplace_back(current->first, first, last);
+      first = last + 1;
+      current = next;
+    }
+  }
+};
@@ -0,0 +1,232 @@
+#pragma once
+#include "Precompiled.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+enum class SignalFormat
+{
+  Auto,
+  F32,
+  I16,
+  Wav,
+};
+
+inline SignalFormat ParseSignalFormat(const std::string& str)
+{
+  static const std::map<std::string, SignalFormat> formats{{"auto", SignalFormat::Auto}, {"f32", SignalFormat::F32}, {"i16", SignalFormat::I16}, {"wav", SignalFormat::Wav}};
+  if (const auto it = formats.find(str); it != formats.end())
+    return it->second;
+  throw std::invalid_argument(fmt::format("Unknown signal format '{}'", str));
+}
+
+// .wav files are parsed, .i16, .s16 and .pcm are raw int16, everything else raw float32
+inline SignalFormat GetSignalFormat(const std::filesystem::path& path)
+{
+  const auto extension = path.extension().string();
+  if (extension == ".wav")
+    return SignalFormat::Wav;
+  if (extension == ".i16" or extension == ".s16" or extension == ".pcm")
+    return SignalFormat::I16;
+  return SignalFormat::F32;
+}
+
+// Read-only memory map of a signal file, either raw little endian float32 or int16 samples or a WAV file with 16-bit PCM or 32-bit float
+// samples. Samples are converted to f32 while reading, int16 scaled to [-1, 1), and of multi-channel WAV files only the first channel is
+// read. Nothing is read up front: pages are faulted in by the reads, sequential reads keep a window of readAheadBytes ahead of them
+// requested from the kernel.
+class SignalFile
+{
+public:
+  static constexpr usize readAheadBytes = 16 << 20;
+
+  explicit SignalFile(const std::filesystem::path& path, SignalFormat format = SignalFormat::Auto)
+  {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error(fmt::format("Failed to open signal file {}", path.string()));
+    struct stat info{};
+    if (fstat(fd, &info) != 0 or info.st_size == 0)
+    {
+      close(fd);
+      throw std::runtime_error(fmt::format("Empty signal file {}", path.string()));
+    }
+    fileBytes = info.st_size;
+    mapping = mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+      close(fd);
+      throw std::runtime_error(fmt::format("Failed to map signal file {}", path.string()));
+    }
+    // hints only, huge pages of file mappings need a kernel with read-only THP for file systems
+    madvise(mapping, fileBytes, MADV_SEQUENTIAL);
+    madvise(mapping, fileBytes, MADV_HUGEPAGE);
+
+    if (format == SignalFormat::Auto)
+      format = GetSignalFormat(path);
+    try
+    {
+      if (format == SignalFormat::Wav)
+        ParseWavHeader();
+      else
+      {
+        sampleFormat = format;
+        dataBytes = fileBytes;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      munmap(mapping, fileBytes);
+      close(fd);
+      throw std::runtime_error(fmt::format("Invalid signal file {}: {}", path.string(), e.what()));
+    }
+  }
+
+  ~SignalFile()
+  {
+    munmap(mapping, fileBytes);
+    close(fd);
+  }
+
+  SignalFile(const SignalFile&) = delete;
+  SignalFile& operator=(const SignalFile&) = delete;
+
+  // samples of the first channel
+  usize GetSampleCount() const { return dataBytes / (GetSampleBytes() * channels); }
+  usize GetDataBytes() const { return dataBytes; }
+
+  // converts samples [first, first + count) of the first channel to f32
+  void Read(usize first, usize count, f32* output)
+  {
+    if (first + count > GetSampleCount())
+      throw std::out_of_range(fmt::format("Signal samples {}..{} out of {}", first, first + count, GetSampleCount()));
+
+    const usize frameBytes = GetSampleBytes() * channels;
+    const auto* data = static_cast<const u8*>(mapping) + dataOffset;
+    ReadAhead(dataOffset + (first + count) * frameBytes);
+    if (sampleFormat == SignalFormat::F32 and channels == 1)
+    {
+      std::memcpy(output, data + first * frameBytes, count * sizeof(f32));
+      return;
+    }
+    for (usize i = 0; i < count; ++i)
+    {
+      const auto* sample = data + (first + i) * frameBytes;
+      if (sampleFormat == SignalFormat::F32)
+        std::memcpy(&output[i], sample, sizeof(f32));
+      else
+      {
+        i16 value;
+        std::memcpy(&value, sample, sizeof(value));
+        output[i] = value * (1.0f / 32768);
+      }
+    }
+  }
+
+  // evicts the file from the page cache so the next mapping reads it from storage, only pages no mapping uses are dropped
+  static void DropPageCache(const std::filesystem::path& path)
+  {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error(fmt::format("Failed to open signal file {}", path.string()));
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+
+private:
+  int fd = -1;
+  void* mapping = nullptr;
+  usize fileBytes = 0;
+  usize dataOffset = 0;
+  usize dataBytes = 0;
+  usize channels = 1;
+  SignalFormat sampleFormat = SignalFormat::F32;
+  usize readAheadEnd = 0;
+
+  usize GetSampleBytes() const { return sampleFormat == SignalFormat::F32 ? sizeof(f32) : sizeof(i16); }
+
+  // requests the next window once reading passes the middle of the current one
+  void ReadAhead(usize readEnd)
+  {
+    if (readEnd + readAheadBytes / 2 < readAheadEnd or readAheadEnd >= fileBytes)
+      return;
+    const usize pageSize = sysconf(_SC_PAGESIZE);
+    const usize begin = std::max(readEnd, readAheadEnd) / pageSize * pageSize;
+    readAheadEnd = std::min(begin + readAheadBytes, fileBytes);
+    madvise(static_cast<u8*>(mapping) + begin, readAheadEnd - begin, MADV_WILLNEED);
+  }
+
+  template <typename T>
+  T Load(usize offset) const
+  {
+    if (offset + sizeof(T) > fileBytes)
+      throw std::runtime_error("truncated header");
+    T value;
+    std::memcpy(&value, static_cast<const u8*>(mapping) + offset, sizeof(T));
+    return value;
+  }
+
+  bool IsTag(usize offset, const char* tag) const { return offset + 4 <= fileBytes and std::memcmp(static_cast<const u8*>(mapping) + offset, tag, 4) == 0; }
+
+  // RIFF header followed by chunks, of which "fmt " and "data" matter
+  void ParseWavHeader()
+  {
+    if (not IsTag(0, "RIFF") or not IsTag(8, "WAVE"))
+      throw std::runtime_error("no RIFF/WAVE header");
+    bool hasFormat = false;
+    for (usize offset = 12; offset + 8 <= fileBytes;)
+    {
+      const usize chunkBytes = Load<u32>(offset + 4);
+      if (IsTag(offset, "fmt "))
+      {
+        u16 encoding = Load<u16>(offset + 8);
+        channels = Load<u16>(offset + 10);
+        const u16 bitsPerSample = Load<u16>(offset + 22);
+        if (encoding == 0xFFFE) // WAVE_FORMAT_EXTENSIBLE, the sub format GUID starts with the encoding
+          encoding = Load<u16>(offset + 32);
+        if (encoding == 1 and bitsPerSample == 16)
+          sampleFormat = SignalFormat::I16;
+        else if (encoding == 3 and bitsPerSample == 32)
+          sampleFormat = SignalFormat::F32;
+        else
+          throw std::runtime_error(fmt::format("unsupported encoding {} with {} bits, only 16-bit PCM and 32-bit float are", encoding, bitsPerSample));
+        if (channels == 0)
+          throw std::runtime_error("no channels");
+        hasFormat = true;
+      }
+      else if (IsTag(offset, "data"))
+      {
+        if (not hasFormat)
+          throw std::runtime_error("data chunk before fmt chunk");
+        dataOffset = offset + 8;
+        dataBytes = std::min(chunkBytes, fileBytes - dataOffset); // streaming writers leave the size of unfinished files at 0 or too large
+        if (dataBytes == 0)
+          dataBytes = fileBytes - dataOffset;
+        return;
+      }
+      offset += 8 + chunkBytes + (chunkBytes & 1);
+    }
+    throw std::runtime_error("no data chunk");
+  }
+};
+
+// streaming mode of the benchmarks, an empty path disables it
+struct StreamConfig
+{
+  std::string path;
+  SignalFormat format = SignalFormat::Auto;
+  usize hop = 0; // 0 = frame size
+  bool cold = false;
+};
+
+// e.g. "stream capture.f32", "stream capture.wav hop 512 cold"
+inline std::string GetStreamName(const StreamConfig& config)
+{
+  std::string name = fmt::format("stream {}", std::filesystem::path(config.path).filename().string());
+  if (config.hop != 0)
+    name += fmt::format(" hop {}", config.hop);
+  if (config.cold)
+    name += " cold";
+  return name;
+}
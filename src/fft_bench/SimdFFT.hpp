@@ -0,0 +1,333 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+
+// The vector width is fixed at compile time by the instruction sets -march=native enables, there is no runtime dispatch: a binary built on
+// an AVX-512 machine uses 16 lanes, AVX/AVX2 8, SSE2/NEON 4 and anything else scalar code.
+#if defined(__AVX512F__)
+inline constexpr usize simdLanes = 16;
+inline constexpr const char* simdIsaName = "AVX-512";
+#elif defined(__AVX2__)
+inline constexpr usize simdLanes = 8;
+inline constexpr const char* simdIsaName = "AVX2";
+#elif defined(__AVX__)
+inline constexpr usize simdLanes = 8;
+inline constexpr const char* simdIsaName = "AVX";
+#elif defined(__SSE2__)
+inline constexpr usize simdLanes = 4;
+inline constexpr const char* simdIsaName = "SSE2";
+#elif defined(__ARM_NEON)
+inline constexpr usize simdLanes = 4;
+inline constexpr const char* simdIsaName = "NEON";
+#else
+inline constexpr usize simdLanes = 1;
+inline constexpr const char* simdIsaName = "scalar";
+#endif
+
+// real transform sizes with a compile-time specialized kernel
+inline constexpr usize simdMinSize = 64;
+inline constexpr usize simdMaxSize = 16384;
+
+inline bool IsSimdSizeSupported(usize size)
+{
+  return std::has_single_bit(size) and size >= simdMinSize and size <= simdMaxSize;
+}
+
+// sin and cos for the constexpr twiddle tables, std::sin and std::cos are not constexpr before C++26. The angle is reduced to [-pi, pi],
+// where 30 Taylor terms in double are exact to well below f32 precision.
+constexpr f64 ConstexprSin(f64 x)
+{
+  constexpr f64 pi = std::numbers::pi;
+  while (x > pi)
+    x -= 2 * pi;
+  while (x < -pi)
+    x += 2 * pi;
+  f64 term = x, sum = x;
+  for (i32 k = 1; k < 30; ++k)
+  {
+    term *= -x * x / ((2 * k) * (2 * k + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr f64 ConstexprCos(f64 x)
+{
+  return ConstexprSin(x + std::numbers::pi / 2);
+}
+
+// exp(-2 pi i j / n) split into real and imaginary parts
+constexpr f64 GetTwiddleReal(usize j, usize n)
+{
+  return ConstexprCos(2 * std::numbers::pi * static_cast<f64>(j % n) / n);
+}
+
+constexpr f64 GetTwiddleImag(usize j, usize n)
+{
+  return -ConstexprSin(2 * std::numbers::pi * static_cast<f64>(j % n) / n);
+}
+
+// GCC ignores vector_size with a size that depends on a template parameter, so every width has its own type. may_alias lets the vectors
+// view f32 buffers.
+template <usize Lanes>
+struct SimdVector;
+
+template <>
+struct SimdVector<1>
+{
+  typedef f32 Type __attribute__((vector_size(4), __may_alias__));
+};
+
+template <>
+struct SimdVector<2>
+{
+  typedef f32 Type __attribute__((vector_size(8), __may_alias__));
+};
+
+template <>
+struct SimdVector<4>
+{
+  typedef f32 Type __attribute__((vector_size(16), __may_alias__));
+};
+
+template <>
+struct SimdVector<8>
+{
+  typedef f32 Type __attribute__((vector_size(32), __may_alias__));
+};
+
+template <>
+struct SimdVector<16>
+{
+  typedef f32 Type __attribute__((vector_size(64), __may_alias__));
+};
+
+// Real-to-complex FFT of a compile-time size N. The complex transform of z[m] = x[2m] + i x[2m+1] of length M = N/2 runs on split real and
+// imaginary arrays of vectors of Lanes floats, every vector holding one element of Lanes independent subsequences, so the butterflies of
+// all stages are plain vertical vector operations:
+//   1. z is deinterleaved into the split layout, lane l of vector n1 is z[Lanes n1 + l]
+//   2. Lanes interleaved transforms of length K = M / Lanes, one per lane, by a radix-4 Stockham autosort FFT with a final radix-2 stage
+//   3. the twiddles exp(-2 pi i l k1 / M)
+//   4. a length Lanes transform across the lanes for every k1, done on Lanes x Lanes blocks transposed in L1, so Z[k1 + K k2] is stored
+//      as whole vectors
+//   5. the split of Z into the real half spectrum, as in FourStepPlan
+// The stage loop is unrolled at compile time through templates and all twiddles are constexpr tables in the binary, nothing is planned
+// at runtime. Inverse runs the same steps on the conjugated merged spectrum.
+template <usize N, usize Lanes>
+class SimdFFT
+{
+public:
+  static constexpr usize M = N / 2;
+  static constexpr usize K = M / Lanes;
+  static_assert(std::has_single_bit(N) and K >= Lanes, "SimdFFT needs a power of two size of at least 2 Lanes^2");
+
+  using Vector = typename SimdVector<Lanes>::Type;
+
+  SimdFFT() : real(M), imag(M), workReal(M), workImag(M) {}
+
+  void Forward(const f32* input, std::complex<f32>* output)
+  {
+    for (usize m = 0; m < M; ++m)
+    {
+      real[m] = input[2 * m];
+      imag[m] = input[2 * m + 1];
+    }
+    TransformComplex();
+    SplitSpectrum(output);
+  }
+
+  void Inverse(const std::complex<f32>* input, f32* output)
+  {
+    MergeSpectrum(input);
+    TransformComplex();
+    for (usize m = 0; m < M; ++m)
+    {
+      output[2 * m] = workReal[m];
+      output[2 * m + 1] = -workImag[m];
+    }
+  }
+
+private:
+  AlignedBuffer<f32> real;
+  AlignedBuffer<f32> imag;
+  AlignedBuffer<f32> workReal;
+  AlignedBuffer<f32> workImag;
+
+  // exp(-2 pi i p / n), exp(-2 pi i 2p / n) and exp(-2 pi i 3p / n) of the radix-4 stage of length n, 6 values per p
+  template <usize n>
+  static constexpr auto stageTwiddles = []
+  {
+    std::array<f32, 6 * (n / 4)> table{};
+    for (usize p = 0; p < n / 4; ++p)
+      for (usize k = 1; k <= 3; ++k)
+      {
+        table[6 * p + 2 * (k - 1)] = GetTwiddleReal(k * p, n);
+        table[6 * p + 2 * (k - 1) + 1] = GetTwiddleImag(k * p, n);
+      }
+    return table;
+  }();
+
+  // exp(-2 pi i l k1 / M) at k1 Lanes + l, separate real and imaginary parts so they load as vectors
+  alignas(64) static constexpr auto laneTwiddles = []
+  {
+    std::array<std::array<f32, M>, 2> table{};
+    for (usize k1 = 0; k1 < K; ++k1)
+      for (usize l = 0; l < Lanes; ++l)
+      {
+        table[0][k1 * Lanes + l] = GetTwiddleReal(k1 * l, M);
+        table[1][k1 * Lanes + l] = GetTwiddleImag(k1 * l, M);
+      }
+    return table;
+  }();
+
+  // exp(-2 pi i k / N) for k = 0 .. M/2 of the real spectrum split
+  static constexpr auto splitTwiddles = []
+  {
+    std::array<std::complex<f32>, M / 2 + 1> table{};
+    for (usize k = 0; k <= M / 2; ++k)
+      table[k] = {static_cast<f32>(GetTwiddleReal(k, N)), static_cast<f32>(GetTwiddleImag(k, N))};
+    return table;
+  }();
+
+  // One Stockham stage of length n with stride s, the recursion runs the rest. Output goes to x when outputToY is false, to y otherwise,
+  // the buffers swap roles on every stage.
+  template <usize n, usize s, bool outputToY>
+  static void Stockham(Vector* xr, Vector* xi, Vector* yr, Vector* yi)
+  {
+    if constexpr (n == 1)
+    {
+      if constexpr (outputToY)
+        for (usize q = 0; q < s; ++q)
+        {
+          yr[q] = xr[q];
+          yi[q] = xi[q];
+        }
+    }
+    else if constexpr (n == 2)
+    {
+      Vector* zr = outputToY ? yr : xr;
+      Vector* zi = outputToY ? yi : xi;
+      for (usize q = 0; q < s; ++q)
+      {
+        const Vector ar = xr[q], ai = xi[q], br = xr[q + s], bi = xi[q + s];
+        zr[q] = ar + br;
+        zi[q] = ai + bi;
+        zr[q + s] = ar - br;
+        zi[q + s] = ai - bi;
+      }
+    }
+    else
+    {
+      constexpr usize m = n / 4;
+      constexpr const auto& twiddles = stageTwiddles<n>;
+      for (usize p = 0; p < m; ++p)
+      {
+        const f32 w1r = twiddles[6 * p], w1i = twiddles[6 * p + 1];
+        const f32 w2r = twiddles[6 * p + 2], w2i = twiddles[6 * p + 3];
+        const f32 w3r = twiddles[6 * p + 4], w3i = twiddles[6 * p + 5];
+        for (usize q = 0; q < s; ++q)
+        {
+          const Vector ar = xr[q + s * p], ai = xi[q + s * p];
+          const Vector br = xr[q + s * (p + m)], bi = xi[q + s * (p + m)];
+          const Vector cr = xr[q + s * (p + 2 * m)], ci = xi[q + s * (p + 2 * m)];
+          const Vector dr = xr[q + s * (p + 3 * m)], di = xi[q + s * (p + 3 * m)];
+          const Vector apcr = ar + cr, apci = ai + ci, amcr = ar - cr, amci = ai - ci;
+          const Vector bpdr = br + dr, bpdi = bi + di, bmdr = br - dr, bmdi = bi - di;
+          // (a - c) -+ i (b - d) and (a + c) - (b + d)
+          const Vector t1r = amcr + bmdi, t1i = amci - bmdr;
+          const Vector t3r = amcr - bmdi, t3i = amci + bmdr;
+          const Vector t2r = apcr - bpdr, t2i = apci - bpdi;
+          yr[q + s * (4 * p)] = apcr + bpdr;
+          yi[q + s * (4 * p)] = apci + bpdi;
+          yr[q + s * (4 * p + 1)] = t1r * w1r - t1i * w1i;
+          yi[q + s * (4 * p + 1)] = t1r * w1i + t1i * w1r;
+          yr[q + s * (4 * p + 2)] = t2r * w2r - t2i * w2i;
+          yi[q + s * (4 * p + 2)] = t2r * w2i + t2i * w2r;
+          yr[q + s * (4 * p + 3)] = t3r * w3r - t3i * w3i;
+          yi[q + s * (4 * p + 3)] = t3r * w3i + t3i * w3r;
+        }
+      }
+      Stockham<m, 4 * s, not outputToY>(yr, yi, xr, xi);
+    }
+  }
+
+  // complex DFT of real + i imag into workReal + i workImag
+  void TransformComplex()
+  {
+    auto* xr = reinterpret_cast<Vector*>(real.Data());
+    auto* xi = reinterpret_cast<Vector*>(imag.Data());
+    auto* yr = reinterpret_cast<Vector*>(workReal.Data());
+    auto* yi = reinterpret_cast<Vector*>(workImag.Data());
+    Stockham<K, 1, false>(xr, xi, yr, yi);
+
+    const auto* twr = reinterpret_cast<const Vector*>(laneTwiddles[0].data());
+    const auto* twi = reinterpret_cast<const Vector*>(laneTwiddles[1].data());
+    for (usize k1 = 0; k1 < K; ++k1)
+    {
+      const Vector r = xr[k1], i = xi[k1];
+      xr[k1] = r * twr[k1] - i * twi[k1];
+      xi[k1] = r * twi[k1] + i * twr[k1];
+    }
+
+    alignas(64) f32 blockReal[Lanes * Lanes], blockImag[Lanes * Lanes], blockWorkReal[Lanes * Lanes], blockWorkImag[Lanes * Lanes];
+    auto* br = reinterpret_cast<Vector*>(blockReal);
+    auto* bi = reinterpret_cast<Vector*>(blockImag);
+    for (usize block = 0; block < K / Lanes; ++block)
+    {
+      for (usize l = 0; l < Lanes; ++l)
+        for (usize j = 0; j < Lanes; ++j)
+        {
+          blockReal[l * Lanes + j] = real[(block * Lanes + j) * Lanes + l];
+          blockImag[l * Lanes + j] = imag[(block * Lanes + j) * Lanes + l];
+        }
+      Stockham<Lanes, 1, false>(br, bi, reinterpret_cast<Vector*>(blockWorkReal), reinterpret_cast<Vector*>(blockWorkImag));
+      for (usize k2 = 0; k2 < Lanes; ++k2)
+      {
+        yr[block + k2 * (K / Lanes)] = br[k2];
+        yi[block + k2 * (K / Lanes)] = bi[k2];
+      }
+    }
+  }
+
+  // see FourStepPlan::SplitSpectrum
+  void SplitSpectrum(std::complex<f32>* output) const
+  {
+    output[0] = {workReal[0] + workImag[0], 0};
+    output[M] = {workReal[0] - workImag[0], 0};
+    for (usize k = 1; k <= M / 2; ++k)
+    {
+      const f32 ar = workReal[k], ai = workImag[k], br = workReal[M - k], bi = -workImag[M - k];
+      const f32 evenr = (ar + br) * 0.5f, eveni = (ai + bi) * 0.5f;
+      const f32 oddr = (ai - bi) * 0.5f, oddi = -(ar - br) * 0.5f;
+      const f32 wr = splitTwiddles[k].real(), wi = splitTwiddles[k].imag();
+      const f32 rotr = wr * oddr - wi * oddi, roti = wr * oddi + wi * oddr;
+      output[k] = {evenr + rotr, eveni + roti};
+      output[M - k] = {evenr - rotr, -(eveni - roti)};
+    }
+  }
+
+  // see FourStepPlan::MergeSpectrum, writes the conjugate of the merged spectrum to real + i imag
+  void MergeSpectrum(const std::complex<f32>* input)
+  {
+    const f32 x0 = input[0].real(), xm = input[M].real();
+    real[0] = x0 + xm;
+    imag[0] = -(x0 - xm);
+    for (usize k = 1; k <= M / 2; ++k)
+    {
+      const f32 ar = input[k].real(), ai = input[k].imag(), br = input[M - k].real(), bi = -input[M - k].imag();
+      const f32 evenr = ar + br, eveni = ai + bi;
+      const f32 dr = ar - br, di = ai - bi;
+      const f32 wr = splitTwiddles[k].real(), wi = -splitTwiddles[k].imag();
+      const f32 oddr = dr * wr - di * wi, oddi = dr * wi + di * wr;
+      // conj(even + i odd) and conj(conj(even) + i conj(odd))
+      real[k] = evenr - oddi;
+      imag[k] = -(eveni + oddr);
+      real[M - k] = evenr + oddi;
+      imag[M - k] = -(-eveni + oddr);
+    }
+  }
+};
+
+// widest vector whose square fits the complex length N/2, up to the native width
+template <usize N>
+inline constexpr usize simdLanesFor = std::min(simdLanes, usize{1} << ((std::bit_width(N / 2) - 1) / 2));
@@ -0,0 +1,191 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "Backends.hpp"
+
+// Families of transform lengths swept besides the powers of two. A length is k-smooth when none of its prime factors exceeds k.
+enum class SizeFamily
+{
+  Smooth3,
+  Smooth5,
+  Smooth7,
+  Prime,
+};
+
+inline std::string GetSizeFamilyName(SizeFamily family)
+{
+  switch (family)
+  {
+  case SizeFamily::Smooth3:
+    return "3smooth";
+  case SizeFamily::Smooth5:
+    return "5smooth";
+  case SizeFamily::Smooth7:
+    return "7smooth";
+  case SizeFamily::Prime:
+    return "prime";
+  }
+  return "unknown";
+}
+
+inline SizeFamily ParseSizeFamily(const std::string& str)
+{
+  for (const auto family : {SizeFamily::Smooth3, SizeFamily::Smooth5, SizeFamily::Smooth7, SizeFamily::Prime})
+    if (str == GetSizeFamilyName(family))
+      return family;
+  throw std::invalid_argument(fmt::format("Unknown size family '{}'", str));
+}
+
+inline bool IsSmooth(usize size, usize maxPrime)
+{
+  if (size == 0)
+    return false;
+  for (usize factor = 2; factor <= maxPrime; ++factor)
+    while (size % factor == 0)
+      size /= factor;
+  return size == 1;
+}
+
+inline bool IsPrime(usize size)
+{
+  if (size < 2)
+    return false;
+  for (usize factor = 2; factor * factor <= size; ++factor)
+    if (size % factor == 0)
+      return false;
+  return true;
+}
+
+inline bool IsInSizeFamily(usize size, SizeFamily family)
+{
+  switch (family)
+  {
+  case SizeFamily::Smooth3:
+    return IsSmooth(size, 3);
+  case SizeFamily::Smooth5:
+    return IsSmooth(size, 5);
+  case SizeFamily::Smooth7:
+    return IsSmooth(size, 7);
+  case SizeFamily::Prime:
+    return IsPrime(size);
+  }
+  return false;
+}
+
+// smallest member of the family >= size, smooth and prime lengths are dense enough for a linear search
+inline usize NextSizeInFamily(usize size, SizeFamily family)
+{
+  while (not IsInSizeFamily(size, family))
+    ++size;
+  return size;
+}
+
+// pointsPerOctave log-spaced targets in [first, last], each rounded up to the next member of the family
+inline std::vector<usize> GenerateSizeSweep(SizeFamily family, usize first, usize last, usize pointsPerOctave)
+{
+  std::vector<usize> sizes;
+  const f64 octaves = std::log2(static_cast<f64>(last) / first);
+  const usize points = static_cast<usize>(std::floor(octaves * pointsPerOctave)) + 1;
+  for (usize point = 0; point < points; ++point)
+  {
+    const auto target = static_cast<usize>(std::ceil(first * std::exp2(static_cast<f64>(point) / pointsPerOctave)));
+    if (const auto size = NextSizeInFamily(target, family); size <= last and std::ranges::find(sizes, size) == sizes.end())
+      sizes.push_back(size);
+  }
+  return sizes;
+}
+
+// sizes worth measuring when a transform of the required length is needed: the length itself, the next smooth lengths, the next length
+// PFFFT accepts and the next power of two
+inline std::vector<usize> GetPaddingCandidates(usize required)
+{
+  std::vector<usize> sizes{required};
+  for (const auto family : {SizeFamily::Smooth3, SizeFamily::Smooth5, SizeFamily::Smooth7})
+    sizes.push_back(NextSizeInFamily(required, family));
+  sizes.push_back(pffft::Fft<f32>::nearestTransformSize(required));
+  sizes.push_back(std::bit_ceil(required));
+  std::ranges::sort(sizes);
+  const auto [first, last] = std::ranges::unique(sizes);
+  sizes.erase(first, last);
+  return sizes;
+}
+
+// Forward transform times measured by the benchmarks, per plan and size. Given a required length, Advise returns for every measured plan the
+// size >= the required length with the lowest time, i.e. how far to zero-pad a frame before transforming it.
+class SizeAdvisor
+{
+public:
+  struct Advice
+  {
+    PlanKey key; // key.size is the advised size
+    f64 seconds;
+    f64 unpaddedSeconds; // time at the required length, 0 when it was not measured or the backend does not support it
+  };
+
+  static SizeAdvisor& Global()
+  {
+    static SizeAdvisor advisor;
+    return advisor;
+  }
+
+  void Record(const PlanKey& key, f64 seconds)
+  {
+    std::scoped_lock lock(mutex);
+    times[GetPlanOnlyKey(key)][key.size] = seconds;
+  }
+
+  std::vector<Advice> Advise(usize required) const
+  {
+    std::scoped_lock lock(mutex);
+    std::vector<Advice> advice;
+    for (const auto& [planKey, sizes] : times)
+    {
+      const auto candidates = std::ranges::subrange(sizes.lower_bound(required), sizes.end());
+      if (candidates.empty())
+        continue;
+
+      const auto best = std::ranges::min_element(candidates, {}, [](const auto& entry) { return entry.second; });
+      Advice entry{.key = planKey, .seconds = best->second, .unpaddedSeconds = 0};
+      entry.key.size = best->first;
+      if (const auto it = sizes.find(required); it != sizes.end())
+        entry.unpaddedSeconds = it->second;
+      advice.push_back(entry);
+    }
+    return advice;
+  }
+
+  // fastest plan measured at exactly this size
+  std::optional<PlanKey> GetFastestPlan(usize size) const
+  {
+    std::scoped_lock lock(mutex);
+    std::optional<PlanKey> fastest;
+    f64 fastestSeconds = 0;
+    for (const auto& [planKey, sizes] : times)
+      if (const auto it = sizes.find(size); it != sizes.end() and (not fastest or it->second < fastestSeconds))
+      {
+        fastest = planKey;
+        fastest->size = size;
+        fastestSeconds = it->second;
+      }
+    return fastest;
+  }
+
+  void PrintAdvice(usize required) const
+  {
+    fmt::print("Fastest size >= {}:\n", required);
+    for (const auto& advice : Advise(required))
+    {
+      const auto unpadded = advice.unpaddedSeconds > 0 ? fmt::format("{:.2f}x faster than unpadded", advice.unpaddedSeconds / advice.seconds) : std::string("unpadded not measured");
+      fmt::print("  {:<28} {:>8} {:>10.4f} ms  {}\n", GetPlanName(advice.key), advice.key.size, advice.seconds * 1e3, unpadded);
+    }
+  }
+
+private:
+  mutable std::mutex mutex;
+  std::map<PlanKey, std::map<usize, f64>> times;
+
+  static PlanKey GetPlanOnlyKey(PlanKey key)
+  {
+    key.size = 0;
+    return key;
+  }
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "AlignedBuffer.hpp"
+#include "Backends.hpp"
+
+// Fused kernels apply the window while copying the frame, compute the power spectrum and the bin gains including the 1/N normalization in
+// one pass over the bins and overlap-add while emitting the output. Separate kernels do each of these in its own pass over memory, the way
+// chaining generic vector operations does.
+enum class StftKernels
+{
+  Fused,
+  Separate,
+};
+
+inline const char* GetStftKernelsName(StftKernels kernels)
+{
+  return kernels == StftKernels::Fused ? "fused" : "separate";
+}
+
+// Short-time Fourier transform with a periodic Hann window, per-bin gains and overlap-add resynthesis: window -> r2c -> power spectrum and
+// gains -> c2r -> overlap-add. The hop has to divide the frame size by at least 2, where the overlapping Hann windows add up to a constant,
+// so unit gains reproduce the input delayed by size - hop samples. Analysis and synthesis own separate plans and buffers, so a producer
+// thread may analyze the next frame while a consumer thread synthesizes the previous one.
+class StftStages
+{
+public:
+  StftStages(const PlanKey& key, usize hop, StftKernels kernels, const std::vector<f32>& binGains = {})
+      : size(key.size), hop(hop), kernels(kernels), forwardPlan(CreatePlan(key)), inversePlan(CreatePlan(key)), window(size), gains(size / 2 + 1),
+        history(size), analysisFrame(size), power(size / 2 + 1), synthesisFrame(size), overlap(size)
+  {
+    if (hop == 0 or size % hop != 0 or size / hop < 2)
+      throw std::invalid_argument(fmt::format("STFT hop {} does not divide the frame size {} at least twice", hop, size));
+    for (usize i = 0; i < size; ++i)
+      window[i] = 0.5 - 0.5 * std::cos(2 * std::numbers::pi * i / size);
+    // the windows overlap to size / (2 hop), the unnormalized transforms contribute a factor of size
+    scale = 2.0f * hop / size / size;
+    for (usize k = 0; k < gains.Size(); ++k)
+      gains[k] = binGains.empty() ? 1 : binGains.at(k);
+  }
+
+  // consumes the next hop input samples and writes the gained spectrum of the frame ending with them in the native layout of the plan
+  void Analyze(const f32* input, std::complex<f32>* spectrum)
+  {
+    std::memmove(history.Data(), history.Data() + hop, (size - hop) * sizeof(f32));
+    std::memcpy(history.Data() + size - hop, input, hop * sizeof(f32));
+    const usize bins = size / 2 + 1;
+
+    if (kernels == StftKernels::Fused)
+    {
+      for (usize i = 0; i < size; ++i)
+        analysisFrame[i] = history[i] * window[i];
+      forwardPlan->Forward(analysisFrame.Data(), spectrum);
+      forwardPlan->UnpackSpectrum(spectrum);
+      for (usize k = 0; k < bins; ++k)
+      {
+        power[k] = std::norm(spectrum[k]);
+        spectrum[k] *= gains[k] * scale;
+      }
+      forwardPlan->PackSpectrum(spectrum);
+      return;
+    }
+
+    std::memcpy(analysisFrame.Data(), history.Data(), size * sizeof(f32));
+    for (usize i = 0; i < size; ++i)
+      analysisFrame[i] *= window[i];
+    forwardPlan->Forward(analysisFrame.Data(), spectrum);
+    forwardPlan->UnpackSpectrum(spectrum);
+    for (usize k = 0; k < bins; ++k)
+      power[k] = std::norm(spectrum[k]);
+    for (usize k = 0; k < bins; ++k)
+      spectrum[k] *= gains[k];
+    for (usize k = 0; k < bins; ++k)
+      spectrum[k] *= scale;
+    forwardPlan->PackSpectrum(spectrum);
+  }
+
+  // transforms the spectrum back, may overwrite it, and writes the next hop output samples
+  void Synthesize(std::complex<f32>* spectrum, f32* output)
+  {
+    inversePlan->Inverse(spectrum, synthesisFrame.Data());
+
+    if (kernels == StftKernels::Fused)
+    {
+      for (usize i = 0; i < hop; ++i)
+        output[i] = overlap[i] + synthesisFrame[i];
+      for (usize i = hop; i < size; ++i)
+        overlap[i - hop] = overlap[i] + synthesisFrame[i];
+      std::fill_n(overlap.Data() + size - hop, hop, 0.0f);
+      return;
+    }
+
+    for (usize i = 0; i < size; ++i)
+      overlap[i] += synthesisFrame[i];
+    std::memcpy(output, overlap.Data(), hop * sizeof(f32));
+    std::memmove(overlap.Data(), overlap.Data() + hop, (size - hop) * sizeof(f32));
+    std::fill_n(overlap.Data() + size - hop, hop, 0.0f);
+  }
+
+  // power spectrum of the last analyzed frame
+  const AlignedBuffer<f32>& GetPower() const { return power; }
+  usize GetSize() const { return size; }
+  usize GetHop() const { return hop; }
+
+private:
+  usize size;
+  usize hop;
+  StftKernels kernels;
+  std::unique_ptr<FFTPlan> forwardPlan;
+  std::unique_ptr<FFTPlan> inversePlan;
+  AlignedBuffer<f32> window;
+  AlignedBuffer<f32> gains;
+  f32 scale;
+  AlignedBuffer<f32> history;
+  AlignedBuffer<f32> analysisFrame;
+  AlignedBuffer<f32> power;
+  AlignedBuffer<f32> synthesisFrame;
+  AlignedBuffer<f32> overlap;
+};
+
+// STFT benchmark layout, empty sizes disable it
+struct StftConfig
+{
+  std::vector<usize> sizes;
+  usize overlap = 4; // frames covering each sample, hop = size / overlap
+  f64 sampleRate = 48000;
+};
@@ -1,107 +1,84 @@
 #pragma once
 #include "Precompiled.hpp"
+#include "Backends.hpp"
+#include "Batched.hpp"
+#include "Dispatch.hpp"
+#include "DoublePrecision.hpp"
+#include "Executor.hpp"
+#include "Multidim.hpp"
+#include "SizeAdvisor.hpp"
 
-std::vector<f32> GetFFTVector(f32* input, usize size)
+std::vector<f32> ForwardTest(const PlanKey& key, const std::vector<f32>& input)
 {
-  std::vector<f32> output(size);
-  for (usize i = 0; i < output.size(); ++i)
-    output[i] = input[i];
-  return output;
-}
-
-std::vector<f32> FFTWTest(std::vector<f32> input, u32 flags)
-{
-  f32* inputAligned = fftwf_alloc_real(input.size());
-  fftwf_complex* outputAligned = fftwf_alloc_complex(input.size() / 2 + 1);
-  fftwf_plan plan = fftwf_plan_dft_r2c_1d(input.size(), inputAligned, outputAligned, flags);
-  std::memcpy(inputAligned, input.data(), input.size() * sizeof(f32));
-  fftwf_execute(plan);
-  const auto output = GetFFTVector(std::bit_cast<f32*>(outputAligned), input.size() + 2);
-  fftwf_destroy_plan(plan);
-  fftwf_free(inputAligned);
-  fftwf_free(outputAligned);
-  fftwf_cleanup();
-  return output;
+  const auto plan = CreatePlan(key);
+  AlignedBuffer<f32> inputAligned(input.size());
+  AlignedBuffer<std::complex<f32>> outputAligned(input.size() / 2 + 1);
+  std::memcpy(inputAligned.Data(), input.data(), input.size() * sizeof(f32));
+  plan->Forward(inputAligned.Data(), outputAligned.Data());
+  const auto output = reinterpret_cast<const f32*>(outputAligned.Data());
+  return std::vector<f32>(output, output + outputAligned.Size() * 2);
 }
 
-std::vector<f32> PocketFFTTest(std::vector<f32> input)
+// forward, 1/N normalization and inverse, returns the reconstructed signal
+std::vector<f32> RoundTripTest(const PlanKey& key, const std::vector<f32>& input, bool inPlace)
 {
-  const pocketfft::shape_t shapeInput{input.size()};
-  const pocketfft::stride_t strideInput{sizeof(f32)};
-  const pocketfft::stride_t strideOutput{sizeof(std::complex<f32>)};
-  const size_t axis = 0;
-  const size_t nthreads = 1;
-  const f32 factor = 1;
-  std::vector<std::complex<f32>> output(input.size() / 2 + 1);
-  pocketfft::r2c(shapeInput, strideInput, strideOutput, axis, pocketfft::FORWARD, input.data(), output.data(), factor, nthreads);
-  return GetFFTVector(std::bit_cast<f32*>(output.data()), input.size() + 2);
-}
-
-std::vector<f32> PFFFTTest(std::vector<f32> input)
-{
-  pffft::Fft<f32> fft(input.size());
+  const auto plan = CreatePlan(key);
+  const usize size = input.size();
+  AlignedBuffer<f32> real(size + 2);
+  AlignedBuffer<std::complex<f32>> spectrum(size / 2 + 1);
+  std::memcpy(real.Data(), input.data(), size * sizeof(f32));
+  const auto bins = inPlace ? reinterpret_cast<std::complex<f32>*>(real.Data()) : spectrum.Data();
 
-  if (!fft.isValid())
-    throw std::invalid_argument(fmt::format("Error: transformation length {} is not decomposable into small prime factors. Next valid transform size is: {}; next power of 2 is: {}", input.size(),
-        pffft::Fft<f32>::nearestTransformSize(input.size()), pffft::Fft<f32>::nextPowerOfTwo(input.size())));
+  if (inPlace)
+    plan->ForwardInPlace(real.Data());
+  else
+    plan->Forward(real.Data(), spectrum.Data());
+  for (usize k = 0; k < size / 2 + 1; ++k)
+    bins[k] /= static_cast<f32>(size);
+  if (inPlace)
+    plan->InverseInPlace(real.Data());
+  else
+    plan->Inverse(spectrum.Data(), real.Data());
 
-  pffft::AlignedVector<f32> inputAligned = fft.valueVector();
-  pffft::AlignedVector<std::complex<f32>> outputAligned = fft.spectrumVector();
-  std::memcpy(inputAligned.data(), input.data(), input.size() * sizeof(f32));
-  fft.forward(inputAligned, outputAligned);
-  return GetFFTVector(std::bit_cast<f32*>(outputAligned.data()), input.size() + 2);
+  return std::vector<f32>(real.Data(), real.Data() + size);
 }
 
-#ifdef ENABLE_KFR
-std::vector<f32> KFRTest(std::vector<f32> input)
+// all transforms of the batch concatenated
+std::vector<f32> BatchTest(const PlanKey& key, const BatchLayout& layout, bool native, const std::vector<std::vector<f32>>& inputs)
 {
-  kfr::univector<f32> in(input.size());
-  kfr::univector<kfr::complex<f32>> out(input.size());
-  kfr::dft_plan_real<f32> plan(input.size());
-  std::memcpy(in.data(), input.data(), input.size() * sizeof(f32));
-  kfr::univector<u8> temp(plan.temp_size);
-  plan.execute(out, in, temp);
-  return GetFFTVector(std::bit_cast<f32*>(out.data()), input.size() + 2);
-}
-#endif
+  const usize size = key.size;
+  const usize count = inputs.size();
+  const auto plan = CreateBatchPlan(key, count, layout, native);
+  AlignedBuffer<f32> inputAligned(layout.InputExtent(size, count));
+  AlignedBuffer<std::complex<f32>> outputAligned(layout.OutputExtent(size, count));
+  for (usize b = 0; b < count; ++b)
+    for (usize j = 0; j < size; ++j)
+      inputAligned[b * layout.inputDistance + j * layout.stride] = inputs[b][j];
+
+  plan->Forward(inputAligned.Data(), outputAligned.Data());
 
-#ifdef ENABLE_OPENCV
-std::vector<f32> OpenCVTest(std::vector<f32> input)
-{
   std::vector<f32> output;
-  cv::dft(input, output);
+  for (usize b = 0; b < count; ++b)
+    for (usize k = 0; k < size / 2 + 1; ++k)
+    {
+      const auto value = outputAligned[b * layout.outputDistance + k * layout.stride];
+      output.push_back(value.real());
+      output.push_back(value.imag());
+    }
   return output;
 }
-#endif
 
-std::vector<f32> IPPTest(std::vector<f32> input, IppHintAlgorithm hint)
-{
-  const int N = input.size();
-  const auto flag = IPP_FFT_NODIV_BY_ANY;
-  auto pSrc = ippsMalloc_32f(N);
-  auto pDst = ippsMalloc_32f(N);
-  std::memcpy(pSrc, input.data(), input.size() * sizeof(f32));
-  int sizeDFTSpec, sizeDFTInitBuf, sizeDFTWorkBuf;
-  ippsDFTGetSize_R_32f(N, flag, hint, &sizeDFTSpec, &sizeDFTInitBuf, &sizeDFTWorkBuf);
-  auto pDFTSpec = (IppsDFTSpec_R_32f*)ippsMalloc_8u(sizeDFTSpec);
-  auto pDFTInitBuf = ippsMalloc_8u(sizeDFTInitBuf);
-  auto pDFTWorkBuf = ippsMalloc_8u(sizeDFTWorkBuf);
-  ippsDFTInit_R_32f(N, flag, hint, pDFTSpec, pDFTInitBuf);
-  if (pDFTInitBuf)
-    ippFree(pDFTInitBuf);
-
-  ippsDFTFwd_RToCCS_32f(pSrc, pDst, pDFTSpec, pDFTWorkBuf);
-  const auto output = GetFFTVector(std::bit_cast<f32*>(pDst), input.size() + 2);
-
-  if (pDFTWorkBuf)
-    ippFree(pDFTWorkBuf);
-  if (pDFTSpec)
-    ippFree(pDFTSpec);
-
-  ippFree(pSrc);
-  ippFree(pDst);
-
-  return output;
+// half spectrum in the FFTW layout
+std::vector<f32> MultidimTest(const PlanKey& key, const Shape& shape, const std::vector<f32>& input)
+{
+  const auto plan = CreateMultidimPlan(key, shape);
+  AlignedBuffer<f32> inputAligned(input.size());
+  AlignedBuffer<std::complex<f32>> outputAligned(plan->GetOutputCount());
+  std::memcpy(inputAligned.Data(), input.data(), input.size() * sizeof(f32));
+  plan->Forward(inputAligned.Data(), outputAligned.Data());
+  const auto spectrum = plan->HalfSpectrum(outputAligned.Data());
+  const auto output = reinterpret_cast<const f32*>(spectrum.data());
+  return std::vector<f32>(output, output + spectrum.size() * 2);
 }
 
 void PrintFFT(const std::vector<f32>& fft, const std::string& prefix, const std::string& suffix)
@@ -147,32 +124,463 @@ void CheckEqual(const std::string& name, const std::vector<f32>& fftref, const s
   }
 }
 
+// element-wise without the index shift CheckEqual tolerates for packed layouts
+void CheckClose(const std::string& name, const std::vector<f32>& input, const std::vector<f32>& output, f64 tolerance)
+{
+  fmt::print("Checking {} ... ", name);
+
+  if (output.size() != input.size())
+    throw std::runtime_error(fmt::format("{} size differs: {} != {}", name, output.size(), input.size()));
+
+  f64 maxdiff = 0;
+  for (usize i = 0; i < input.size(); ++i)
+    maxdiff = std::max(maxdiff, std::abs(static_cast<f64>(output[i]) - input[i]));
+
+  const bool ok = maxdiff <= tolerance;
+  fmt::print("{}, maxdiff: {:.2e}\n", ok ? "OK" : "NOK", maxdiff);
+  if (not ok)
+    throw std::runtime_error(fmt::format("{} did not pass the tests ", name));
+}
+
+void RunRoundTripTests(usize size)
+{
+  const auto input = GenerateRandomVector(size);
+  std::vector<std::pair<std::string, PlanKey>> plans{
+      {"FFTW", {.backend = Backend::FFTW, .size = size, .flags = FFTW_MEASURE}},
+      {"IPP", {.backend = Backend::IPP, .size = size, .flags = ippAlgHintAccurate}},
+      {"PocketFFT", {.backend = Backend::PocketFFT, .size = size}},
+      {"PFFFT", {.backend = Backend::PFFFT, .size = size}},
+  };
+#ifdef ENABLE_KFR
+  plans.push_back({"KFR", {.backend = Backend::KFR, .size = size}});
+#endif
+#ifdef ENABLE_OPENCV
+  plans.push_back({"OpenCV", {.backend = Backend::OpenCV, .size = size}});
+#endif
+  if (IsSimdSizeSupported(size))
+    plans.push_back({"SIMD", {.backend = Backend::Simd, .size = size}});
+
+  for (const auto& [name, key] : plans)
+  {
+    CheckClose(fmt::format("{} round trip", name), input, RoundTripTest(key, input, false), 1e-4);
+    CheckClose(fmt::format("{} round trip in-place", name), input, RoundTripTest(key, input, true), 1e-4);
+  }
+}
+
+// every size is routed to a different backend, the output has to be the FFTW half spectrum regardless of the backend's layout
+void RunDispatchTests()
+{
+  DispatchTable table;
+  table.Set({.backend = Backend::PFFFT, .size = 256});
+  table.Set({.backend = Backend::IPP, .size = 1024, .flags = ippAlgHintFast});
+  table.Set({.backend = Backend::FFTW, .size = 4096, .threads = 2, .flags = FFTW_ESTIMATE});
+
+  const auto path = std::filesystem::temp_directory_path() / fmt::format("fft_bench_dispatch_{}.table", getpid());
+  table.Save(path);
+  const auto loaded = DispatchTable::Load(path);
+  std::filesystem::remove(path);
+  if (loaded.GetEntries() != table.GetEntries())
+    throw std::runtime_error("Dispatch table did not survive saving and loading");
+
+  DispatchingFFT fft(loaded);
+  for (const usize size : {256, 1000, 1021, 4096})
+  {
+    const auto input = GenerateRandomVector(size);
+    const auto fftref = ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_ESTIMATE}, input);
+    AlignedBuffer<f32> inputAligned(size);
+    AlignedBuffer<std::complex<f32>> outputAligned(size / 2 + 1);
+    std::memcpy(inputAligned.Data(), input.data(), size * sizeof(f32));
+    fft.Forward(inputAligned.Data(), outputAligned.Data(), size);
+    const auto output = reinterpret_cast<const f32*>(outputAligned.Data());
+    CheckClose(fmt::format("Dispatch {} -> {}", size, GetPlanName(fft.GetPlanKey(size))), fftref, std::vector<f32>(output, output + outputAligned.Size() * 2), 1e-3 * std::max<usize>(size / 1024, 1));
+  }
+}
+
+void RunSignalFileTests()
+{
+  const auto write = [](const std::filesystem::path& path, const std::string& header, const auto& samples)
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write(header.data(), header.size());
+    file.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(samples[0]));
+  };
+  // canonical 44 byte header of a WAV file with one fmt and one data chunk
+  const auto wavHeader = [](u16 encoding, u16 channels, u16 bitsPerSample, u32 dataBytes)
+  {
+    std::string header;
+    const auto append = [&](auto value) { header.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    header += "RIFF";
+    append(u32{36 + dataBytes});
+    header += "WAVEfmt ";
+    append(u32{16});
+    append(encoding);
+    append(channels);
+    append(u32{48000});
+    append(u32{48000u * channels * bitsPerSample / 8});
+    append(static_cast<u16>(channels * bitsPerSample / 8));
+    append(bitsPerSample);
+    header += "data";
+    append(dataBytes);
+    return header;
+  };
+
+  const usize count = 1000;
+  std::vector<f32> expected(count);
+  std::vector<i16> samples(count), stereo(2 * count);
+  for (usize i = 0; i < count; ++i)
+  {
+    samples[i] = stereo[2 * i] = static_cast<i16>(static_cast<i32>(i * 61 % 65536) - 32768);
+    stereo[2 * i + 1] = 12345;
+    expected[i] = samples[i] / 32768.0f;
+  }
+
+  const auto directory = std::filesystem::temp_directory_path();
+  const auto f32Path = directory / fmt::format("fft_bench_signal_{}.f32", getpid());
+  const auto i16Path = directory / fmt::format("fft_bench_signal_{}.i16", getpid());
+  const auto wavPath = directory / fmt::format("fft_bench_signal_{}.wav", getpid());
+  const auto floatWavPath = directory / fmt::format("fft_bench_signal_float_{}.wav", getpid());
+  write(f32Path, "", expected);
+  write(i16Path, "", samples);
+  write(wavPath, wavHeader(1, 2, 16, stereo.size() * sizeof(i16)), stereo);
+  write(floatWavPath, wavHeader(3, 1, 32, expected.size() * sizeof(f32)), expected);
+
+  for (const auto& path : {f32Path, i16Path, wavPath, floatWavPath})
+  {
+    SignalFile file(path);
+    if (file.GetSampleCount() != count)
+      throw std::runtime_error(fmt::format("Signal file {} has {} samples, expected {}", path.string(), file.GetSampleCount(), count));
+    std::vector<f32> actual(count);
+    for (usize first = 0; first < count; first += 100)
+      file.Read(first, 100, actual.data() + first);
+    CheckClose(fmt::format("signal file {}", path.filename().string()), expected, actual, 0);
+  }
+  for (const auto& path : {f32Path, i16Path, wavPath, floatWavPath})
+    std::filesystem::remove(path);
+}
+
+// every compile-time specialized size against FFTW, the tolerance grows with the magnitude of the spectrum
+void RunSimdTests()
+{
+  for (usize size = simdMinSize; size <= simdMaxSize; size *= 2)
+  {
+    const auto input = GenerateRandomVector(size);
+    const auto fftref = ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_ESTIMATE}, input);
+    CheckClose(fmt::format("SIMD {}", size), fftref, ForwardTest({.backend = Backend::Simd, .size = size}, input), 1e-6 * size);
+    CheckClose(fmt::format("SIMD {} round trip", size), input, RoundTripTest({.backend = Backend::Simd, .size = size}, input, false), 1e-4);
+  }
+}
+
+// unit gains reproduce the input delayed by size - hop samples, with every backend and both kernel variants
+void RunStftTests(usize size)
+{
+  const usize hop = size / 4;
+  const usize delay = size - hop;
+  const auto input = GenerateRandomVector(8 * size);
+  for (const auto backend : {Backend::FFTW, Backend::IPP, Backend::PFFFT, Backend::PocketFFT, Backend::KFR, Backend::OpenCV, Backend::Simd})
+  {
+    if (not IsBackendAvailable(backend) or not IsSizeSupported(backend, size))
+      continue;
+    for (const auto kernels : {StftKernels::Fused, StftKernels::Separate})
+    {
+      const PlanKey key{.backend = backend, .size = size, .flags = backend == Backend::FFTW ? FFTW_ESTIMATE : 0u};
+      StftStages stages(key, hop, kernels);
+      AlignedBuffer<std::complex<f32>> spectrum(size / 2 + 1);
+      std::vector<f32> output(input.size());
+      for (usize first = 0; first < input.size(); first += hop)
+      {
+        stages.Analyze(input.data() + first, spectrum.Data());
+        stages.Synthesize(spectrum.Data(), output.data() + first);
+      }
+      CheckClose(fmt::format("{} STFT {} {}", GetPlanName(key), size, GetStftKernelsName(kernels)), std::vector<f32>(input.begin(), input.end() - delay),
+                 std::vector<f32>(output.begin() + delay, output.end()), 1e-4);
+    }
+  }
+}
+
+// the four-step engine over every backend against the FFTW reference, forward and round trip
+void RunFourStepTests(usize size)
+{
+  const auto input = GenerateRandomVector(size);
+  const auto fftref = ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_ESTIMATE}, input);
+  for (const auto backend : {Backend::FFTW, Backend::IPP, Backend::PFFFT, Backend::PocketFFT, Backend::KFR, Backend::OpenCV})
+  {
+    if (not IsBackendAvailable(backend) or not IsFourStepSupported(backend, size))
+      continue;
+    const PlanKey key{.backend = backend, .size = size, .threads = 4, .flags = backend == Backend::FFTW ? FFTW_ESTIMATE : 0u, .algorithm = Algorithm::FourStep};
+    CheckEqual(GetPlanName(key), fftref, ForwardTest(key, input));
+    CheckClose(fmt::format("{} round trip", GetPlanName(key)), input, RoundTripTest(key, input, false), 1e-4);
+    CheckClose(fmt::format("{} round trip in-place", GetPlanName(key)), input, RoundTripTest(key, input, true), 1e-4);
+
+    // the loops run by the caller as the job executor does, in reverse order so that the calls cannot depend on each other's order
+    FourStepPlan plan(key);
+    AlignedBuffer<f32> real(size);
+    AlignedBuffer<std::complex<f32>> spectrum(size / 2 + 1);
+    std::ranges::copy(input, real.Data());
+    plan.Forward(real.Data(), spectrum.Data(), [&](usize count, const auto& body)
+                 {
+                   for (usize index = count; index-- > 0;)
+                     body(static_cast<i32>(index % plan.GetThreads()), index);
+                 });
+    const auto output = reinterpret_cast<const f32*>(spectrum.Data());
+    CheckEqual(fmt::format("{} caller loops", GetPlanName(key)), fftref, std::vector<f32>(output, output + 2 * (size / 2 + 1)));
+  }
+}
+
+// every double precision backend against the long double reference, forward and round trip
+void RunDoubleTests(usize size)
+{
+  const auto input = GenerateRandomVector(size);
+  const auto reference = GetReferenceSpectrum(input);
+  static constexpr f64 tolerance = 1e-12;
+  for (const auto backend : {Backend::FFTW, Backend::IPP, Backend::PFFFT, Backend::PocketFFT, Backend::KFR})
+  {
+    if (not IsDoubleSupported(backend, size))
+      continue;
+    const PlanKey key{.backend = backend, .size = size, .precision = Precision::F64, .flags = backend == Backend::FFTW ? FFTW_ESTIMATE : 0u};
+    fmt::print("Checking {} ... ", GetPlanName(key));
+    const auto plan = CreatePlan64(key);
+    AlignedBuffer<f64> real(size);
+    AlignedBuffer<std::complex<f64>> spectrum(size / 2 + 1);
+    std::ranges::copy(input, real.Data());
+    plan->Forward(real.Data(), spectrum.Data());
+    plan->Inverse(spectrum.Data(), real.Data());
+    f64 maxdiff = 0;
+    for (usize i = 0; i < size; ++i)
+      maxdiff = std::max(maxdiff, std::abs(real[i] / size - input[i]));
+
+    std::ranges::copy(input, real.Data());
+    plan->Forward(real.Data(), spectrum.Data());
+    plan->UnpackSpectrum(spectrum.Data());
+    const auto error = GetSpectrumError(spectrum.Data(), reference);
+    const bool ok = error <= tolerance and maxdiff <= tolerance;
+    fmt::print("{}, error: {:.2e} ({:.1f} digits), round trip maxdiff: {:.2e}\n", ok ? "OK" : "NOK", error, GetAccurateDigits(error), maxdiff);
+    if (not ok)
+      throw std::runtime_error(fmt::format("{} did not pass the tests ", GetPlanName(key)));
+  }
+}
+
+// out-of-core transforms with a budget of a few blocks per pass against the FFTW reference
+void RunOutOfCoreTests(usize size)
+{
+  const auto input = GenerateRandomVector(size);
+  const auto fftref = ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_ESTIMATE}, input);
+  for (const auto backend : {Backend::FFTW, Backend::IPP, Backend::PFFFT, Backend::PocketFFT, Backend::KFR, Backend::OpenCV})
+  {
+    if (not IsBackendAvailable(backend) or not IsFourStepSupported(backend, size))
+      continue;
+    const PlanKey key{.backend = backend, .size = size, .threads = 2, .flags = backend == Backend::FFTW ? FFTW_ESTIMATE : 0u};
+    OutOfCoreFFT fft(key, std::filesystem::temp_directory_path(), 4 * size);
+    std::memcpy(fft.GetInput(), input.data(), size * sizeof(f32));
+    fft.Forward();
+    const auto output = reinterpret_cast<const f32*>(fft.GetOutput());
+    CheckEqual(fmt::format("{} out-of-core", GetPlanBaseName(key)), fftref, std::vector<f32>(output, output + 2 * (size / 2 + 1)));
+  }
+}
+
+// buffers of every strategy are aligned and zeroed, including reused ones, and the mapped strategies hand released buffers out again
+void RunBufferArenaTests()
+{
+  fmt::print("Checking buffer arena ... ");
+  for (const auto strategy : {PageStrategy::Malloc, PageStrategy::Pool, PageStrategy::THP, PageStrategy::HugeTLB})
+  {
+    const BufferStrategyScope scope(strategy);
+    for (const usize size : {1000, 1 << 20})
+    {
+      const auto check = [&](const AlignedBuffer<f32>& buffer)
+      {
+        if (reinterpret_cast<uintptr_t>(buffer.Data()) % AlignedBuffer<f32>::alignment != 0 or
+            std::ranges::any_of(buffer.Data(), buffer.Data() + size, [](f32 x) { return x != 0; }))
+          throw std::runtime_error(fmt::format("{} buffer of size {} is not aligned and zeroed", GetPageStrategyName(strategy), size));
+      };
+      const void* previous = nullptr;
+      {
+        AlignedBuffer<f32> buffer(size);
+        check(buffer);
+        std::fill_n(buffer.Data(), size, 1.0f);
+        previous = buffer.Data();
+      }
+      AlignedBuffer<f32> buffer(size);
+      check(buffer);
+      if (strategy != PageStrategy::Malloc and buffer.Data() != previous)
+        throw std::runtime_error(fmt::format("{} buffer of size {} was not reused", GetPageStrategyName(strategy), size));
+    }
+  }
+  fmt::print("OK\n");
+}
+
+void RunLatencyHistogramTests()
+{
+  fmt::print("Checking latency histogram ... ");
+  LatencyHistogram histogram;
+  for (u64 value = 1; value <= 1000000; ++value)
+    histogram.Record(value);
+  for (const f64 fraction : {0.5, 0.9, 0.99, 0.999})
+  {
+    const f64 expected = fraction * 1000000;
+    const f64 error = std::abs(histogram.GetPercentile(fraction) - expected) / expected;
+    if (error > 0.01)
+      throw std::runtime_error(fmt::format("Latency histogram p{} is {}, expected {}", fraction * 100, histogram.GetPercentile(fraction), expected));
+  }
+  if (histogram.GetMax() != 1000000 or histogram.GetPercentile(1) != 1000000)
+    throw std::runtime_error("Latency histogram max is wrong");
+  fmt::print("OK\n");
+}
+
+// a burst of mixed sizes through an executor of four workers that splits the largest size, every job's spectrum against the FFTW reference
+void RunExecutorTests()
+{
+  const JobConfig config{.sizes = {{256, 1}, {1024, 1}, {4096, 1}}, .count = 48, .workers = 4, .splitSize = 4096, .batchLimit = 4};
+  std::map<usize, std::vector<f32>> inputs;
+  for (const auto& [size, weight] : config.sizes)
+    inputs.try_emplace(size, GenerateRandomVector(size));
+  auto jobs = GenerateJobs(config, 0, 1);
+  std::vector<std::vector<f32>> outputs(jobs.size());
+  {
+    JobExecutor executor({.backend = Backend::FFTW, .flags = FFTW_ESTIMATE}, config, inputs,
+                         [&](const JobRecord& job, const std::complex<f32>* output)
+                         {
+                           const auto values = reinterpret_cast<const f32*>(output);
+                           outputs[&job - jobs.data()].assign(values, values + 2 * (job.size / 2 + 1));
+                         });
+    DispatchJobs(jobs, std::chrono::steady_clock::now(), [&](JobRecord& job) { executor.Submit(job); });
+    executor.Wait();
+    if (executor.GetStats().splits == 0)
+      throw std::runtime_error("Executor did not split any job");
+  }
+
+  for (const auto& [size, input] : inputs)
+  {
+    const auto fftref = ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_ESTIMATE}, input);
+    std::vector<f32> expected, actual;
+    for (usize i = 0; i < jobs.size(); ++i)
+      if (jobs[i].size == size)
+      {
+        expected.insert(expected.end(), fftref.begin(), fftref.end());
+        actual.insert(actual.end(), outputs[i].begin(), outputs[i].end());
+      }
+    CheckEqual(fmt::format("executor {} jobs of size {}", expected.size() / fftref.size(), size), expected, actual);
+  }
+}
+
+void RunBatchTests(usize size)
+{
+  static constexpr usize count = 3;
+  std::vector<std::vector<f32>> inputs;
+  std::vector<f32> fftref;
+  for (usize b = 0; b < count; ++b)
+  {
+    inputs.push_back(GenerateRandomVector(size));
+    std::ranges::copy(ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_ESTIMATE}, inputs.back()), std::back_inserter(fftref));
+  }
+
+  const std::vector<std::string> layouts{"contiguous", "padded", "interleaved", fmt::format("strided:{}:1", count + 1),
+                                         fmt::format("strided:1:{}:{}", size + 24, size / 2 + 13)};
+  for (const auto& layoutName : layouts)
+  {
+    const auto layout = BatchLayout::Parse(layoutName, size, count);
+    CheckEqual(fmt::format("FFTW batch {} native", layoutName), fftref, BatchTest({.backend = Backend::FFTW, .size = size, .threads = 2, .flags = FFTW_ESTIMATE}, layout, true, inputs));
+    CheckEqual(fmt::format("FFTW batch {} omp", layoutName), fftref, BatchTest({.backend = Backend::FFTW, .size = size, .threads = 2, .flags = FFTW_ESTIMATE}, layout, false, inputs));
+    CheckEqual(fmt::format("PocketFFT batch {} native", layoutName), fftref, BatchTest({.backend = Backend::PocketFFT, .size = size, .threads = 2}, layout, true, inputs));
+    CheckEqual(fmt::format("IPP batch {} omp", layoutName), fftref, BatchTest({.backend = Backend::IPP, .size = size, .threads = 2, .flags = ippAlgHintFast}, layout, false, inputs));
+  }
+}
+
+// 3-smooth, 5-smooth, 7-smooth and prime lengths
+void RunNonPowerOfTwoTests()
+{
+  for (const usize size : {768, 1000, 1029, 1021})
+  {
+    const auto input = GenerateRandomVector(size);
+    const auto fftref = ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_ESTIMATE}, input);
+
+    CheckEqual(fmt::format("IPP {}", size), fftref, ForwardTest({.backend = Backend::IPP, .size = size, .flags = ippAlgHintAccurate}, input));
+    CheckEqual(fmt::format("PocketFFT {}", size), fftref, ForwardTest({.backend = Backend::PocketFFT, .size = size}, input));
+    if (IsSizeSupported(Backend::PFFFT, size))
+      CheckEqual(fmt::format("PFFFT {}", size), fftref, ForwardTest({.backend = Backend::PFFFT, .size = size}, input));
+
+#ifdef ENABLE_KFR
+    CheckEqual(fmt::format("KFR {}", size), fftref, ForwardTest({.backend = Backend::KFR, .size = size}, input));
+#endif
+
+#ifdef ENABLE_OPENCV
+    CheckEqual(fmt::format("OpenCV {}", size), fftref, ForwardTest({.backend = Backend::OpenCV, .size = size}, input));
+#endif
+  }
+
+  for (const usize required : {1000, 44100, 48000})
+    for (const auto size : GetPaddingCandidates(required))
+      if (size < required or (size != required and not IsSmooth(size, 7)))
+        throw std::runtime_error(fmt::format("Invalid padding candidate {} for length {}", size, required));
+}
+
+void RunMultidimTests()
+{
+  for (const auto& shape : {Shape{32, 64}, Shape{8, 16, 32}})
+  {
+    const auto name = GetShapeName(shape);
+    const auto input = GenerateRandomVector(GetElementCount(shape));
+    const auto fftref = MultidimTest({.backend = Backend::FFTW, .flags = FFTW_MEASURE}, shape, input);
+
+    CheckEqual(fmt::format("FFTW {} estimate 2 threads", name), fftref, MultidimTest({.backend = Backend::FFTW, .threads = 2, .flags = FFTW_ESTIMATE}, shape, input));
+    CheckEqual(fmt::format("PocketFFT {} 2 threads", name), fftref, MultidimTest({.backend = Backend::PocketFFT, .threads = 2}, shape, input));
+    if (shape.size() == 2)
+      CheckEqual(fmt::format("IPP {}", name), fftref, MultidimTest({.backend = Backend::IPP, .flags = ippAlgHintAccurate}, shape, input));
+
+#if defined(ENABLE_KFR) and KFR_VERSION_MAJOR >= 5
+    CheckEqual(fmt::format("KFR {}", name), fftref, MultidimTest({.backend = Backend::KFR}, shape, input));
+#endif
+
+#ifdef ENABLE_OPENCV
+    if (shape.size() == 2)
+      CheckEqual(fmt::format("OpenCV {}", name), fftref, MultidimTest({.backend = Backend::OpenCV}, shape, input));
+#endif
+  }
+}
+
 void RunTests(usize size)
 {
   std::srand(std::time(nullptr));
 
   const auto input = GenerateRandomVector(size);
-  const auto fftref = FFTWTest(input, FFTW_MEASURE);
+  const auto fftref = ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_MEASURE}, input);
 
   if (std::ranges::count_if(fftref, [](const auto& x) { return x != std::complex<f32>{0, 0}; }) == 0)
     throw std::runtime_error("Invalid reference FFT");
 
-  CheckEqual("FFTW estimate", fftref, FFTWTest(input, FFTW_ESTIMATE));
-  CheckEqual("FFTW measure", fftref, FFTWTest(input, FFTW_MEASURE));
-  CheckEqual("FFTW patient", fftref, FFTWTest(input, FFTW_PATIENT));
+  CheckEqual("FFTW estimate", fftref, ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_ESTIMATE}, input));
+  CheckEqual("FFTW measure", fftref, ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_MEASURE}, input));
+  CheckEqual("FFTW patient", fftref, ForwardTest({.backend = Backend::FFTW, .size = size, .flags = FFTW_PATIENT}, input));
 
-  CheckEqual("IPP accurate", fftref, IPPTest(input, ippAlgHintAccurate));
-  CheckEqual("IPP fast", fftref, IPPTest(input, ippAlgHintFast));
+  CheckEqual("IPP accurate", fftref, ForwardTest({.backend = Backend::IPP, .size = size, .flags = ippAlgHintAccurate}, input));
+  CheckEqual("IPP fast", fftref, ForwardTest({.backend = Backend::IPP, .size = size, .flags = ippAlgHintFast}, input));
 
-  CheckEqual("PocketFFT", fftref, PocketFFTTest(input));
+  CheckEqual("PocketFFT", fftref, ForwardTest({.backend = Backend::PocketFFT, .size = size}, input));
 
-  CheckEqual("PFFFT", fftref, PFFFTTest(input));
+  CheckEqual("PFFFT", fftref, ForwardTest({.backend = Backend::PFFFT, .size = size}, input));
 
 #ifdef ENABLE_KFR
-  CheckEqual("KFR", fftref, KFRTest(input));
+  CheckEqual("KFR", fftref, ForwardTest({.backend = Backend::KFR, .size = size}, input));
 #endif
 
 #ifdef ENABLE_OPENCV
-  CheckEqual("OpenCV", fftref, OpenCVTest(input));
+  CheckEqual("OpenCV", fftref, ForwardTest({.backend = Backend::OpenCV, .size = size}, input));
 #endif
-}
+
+  if (IsSimdSizeSupported(size))
+    CheckEqual("SIMD", fftref, ForwardTest({.backend = Backend::Simd, .size = size}, input));
+
+  RunRoundTripTests(size);
+  RunNonPowerOfTwoTests();
+  RunSimdTests();
+  RunDispatchTests();
+  RunLatencyHistogramTests();
+  RunBufferArenaTests();
+  RunSignalFileTests();
+  RunStftTests(size);
+  RunFourStepTests(size);
+  RunOutOfCoreTests(size);
+  RunExecutorTests();
+  RunDoubleTests(size);
+  RunBatchTests(size);
+  RunMultidimTests();
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include "Precompiled.hpp"
+#include "Backends.hpp"
+#include "Latency.hpp"
+
+// Time per transform of one single-threaded instance of every plan, recorded by the throughput benchmarks and used as the reference of the
+// per-core efficiency of the multi-instance and multi-threaded runs of the same plan.
+class ThroughputBaselines
+{
+public:
+  static ThroughputBaselines& Global()
+  {
+    static ThroughputBaselines baselines;
+    return baselines;
+  }
+
+  void Record(const PlanKey& key, f64 seconds)
+  {
+    std::scoped_lock lock(mutex);
+    times[GetBaselineKey(key)] = seconds;
+  }
+
+  // 0 when the single-threaded single instance of the plan has not run yet
+  f64 Get(const PlanKey& key) const
+  {
+    std::scoped_lock lock(mutex);
+    const auto it = times.find(GetBaselineKey(key));
+    return it != times.end() ? it->second : 0;
+  }
+
+  static PlanKey GetBaselineKey(PlanKey key)
+  {
+    key.threads = 1;
+    return key;
+  }
+
+private:
+  mutable std::mutex mutex;
+  std::map<PlanKey, f64> times;
+};
+
+// instance i of plans with nthreads threads gets cores [i*nthreads, (i+1)*nthreads) of the list, wrapping around when it is too short
+inline CoreSet GetInstanceCores(const CoreSet& cores, i32 instance, i32 nthreads)
+{
+  CoreSet instanceCores;
+  for (i32 thread = 0; thread < nthreads; ++thread)
+    instanceCores.push_back(cores[(instance * nthreads + thread) % cores.size()]);
+  std::ranges::sort(instanceCores);
+  instanceCores.erase(std::ranges::unique(instanceCores).begin(), instanceCores.end());
+  return instanceCores;
+}
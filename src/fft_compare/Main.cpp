@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include "utils/Json.hpp"
+
+// Compares two results files of fft_bench (--fft_results), e.g. before and after a library upgrade or a compiler change:
+// ./fft_compare ../data/baseline.jsonl ../data/fftbench.jsonl --threshold=5
+// Benchmarks are matched by name, the repetitions of each (--benchmark_repetitions) are the samples of Welch's t-test on the time per
+// iteration. A benchmark regressed when its mean time grew by more than the threshold and the difference is significant; with a single
+// repetition on either side there is no test and the threshold alone decides. Context entries that differ between the files (CPU,
+// library versions, wisdom) are listed first. The exit code is 0 without regressions, 2 with regressions, 3 without regressions but with
+// benchmarks missing on one side or failed, and 1 on errors.
+// --threshold=<percent>  slowdown of the mean time that counts as a regression, default 5
+// --alpha=<p>            significance level of the test, default 0.05
+// --metric=<m>           real (default) or cpu time per iteration
+// --filter=<text>        only benchmarks whose name contains the text
+// --missing=<m>          fail (default) or ignore benchmarks missing on one side or failed, e.g. when the two runs used different sizes
+
+struct Options
+{
+  std::filesystem::path baselinePath;
+  std::filesystem::path candidatePath;
+  double threshold = 5;
+  double alpha = 0.05;
+  std::string metric = "real";
+  std::string filter;
+  bool ignoreMissing = false;
+};
+
+Options ParseOptions(int argc, char** argv)
+{
+  Options options;
+  std::vector<std::filesystem::path> paths;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    if (not arg.starts_with("--"))
+    {
+      paths.push_back(arg);
+      continue;
+    }
+    const auto separator = arg.find('=');
+    if (separator == std::string::npos)
+      throw std::invalid_argument(fmt::format("Invalid option '{}'", arg));
+    const auto key = arg.substr(2, separator - 2);
+    const auto value = arg.substr(separator + 1);
+    if (key == "threshold")
+      options.threshold = std::stod(value);
+    else if (key == "alpha")
+      options.alpha = std::stod(value);
+    else if (key == "metric" and (value == "real" or value == "cpu"))
+      options.metric = value;
+    else if (key == "filter")
+      options.filter = value;
+    else if (key == "missing" and (value == "fail" or value == "ignore"))
+      options.ignoreMissing = value == "ignore";
+    else
+      throw std::invalid_argument(fmt::format("Unknown option '{}'", arg));
+  }
+  if (paths.size() != 2)
+    throw std::invalid_argument("Usage: fft_compare <baseline.jsonl> <candidate.jsonl> [--threshold=5] [--alpha=0.05] [--metric=real|cpu] [--filter=text] [--missing=fail|ignore]");
+  options.baselinePath = paths[0];
+  options.candidatePath = paths[1];
+  return options;
+}
+
+struct ResultsFile
+{
+  std::map<std::string, std::string> context;
+  std::vector<std::string> names; // in the order of the first repetition
+  std::map<std::string, std::vector<double>> samples;
+  std::map<std::string, std::string> errors;
+};
+
+ResultsFile LoadResults(const std::filesystem::path& path, const Options& options)
+{
+  std::ifstream file(path);
+  if (not file)
+    throw std::runtime_error(fmt::format("Failed to open results file {}", path.string()));
+
+  ResultsFile results;
+  std::string line;
+  for (size_t number = 1; std::getline(file, line); ++number)
+  {
+    if (line.empty())
+      continue;
+    JsonValue value;
+    try
+    {
+      value = JsonParser::Parse(line);
+    }
+    catch (const std::exception& e)
+    {
+      throw std::runtime_error(fmt::format("{}:{}: {}", path.string(), number, e.what()));
+    }
+
+    const auto type = value.StringOr("type", "");
+    if (type == "context")
+    {
+      for (const auto& [key, entry] : value.AsObject())
+        if (entry.IsString() and key != "type" and key != "date")
+          results.context[key] = entry.AsString();
+      continue;
+    }
+    const auto name = value.StringOr("name", "");
+    if (type != "run" or name.find(options.filter) == std::string::npos)
+      continue;
+    if (not results.samples.contains(name))
+      results.names.push_back(name);
+    auto& samples = results.samples[name];
+    if (value["error"].IsString())
+      results.errors[name] = value["error"].AsString();
+    else if (const auto time = value.NumberOr(options.metric == "cpu" ? "cpuTime" : "realTime", -1); time > 0)
+      samples.push_back(time);
+  }
+  return results;
+}
+
+double GetMean(const std::vector<double>& samples)
+{
+  return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+double GetVariance(const std::vector<double>& samples)
+{
+  const auto mean = GetMean(samples);
+  double sum = 0;
+  for (const auto sample : samples)
+    sum += (sample - mean) * (sample - mean);
+  return sum / (samples.size() - 1);
+}
+
+// continued fraction of the regularized incomplete beta function I_x(a, b), modified Lentz's method
+double GetIncompleteBeta(double a, double b, double x)
+{
+  if (x <= 0 or x >= 1)
+    return x <= 0 ? 0 : 1;
+  if (x > (a + 1) / (a + b + 2))
+    return 1 - GetIncompleteBeta(b, a, 1 - x);
+
+  static constexpr double tiny = 1e-300;
+  const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1 - x)) / a;
+  double c = 1, d = 0, f = 1;
+  for (int i = 0; i <= 400; ++i)
+  {
+    const int m = i / 2;
+    double numerator = 1;
+    if (i > 0)
+      numerator = i % 2 == 0 ? m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m)) : -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+    d = 1 + numerator * d;
+    d = 1 / (std::abs(d) < tiny ? tiny : d);
+    c = 1 + numerator / c;
+    c = std::abs(c) < tiny ? tiny : c;
+    f *= c * d;
+    if (std::abs(1 - c * d) < 1e-12)
+      break;
+  }
+  return front * (f - 1);
+}
+
+// two-sided p-value of Welch's t-test, empty with fewer than two samples on either side
+std::optional<double> GetWelchPValue(const std::vector<double>& a, const std::vector<double>& b)
+{
+  if (a.size() < 2 or b.size() < 2)
+    return std::nullopt;
+  const double va = GetVariance(a) / a.size();
+  const double vb = GetVariance(b) / b.size();
+  if (va + vb == 0)
+    return GetMean(a) == GetMean(b) ? 1.0 : 0.0;
+  const double t = (GetMean(b) - GetMean(a)) / std::sqrt(va + vb);
+  const double df = (va + vb) * (va + vb) / (va * va / (a.size() - 1) + vb * vb / (b.size() - 1));
+  return GetIncompleteBeta(df / 2, 0.5, df / (df + t * t));
+}
+
+std::string FormatTime(double seconds)
+{
+  if (seconds >= 1)
+    return fmt::format("{:.3f} s", seconds);
+  if (seconds >= 1e-3)
+    return fmt::format("{:.3f} ms", seconds * 1e3);
+  if (seconds >= 1e-6)
+    return fmt::format("{:.3f} us", seconds * 1e6);
+  return fmt::format("{:.1f} ns", seconds * 1e9);
+}
+
+int main(int argc, char** argv)
+try
+{
+  const auto options = ParseOptions(argc, argv);
+  const auto baseline = LoadResults(options.baselinePath, options);
+  const auto candidate = LoadResults(options.candidatePath, options);
+
+  bool contextHeader = false;
+  for (const auto& [key, value] : baseline.context)
+  {
+    const auto it = candidate.context.find(key);
+    const auto other = it != candidate.context.end() ? it->second : "-";
+    if (other == value)
+      continue;
+    if (not contextHeader)
+      fmt::print("Context differences:\n");
+    contextHeader = true;
+    fmt::print("  {}: {} -> {}\n", key, value, other);
+  }
+  for (const auto& [key, value] : candidate.context)
+    if (not baseline.context.contains(key))
+    {
+      if (not contextHeader)
+        fmt::print("Context differences:\n");
+      contextHeader = true;
+      fmt::print("  {}: - -> {}\n", key, value);
+    }
+
+  size_t width = 9;
+  for (const auto& name : baseline.names)
+    width = std::max(width, name.size());
+  fmt::print("{:<{}}  {:>12}  {:>12}  {:>8}  {:>7}  {:>3}\n", "Benchmark", width, "baseline", "candidate", "change", "p-value", "n");
+
+  size_t compared = 0, regressions = 0, improvements = 0, missing = 0;
+  for (const auto& name : baseline.names)
+  {
+    const auto& before = baseline.samples.at(name);
+    const auto it = candidate.samples.find(name);
+    if (it == candidate.samples.end() or it->second.empty() or before.empty())
+    {
+      const auto error = candidate.errors.contains(name) ? candidate.errors.at(name) : baseline.errors.contains(name) ? baseline.errors.at(name) : "";
+      fmt::print("{:<{}}  {}\n", name, width, error.empty() ? "missing in candidate" : fmt::format("error: {}", error));
+      ++missing;
+      continue;
+    }
+    const auto& after = it->second;
+    const double change = (GetMean(after) / GetMean(before) - 1) * 100;
+    const auto pValue = GetWelchPValue(before, after);
+    const bool significant = not pValue or *pValue < options.alpha;
+    std::string verdict;
+    if (significant and change > options.threshold)
+    {
+      verdict = "REGRESSION";
+      ++regressions;
+    }
+    else if (significant and change < -options.threshold)
+    {
+      verdict = "improvement";
+      ++improvements;
+    }
+    ++compared;
+    fmt::print("{:<{}}  {:>12}  {:>12}  {:>+7.1f}%  {:>7}  {:>3}  {}\n", name, width, FormatTime(GetMean(before)), FormatTime(GetMean(after)), change,
+               pValue ? fmt::format("{:.3f}", *pValue) : "-", std::min(before.size(), after.size()), verdict);
+  }
+  for (const auto& name : candidate.names)
+    if (not baseline.samples.contains(name))
+    {
+      fmt::print("{:<{}}  missing in baseline\n", name, width);
+      ++missing;
+    }
+
+  fmt::print("{} compared, {} regressions above {}%, {} improvements, {} unmatched or failed\n", compared, regressions, options.threshold, improvements, missing);
+  if (regressions > 0)
+    return 2;
+  return missing > 0 and not options.ignoreMissing ? 3 : EXIT_SUCCESS;
+}
+catch (const std::exception& e)
+{
+  fmt::print("Error: {}\n", e.what());
+  return EXIT_FAILURE;
+}
+catch (...)
+{
+  fmt::print("Error: {}\n", "Unknown error");
+  return EXIT_FAILURE;
+}
@@ -2,8 +2,17 @@
 #include <complex>
 #include <filesystem>
 #include <fstream>
+#include <thread>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <bit>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <fftw/api/fftw3.h>
 #include <fmt/format.h>
+#include "utils/FFTWWisdom.hpp"
 #include "utils/Timer.hpp"
 
 using Clock = std::chrono::high_resolution_clock;
@@ -26,74 +35,277 @@ void WriteCSVNewline(std::ofstream& file)
   file << std::endl;
 }
 
-int main(int argc, char** argv)
-try
+// the 1D plans fft_bench creates, see FFTWPlan
+enum class Kind
 {
-  if (not fftwf_init_threads())
-    throw std::runtime_error("Failed to initialize FFTW threads");
+  Forward,
+  Inverse,
+  ForwardInPlace,
+  InverseInPlace,
+};
 
-  const auto nthreads = 1;
-  const auto flag = FFTW_PATIENT;
-  const auto exponentMin = 8;  // 8
-  const auto exponentMax = 24; // 24
-  const auto dataPath = std::filesystem::current_path().parent_path() / "data";
-  std::ofstream file(dataPath / "wisdom.csv");
+const char* GetKindName(Kind kind)
+{
+  switch (kind)
+  {
+  case Kind::Forward:
+    return "r2c";
+  case Kind::Inverse:
+    return "c2r";
+  case Kind::ForwardInPlace:
+    return "r2c in-place";
+  case Kind::InverseInPlace:
+    return "c2r in-place";
+  }
+  return "unknown";
+}
 
-  fftwf_plan_with_nthreads(nthreads);
-  WriteCSVfield(file, "size");
-  WriteCSVfield(file, "create plan and export wisdom [ms]");
-  WriteCSVfield(file, "import wisdom and create plan [ms]");
-  WriteCSVfield(file, "execute plan [ms]");
-  WriteCSVNewline(file);
+struct Job
+{
+  int size;
+  int nthreads;
+  unsigned flags;
+  Kind kind;
+};
 
-  for (auto exponent = exponentMin; exponent <= exponentMax; ++exponent)
-  {
-    fmt::print("> 2^{} FFT\n", exponent);
-    const auto size = 1 << exponent;
-    const auto wisdomPath = dataPath / fmt::format("wisdom_{}.fftw", size);
-    auto* inputAligned = fftwf_alloc_real(size);
-    auto* outputAligned = fftwf_alloc_complex(size / 2 + 1);
-    Timepoint tic, toc;
-    WriteCSVfield(file, size);
+struct Options
+{
+  int exponentMin = 8;  // 8
+  int exponentMax = 24; // 24
+  std::vector<int> threads{1};
+  std::vector<unsigned> flags{FFTW_PATIENT};
+  int processes = 0; // 0 = hardware threads / max threads per plan
+  std::filesystem::path wisdomPath = GetDefaultWisdomPath();
+};
+
+std::vector<std::string> SplitList(const std::string& str, char delimiter)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(str);
+  std::string item;
+  while (std::getline(stream, item, delimiter))
+    if (not item.empty())
+      items.push_back(item);
+  return items;
+}
 
+unsigned ParseFlag(const std::string& str)
+{
+  static const std::map<std::string, unsigned> flags{{"estimate", FFTW_ESTIMATE}, {"measure", FFTW_MEASURE}, {"patient", FFTW_PATIENT}, {"exhaustive", FFTW_EXHAUSTIVE}};
+  if (const auto it = flags.find(str); it != flags.end())
+    return it->second;
+  throw std::invalid_argument(fmt::format("Unknown FFTW planner flag '{}'", str));
+}
+
+// --exponents=8:24 --threads=1,2,4 --flags=measure,patient --processes=N --wisdom=<path>
+Options ParseOptions(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const auto separator = arg.find('=');
+    if (not arg.starts_with("--") or separator == std::string::npos)
+      throw std::invalid_argument(fmt::format("Invalid option '{}'", arg));
+    const auto key = arg.substr(2, separator - 2);
+    const auto value = arg.substr(separator + 1);
+    if (key == "exponents")
     {
-      TIMER(" - create plan and export wisdom");
-      tic = Clock::now();
-      fftwf_plan plan_wisdom = fftwf_plan_dft_r2c_1d(size, inputAligned, outputAligned, flag);
-      if (not fftwf_export_wisdom_to_filename(wisdomPath.c_str()))
-        throw std::runtime_error("Failed to export FFTW wisdom");
-      toc = Clock::now();
-      WriteCSVfield(file, GetDuration<Duration>(tic, toc));
-      fftwf_destroy_plan(plan_wisdom);
+      const auto bounds = SplitList(value, ':');
+      options.exponentMin = std::stoi(bounds.at(0));
+      options.exponentMax = std::stoi(bounds.back());
+    }
+    else if (key == "threads")
+    {
+      options.threads.clear();
+      std::ranges::transform(SplitList(value, ','), std::back_inserter(options.threads), [](const auto& item) { return std::stoi(item); });
     }
+    else if (key == "flags")
+    {
+      options.flags.clear();
+      std::ranges::transform(SplitList(value, ','), std::back_inserter(options.flags), ParseFlag);
+    }
+    else if (key == "processes")
+      options.processes = std::stoi(value);
+    else if (key == "wisdom")
+      options.wisdomPath = value;
+    else
+      throw std::invalid_argument(fmt::format("Unknown option '{}'", arg));
+  }
+  if (options.threads.empty() or options.flags.empty() or options.exponentMin > options.exponentMax)
+    throw std::invalid_argument("Empty wisdom job list");
+  if (options.processes <= 0)
+    options.processes = std::max<int>(std::thread::hardware_concurrency() / std::ranges::max(options.threads), 1);
+  return options;
+}
 
-    fftwf_forget_wisdom();
-    fftwf_plan plan;
+// same buffers and strides as FFTWPlan, wisdom only applies to plans of the same problem
+int64_t CreatePlan(const Job& job)
+{
+  auto* real = fftwf_alloc_real(job.size + 2);
+  auto* complex = fftwf_alloc_complex(job.size / 2 + 1);
+  auto* padded = reinterpret_cast<fftwf_complex*>(real);
+  const auto tic = Clock::now();
+  fftwf_plan_with_nthreads(job.nthreads);
+  fftwf_plan plan = nullptr;
+  switch (job.kind)
+  {
+  case Kind::Forward:
+    plan = fftwf_plan_dft_r2c_1d(job.size, real, complex, job.flags);
+    break;
+  case Kind::Inverse:
+    plan = fftwf_plan_dft_c2r_1d(job.size, complex, real, job.flags);
+    break;
+  case Kind::ForwardInPlace:
+    plan = fftwf_plan_dft_r2c_1d(job.size, real, padded, job.flags);
+    break;
+  case Kind::InverseInPlace:
+    plan = fftwf_plan_dft_c2r_1d(job.size, padded, real, job.flags);
+    break;
+  }
+  const auto toc = Clock::now();
+  if (not plan)
+    throw std::runtime_error(fmt::format("Failed to create FFTW {} plan of size {}", GetKindName(job.kind), job.size));
+  fftwf_destroy_plan(plan);
+  fftwf_free(real);
+  fftwf_free(complex);
+  return GetDuration<Duration>(tic, toc);
+}
 
+std::filesystem::path GetWorkerPath(const std::filesystem::path& wisdomPath, int worker, const char* extension)
+{
+  return wisdomPath.parent_path() / fmt::format("{}.worker{}{}", wisdomPath.filename().string(), worker, extension);
+}
+
+// The FFTW planner is not thread-safe, so the jobs are planned in forked worker processes that each export their wisdom. The workers
+// measure concurrently, so keep threads x processes at or below the core count to avoid planning against a loaded machine.
+std::vector<int64_t> GenerateWisdom(const std::vector<Job>& jobs, const Options& options)
+{
+  std::vector<pid_t> workers;
+  std::fflush(stdout); // otherwise buffered output is duplicated into every worker
+  for (int worker = 0; worker < options.processes; ++worker)
+  {
+    const pid_t pid = fork();
+    if (pid < 0)
+      throw std::runtime_error("Failed to fork wisdom worker");
+    if (pid > 0)
     {
-      TIMER(" - import wisdom and create plan");
-      tic = Clock::now();
-      if (not fftwf_import_wisdom_from_filename(wisdomPath.c_str()))
-        throw std::runtime_error("Failed to import FFTW wisdom");
-      plan = fftwf_plan_dft_r2c_1d(size, inputAligned, outputAligned, flag);
-      toc = Clock::now();
-      WriteCSVfield(file, GetDuration<Duration>(tic, toc));
+      workers.push_back(pid);
+      continue;
     }
 
+    try
     {
-      TIMER(" - execute plan");
-      tic = Clock::now();
-      fftwf_execute(plan);
-      toc = Clock::now();
-      WriteCSVfield(file, GetDuration<Duration>(tic, toc));
+      std::ofstream times(GetWorkerPath(options.wisdomPath, worker, ".csv"));
+      for (size_t index = worker; index < jobs.size(); index += options.processes)
+      {
+        const auto& job = jobs[index];
+        const auto ms = CreatePlan(job);
+        fmt::print("> 2^{} {} {} threads: {} ms\n", std::countr_zero(static_cast<unsigned>(job.size)), GetKindName(job.kind), job.nthreads, ms);
+        times << index << " " << ms << "\n";
+      }
+      times.close(); // _exit skips destructors
+      if (not fftwf_export_wisdom_to_filename(GetWorkerPath(options.wisdomPath, worker, ".fftw").c_str()))
+        throw std::runtime_error("Failed to export FFTW wisdom");
+      std::fflush(stdout);
+      _exit(EXIT_SUCCESS);
     }
+    catch (const std::exception& e)
+    {
+      fmt::print("Error: {}\n", e.what());
+      std::fflush(stdout);
+      _exit(EXIT_FAILURE);
+    }
+  }
 
+  bool failed = false;
+  for (const auto pid : workers)
+  {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    failed |= not WIFEXITED(status) or WEXITSTATUS(status) != EXIT_SUCCESS;
+  }
+
+  std::vector<int64_t> planTimes(jobs.size());
+  for (int worker = 0; worker < options.processes; ++worker)
+  {
+    const auto wisdomPath = GetWorkerPath(options.wisdomPath, worker, ".fftw");
+    const auto timesPath = GetWorkerPath(options.wisdomPath, worker, ".csv");
+    if (not failed and not fftwf_import_wisdom_from_filename(wisdomPath.c_str()))
+      failed = true;
+    std::ifstream times(timesPath);
+    size_t index;
+    int64_t ms;
+    while (times >> index >> ms)
+      planTimes.at(index) = ms;
+    std::filesystem::remove(wisdomPath);
+    std::filesystem::remove(timesPath);
+  }
+  if (failed)
+    throw std::runtime_error("Wisdom worker failed");
+  return planTimes;
+}
+
+int main(int argc, char** argv)
+try
+{
+  if (not fftwf_init_threads())
+    throw std::runtime_error("Failed to initialize FFTW threads");
+
+  const auto options = ParseOptions(argc, argv);
+  const auto dataPath = options.wisdomPath.parent_path();
+  std::ofstream file(dataPath / "wisdom.csv");
+
+  std::vector<Job> jobs;
+  for (auto exponent = options.exponentMin; exponent <= options.exponentMax; ++exponent)
+    for (const auto nthreads : options.threads)
+      for (const auto flag : options.flags)
+        for (const auto kind : {Kind::Forward, Kind::Inverse, Kind::ForwardInPlace, Kind::InverseInPlace})
+          jobs.push_back({1 << exponent, nthreads, flag, kind});
+
+  fmt::print("Machine: {}\n", GetMachineKey());
+  fmt::print("Planning {} FFTW plans in {} processes\n", jobs.size(), options.processes);
+  std::vector<int64_t> planTimes;
+  {
+    TIMER("Generating wisdom");
+    planTimes = GenerateWisdom(jobs, options);
+    SaveWisdom(options.wisdomPath);
+  }
+
+  // what a process start of fft_bench costs with the merged wisdom
+  fftwf_forget_wisdom();
+  Timepoint tic = Clock::now();
+  const auto status = LoadWisdom(options.wisdomPath);
+  const auto loadTime = GetDuration<Duration>(tic, Clock::now());
+  if (status != WisdomStatus::Loaded)
+    throw std::runtime_error(fmt::format("Failed to reload wisdom from {}: {}", options.wisdomPath.string(), GetWisdomStatusName(status)));
+
+  WriteCSVfield(file, "size");
+  WriteCSVfield(file, "threads");
+  WriteCSVfield(file, "flags");
+  WriteCSVfield(file, "transform");
+  WriteCSVfield(file, "create plan without wisdom [ms]");
+  WriteCSVfield(file, "create plan with wisdom [ms]");
+  WriteCSVNewline(file);
+
+  int64_t withoutWisdom = 0, withWisdom = loadTime;
+  for (size_t index = 0; index < jobs.size(); ++index)
+  {
+    const auto ms = CreatePlan(jobs[index]);
+    withoutWisdom += planTimes[index];
+    withWisdom += ms;
+    WriteCSVfield(file, jobs[index].size);
+    WriteCSVfield(file, jobs[index].nthreads);
+    WriteCSVfield(file, jobs[index].flags);
+    WriteCSVfield(file, GetKindName(jobs[index].kind));
+    WriteCSVfield(file, planTimes[index]);
+    WriteCSVfield(file, ms);
     WriteCSVNewline(file);
-    fftwf_destroy_plan(plan);
-    fftwf_free(inputAligned);
-    fftwf_free(outputAligned);
   }
 
+  fmt::print("Wrote {}\n", options.wisdomPath.string());
+  fmt::print("Planning all transforms: {} ms without wisdom, {} ms with wisdom ({} ms loading)\n", withoutWisdom, withWisdom, loadTime);
+
   fftwf_cleanup_threads();
   return EXIT_SUCCESS;
 }
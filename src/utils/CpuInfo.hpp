@@ -0,0 +1,41 @@
+#pragma once
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// CPU model and the SIMD extensions relevant to the FFT libraries as listed in /proc/cpuinfo, "unknown" and "none" where it lacks them
+struct CpuInfo
+{
+  std::string model = "unknown";
+  std::string isa;
+};
+
+inline CpuInfo ReadCpuInfo()
+{
+  static constexpr const char* isaFlags[] = {"sse2", "avx", "avx2", "fma", "avx512f", "asimd", "sve"};
+  CpuInfo info;
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line))
+  {
+    const auto separator = line.find(':');
+    if (separator == std::string::npos)
+      continue;
+    const auto key = line.substr(0, line.find_last_not_of(" \t", separator - 1) + 1);
+    const auto value = separator + 2 <= line.size() ? line.substr(separator + 2) : std::string();
+    if (key == "model name" or key == "CPU part")
+      info.model = value;
+    else if ((key == "flags" or key == "Features") and info.isa.empty())
+    {
+      std::istringstream flags(value);
+      std::string flag;
+      while (flags >> flag)
+        for (const auto isaFlag : isaFlags)
+          if (flag == isaFlag)
+            info.isa += info.isa.empty() ? flag : "," + flag;
+      if (info.isa.empty())
+        info.isa = "none";
+    }
+  }
+  return info;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <fftw/api/fftw3.h>
+#include <fmt/format.h>
+#include "CpuInfo.hpp"
+
+// Wisdom is only valid on the host it was measured on, so a wisdom file starts with a header line holding the machine key and the
+// FFTW wisdom follows. The key covers the CPU model, the SIMD extensions FFTW may pick codelets for and the FFTW version.
+enum class WisdomStatus
+{
+  Loaded,
+  Missing,
+  MachineMismatch,
+  Invalid,
+};
+
+inline std::string GetWisdomStatusName(WisdomStatus status)
+{
+  switch (status)
+  {
+  case WisdomStatus::Loaded:
+    return "loaded";
+  case WisdomStatus::Missing:
+    return "missing";
+  case WisdomStatus::MachineMismatch:
+    return "generated on another machine";
+  case WisdomStatus::Invalid:
+    return "invalid";
+  }
+  return "unknown";
+}
+
+inline std::string GetMachineKey()
+{
+  const auto cpu = ReadCpuInfo();
+  return fmt::format("{} | {} | {}", cpu.model, cpu.isa, fftwf_version);
+}
+
+// data/fftw.wisdom next to the data/*.csv results of the other targets
+inline std::filesystem::path GetDefaultWisdomPath()
+{
+  return std::filesystem::current_path().parent_path() / "data" / "fftw.wisdom";
+}
+
+// exports all wisdom accumulated in this process
+inline void SaveWisdom(const std::filesystem::path& path)
+{
+  char* wisdom = fftwf_export_wisdom_to_string();
+  if (not wisdom)
+    throw std::runtime_error("Failed to export FFTW wisdom");
+  std::ofstream file(path);
+  file << GetMachineKey() << "\n" << wisdom;
+  std::free(wisdom);
+  if (not file)
+    throw std::runtime_error(fmt::format("Failed to write FFTW wisdom to {}", path.string()));
+}
+
+// merges the wisdom of the file into the wisdom of this process, files of another machine are rejected
+inline WisdomStatus LoadWisdom(const std::filesystem::path& path)
+{
+  std::ifstream file(path);
+  if (not file)
+    return WisdomStatus::Missing;
+
+  std::string machineKey;
+  std::getline(file, machineKey);
+  if (machineKey != GetMachineKey())
+    return WisdomStatus::MachineMismatch;
+
+  std::stringstream wisdom;
+  wisdom << file.rdbuf();
+  return fftwf_import_wisdom_from_string(wisdom.str().c_str()) ? WisdomStatus::Loaded : WisdomStatus::Invalid;
+}
@@ -0,0 +1,258 @@
+#pragma once
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include <fmt/format.h>
+
+// Just enough JSON for the results files: string escaping and numbers for writing, and a parser into a tree of JsonValue for reading.
+// Numbers that JSON cannot represent (inf, nan) are written as null.
+inline std::string JsonString(std::string_view str)
+{
+  std::string escaped = "\"";
+  for (const char c : str)
+  {
+    switch (c)
+    {
+    case '"':
+      escaped += "\\\"";
+      break;
+    case '\\':
+      escaped += "\\\\";
+      break;
+    case '\n':
+      escaped += "\\n";
+      break;
+    case '\t':
+      escaped += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+      else
+        escaped += c;
+    }
+  }
+  return escaped + "\"";
+}
+
+inline std::string JsonNumber(double value)
+{
+  return std::isfinite(value) ? fmt::format("{}", value) : "null";
+}
+
+class JsonValue
+{
+public:
+  using Array = std::vector<JsonValue>;
+  using Object = std::map<std::string, JsonValue>;
+
+  JsonValue() = default;
+  explicit JsonValue(bool value) : value(value) {}
+  explicit JsonValue(double value) : value(value) {}
+  explicit JsonValue(std::string value) : value(std::move(value)) {}
+  explicit JsonValue(Array value) : value(std::make_shared<Array>(std::move(value))) {}
+  explicit JsonValue(Object value) : value(std::make_shared<Object>(std::move(value))) {}
+
+  bool IsNull() const { return std::holds_alternative<std::monostate>(value); }
+  bool IsNumber() const { return std::holds_alternative<double>(value); }
+  bool IsString() const { return std::holds_alternative<std::string>(value); }
+  bool IsObject() const { return std::holds_alternative<std::shared_ptr<Object>>(value); }
+
+  double AsNumber() const { return Get<double>("number"); }
+  const std::string& AsString() const { return Get<std::string>("string"); }
+  const Array& AsArray() const { return *Get<std::shared_ptr<Array>>("array"); }
+  const Object& AsObject() const { return *Get<std::shared_ptr<Object>>("object"); }
+
+  // member of an object, null when the member is missing
+  const JsonValue& operator[](const std::string& key) const
+  {
+    static const JsonValue null;
+    const auto& object = AsObject();
+    const auto it = object.find(key);
+    return it != object.end() ? it->second : null;
+  }
+
+  // a missing or null member reads as the fallback
+  double NumberOr(const std::string& key, double fallback) const { return (*this)[key].IsNumber() ? (*this)[key].AsNumber() : fallback; }
+  std::string StringOr(const std::string& key, const std::string& fallback) const { return (*this)[key].IsString() ? (*this)[key].AsString() : fallback; }
+
+private:
+  std::variant<std::monostate, bool, double, std::string, std::shared_ptr<Array>, std::shared_ptr<Object>> value;
+
+  template <typename T>
+  const T& Get(const char* type) const
+  {
+    if (const auto ptr = std::get_if<T>(&value))
+      return *ptr;
+    throw std::runtime_error(fmt::format("JSON value is not a {}", type));
+  }
+};
+
+class JsonParser
+{
+public:
+  static JsonValue Parse(std::string_view text)
+  {
+    JsonParser parser(text);
+    auto value = parser.ParseValue();
+    parser.SkipSpace();
+    if (parser.pos != text.size())
+      parser.Fail("trailing characters");
+    return value;
+  }
+
+private:
+  std::string_view text;
+  size_t pos = 0;
+
+  explicit JsonParser(std::string_view text) : text(text) {}
+
+  [[noreturn]] void Fail(const char* what) const { throw std::runtime_error(fmt::format("Invalid JSON at offset {}: {}", pos, what)); }
+
+  void SkipSpace()
+  {
+    while (pos < text.size() and (text[pos] == ' ' or text[pos] == '\t' or text[pos] == '\n' or text[pos] == '\r'))
+      ++pos;
+  }
+
+  bool Consume(std::string_view token)
+  {
+    if (text.substr(pos, token.size()) != token)
+      return false;
+    pos += token.size();
+    return true;
+  }
+
+  void Expect(char c)
+  {
+    SkipSpace();
+    if (pos >= text.size() or text[pos] != c)
+      Fail(fmt::format("expected '{}'", c).c_str());
+    ++pos;
+  }
+
+  JsonValue ParseValue()
+  {
+    SkipSpace();
+    if (pos >= text.size())
+      Fail("unexpected end");
+    switch (text[pos])
+    {
+    case '{':
+      return ParseObject();
+    case '[':
+      return ParseArray();
+    case '"':
+      return JsonValue(ParseString());
+    default:
+      if (Consume("true"))
+        return JsonValue(true);
+      if (Consume("false"))
+        return JsonValue(false);
+      if (Consume("null"))
+        return JsonValue();
+      return JsonValue(ParseNumber());
+    }
+  }
+
+  JsonValue ParseObject()
+  {
+    JsonValue::Object object;
+    Expect('{');
+    SkipSpace();
+    if (Consume("}"))
+      return JsonValue(std::move(object));
+    do
+    {
+      SkipSpace();
+      auto key = ParseString();
+      Expect(':');
+      object[std::move(key)] = ParseValue();
+      SkipSpace();
+    } while (Consume(","));
+    Expect('}');
+    return JsonValue(std::move(object));
+  }
+
+  JsonValue ParseArray()
+  {
+    JsonValue::Array array;
+    Expect('[');
+    SkipSpace();
+    if (Consume("]"))
+      return JsonValue(std::move(array));
+    do
+    {
+      array.push_back(ParseValue());
+      SkipSpace();
+    } while (Consume(","));
+    Expect(']');
+    return JsonValue(std::move(array));
+  }
+
+  // \u escapes are decoded for the ASCII range only, which covers everything the writer escapes
+  std::string ParseString()
+  {
+    if (pos >= text.size() or text[pos] != '"')
+      Fail("expected a string");
+    ++pos;
+    std::string str;
+    while (pos < text.size() and text[pos] != '"')
+    {
+      char c = text[pos++];
+      if (c == '\\')
+      {
+        if (pos >= text.size())
+          Fail("unterminated escape");
+        switch (c = text[pos++])
+        {
+        case 'n':
+          c = '\n';
+          break;
+        case 't':
+          c = '\t';
+          break;
+        case 'r':
+          c = '\r';
+          break;
+        case 'b':
+          c = '\b';
+          break;
+        case 'f':
+          c = '\f';
+          break;
+        case 'u':
+          if (pos + 4 > text.size())
+            Fail("truncated \\u escape");
+          c = static_cast<char>(std::strtol(std::string(text.substr(pos, 4)).c_str(), nullptr, 16));
+          pos += 4;
+          break;
+        default:
+          break; // '"', '\\' and '/' stand for themselves
+        }
+      }
+      str += c;
+    }
+    if (pos >= text.size())
+      Fail("unterminated string");
+    ++pos;
+    return str;
+  }
+
+  double ParseNumber()
+  {
+    const std::string rest(text.substr(pos, 64));
+    char* end = nullptr;
+    const double value = std::strtod(rest.c_str(), &end);
+    if (end == rest.c_str())
+      Fail("expected a value");
+    pos += end - rest.c_str();
+    return value;
+  }
+};
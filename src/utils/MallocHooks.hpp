@@ -0,0 +1,84 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include "MemoryTracker.hpp"
+
+// Replaces the malloc family for the whole process and forwards to glibc, reporting every block to MemoryTracker. Symbols defined in the
+// executable take precedence over libc for the shared libraries as well. Defines non-inline functions, include it from exactly one
+// translation unit of an executable.
+extern "C"
+{
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+  void* __libc_valloc(size_t size);
+  void* __libc_pvalloc(size_t size);
+  void __libc_free(void* ptr);
+
+  void* malloc(size_t size) noexcept
+  {
+    void* ptr = __libc_malloc(size);
+    MemoryTracker::OnAllocate(ptr);
+    return ptr;
+  }
+
+  void* calloc(size_t count, size_t size) noexcept
+  {
+    void* ptr = __libc_calloc(count, size);
+    MemoryTracker::OnAllocate(ptr);
+    return ptr;
+  }
+
+  void* realloc(void* ptr, size_t size) noexcept
+  {
+    MemoryTracker::OnFree(ptr);
+    void* reallocated = __libc_realloc(ptr, size);
+    if (reallocated)
+      MemoryTracker::OnAllocate(reallocated);
+    else if (ptr and size > 0)
+      MemoryTracker::OnAllocate(ptr); // the original block is still allocated
+    return reallocated;
+  }
+
+  void* memalign(size_t alignment, size_t size) noexcept
+  {
+    void* ptr = __libc_memalign(alignment, size);
+    MemoryTracker::OnAllocate(ptr);
+    return ptr;
+  }
+
+  // glibc does not route valloc and pvalloc through memalign, without these their blocks would be subtracted in free below but never added
+  void* valloc(size_t size) noexcept
+  {
+    void* ptr = __libc_valloc(size);
+    MemoryTracker::OnAllocate(ptr);
+    return ptr;
+  }
+
+  void* pvalloc(size_t size) noexcept
+  {
+    void* ptr = __libc_pvalloc(size);
+    MemoryTracker::OnAllocate(ptr);
+    return ptr;
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size) noexcept
+  {
+    return memalign(alignment, size);
+  }
+
+  int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+  {
+    if (alignment % sizeof(void*) != 0 or (alignment & (alignment - 1)) != 0)
+      return EINVAL;
+    *ptr = memalign(alignment, size);
+    return *ptr or size == 0 ? 0 : ENOMEM;
+  }
+
+  void free(void* ptr) noexcept
+  {
+    MemoryTracker::OnFree(ptr);
+    __libc_free(ptr);
+  }
+}
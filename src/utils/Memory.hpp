@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <sys/resource.h>
+
+// peak resident set size of the current process in bytes
+inline size_t GetPeakResidentMemory()
+{
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return static_cast<size_t>(usage.ru_maxrss) * 1024; // ru_maxrss is in kilobytes on Linux
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <malloc.h>
+
+// Process-wide heap accounting fed by the malloc family replacements of utils/MallocHooks.hpp. FFTW (fftwf_malloc), IPP (ippsMalloc_*),
+// pocketfft, KFR and OpenCV all allocate through malloc, posix_memalign or operator new, so replacing the malloc family covers them without
+// hooking each library. Sizes are taken from malloc_usable_size, which is what the allocation really costs. All values read zero when
+// the hooks are not linked into the executable.
+class MemoryTracker
+{
+public:
+  static void OnAllocate(void* ptr)
+  {
+    if (not ptr)
+      return;
+    enabled.store(true, std::memory_order_relaxed);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const size_t bytes = current.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed) + malloc_usable_size(ptr);
+    size_t previous = peak.load(std::memory_order_relaxed);
+    while (previous < bytes and not peak.compare_exchange_weak(previous, bytes, std::memory_order_relaxed))
+      ;
+  }
+
+  static void OnFree(void* ptr)
+  {
+    if (ptr)
+      current.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+  }
+
+  // memory handed out by allocators that map pages themselves (BufferArena), counted like heap blocks while in use
+  static void AddExternal(size_t bytes)
+  {
+    const size_t bytesNow = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t previous = peak.load(std::memory_order_relaxed);
+    while (previous < bytesNow and not peak.compare_exchange_weak(previous, bytesNow, std::memory_order_relaxed))
+      ;
+  }
+
+  static void RemoveExternal(size_t bytes) { current.fetch_sub(bytes, std::memory_order_relaxed); }
+
+  static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+  static size_t GetCurrentBytes() { return current.load(std::memory_order_relaxed); }
+  static size_t GetPeakBytes() { return peak.load(std::memory_order_relaxed); }
+  static size_t GetAllocationCount() { return allocations.load(std::memory_order_relaxed); }
+
+  // restarts the peak from the current heap use
+  static void ResetPeak() { peak.store(current.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+
+private:
+  static inline std::atomic<bool> enabled = false;
+  static inline std::atomic<size_t> current = 0;
+  static inline std::atomic<size_t> peak = 0;
+  static inline std::atomic<size_t> allocations = 0;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// config of a PERF_TYPE_HW_CACHE event
+constexpr uint64_t GetPerfCacheEvent(uint64_t cache, uint64_t op, uint64_t result)
+{
+  return cache | (op << 8) | (result << 16);
+}
+
+// Hardware counters of the calling thread via perf_event_open, plus threads it creates while counting. Worker threads of a library thread
+// pool that already exist are not included. Every event is opened on its own instead of as a group, so a PMU lacking one event (no dTLB
+// events in many VMs) still reports the others, and counts are scaled when the kernel multiplexes them. Unavailable events read as
+// negative, all of them are unavailable in containers without CAP_PERFMON or with a restrictive perf_event_paranoid. The kernel has no
+// generic L2 event, L2 misses need the raw event code of the CPU model.
+class PerfCounters
+{
+public:
+  struct Event
+  {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+  };
+
+  static constexpr std::array<Event, 6> events{{
+      {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"branchMisses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {"L1dMisses", PERF_TYPE_HW_CACHE, GetPerfCacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+      {"LLCMisses", PERF_TYPE_HW_CACHE, GetPerfCacheEvent(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+      {"dTLBMisses", PERF_TYPE_HW_CACHE, GetPerfCacheEvent(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+  }};
+
+  PerfCounters()
+  {
+    for (size_t i = 0; i < events.size(); ++i)
+      fds[i] = Open(events[i]);
+  }
+
+  ~PerfCounters()
+  {
+    for (const auto fd : fds)
+      if (fd >= 0)
+        close(fd);
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // false when no event could be opened
+  bool IsAvailable() const
+  {
+    for (const auto fd : fds)
+      if (fd >= 0)
+        return true;
+    return false;
+  }
+
+  void Start()
+  {
+    for (const auto fd : fds)
+      if (fd >= 0)
+      {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+  }
+
+  void Stop()
+  {
+    for (const auto fd : fds)
+      if (fd >= 0)
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  // count of events[index] since Start, scaled for multiplexing, negative when the event is unavailable
+  double Read(size_t index) const
+  {
+    struct
+    {
+      uint64_t value;
+      uint64_t timeEnabled;
+      uint64_t timeRunning;
+    } data{};
+    if (fds[index] < 0 or read(fds[index], &data, sizeof(data)) != sizeof(data))
+      return -1;
+    if (data.timeRunning == 0)
+      return data.timeEnabled == 0 ? 0 : -1;
+    return static_cast<double>(data.value) * data.timeEnabled / data.timeRunning;
+  }
+
+  // whether this process may count at all, for a one-time notice
+  static bool IsSupported()
+  {
+    const PerfCounters counters;
+    return counters.IsAvailable();
+  }
+
+private:
+  std::array<int, events.size()> fds;
+
+  static int Open(const Event& event)
+  {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+};
@@ -1,4 +1,7 @@
 #!/bin/bash
 
-scp root@10.170.111.80:/home/root/fftbench/data/fftbench.csv data  # atom
-python3 tools/show_benchmark_results.py
\ No newline at end of file
+scp root@10.170.111.80:/home/root/fftbench/data/fftbench.jsonl data  # atom
+if [ -f data/baseline.jsonl ]; then
+  ./build/fft_compare data/baseline.jsonl data/fftbench.jsonl
+fi
+python3 tools/show_benchmark_results.py
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+./build/fft_bench --fft_results=data/fftbench.jsonl --benchmark_repetitions=5
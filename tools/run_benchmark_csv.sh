@@ -1,3 +0,0 @@
-#!/bin/bash
-
-./build/fftbench --benchmark_out_format=csv --benchmark_out=data/fftbench.csv
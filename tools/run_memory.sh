@@ -1,5 +1,6 @@
 #!/bin/bash
+# massif profiles of the standalone 2^24 programs, fft_bench reports planHeap/workHeap/peakHeap counters for every benchmark without valgrind
 
 rm -f massif.out.*
-valgrind --tool=massif --threshold=0 --detailed-freq=1 ./build/fft_fftw
-valgrind --tool=massif --threshold=0 --detailed-freq=1 ./build/fft_ipp
+valgrind --tool=massif --threshold=0 --detailed-freq=1 ./build/fftw_memory
+valgrind --tool=massif --threshold=0 --detailed-freq=1 ./build/ipp_memory
@@ -1,47 +1,44 @@
-import csv
+import json
 import numpy as np
 import matplotlib.pyplot as plt
 
-time_unit_input = 1e-3
 time_unit_output = 1e-3
 
 
 class BenchmarkEntry:
-    def __init__(self, size, time):
-        self.sizes = np.array([size])
-        self.times = np.array([time])
+    def __init__(self):
+        self.times = {}
 
+    def add(self, size, time):
+        self.times.setdefault(size, []).append(time)
 
-def find_nth(haystack, needle, n):
-    start = haystack.find(needle)
-    while start >= 0 and n > 1:
-        start = haystack.find(needle, start+len(needle))
-        n -= 1
-    return start
+    @property
+    def sizes(self):
+        return np.array(sorted(self.times))
+
+    @property
+    def mean_times(self):
+        return np.array([np.mean(self.times[size]) for size in sorted(self.times)])
 
 
 entries = {}
 minsize = np.inf
 maxsize = 0
 
-with open('data/fftbench.csv', newline='') as csvfile:
-    reader = csv.reader(csvfile, delimiter=',')
-    for row in reader:
-        string = ', '.join(row)
-        if " | " in string:
-            print("Processing", string)
-            size = int(string[0:string.find(" | ")].strip())
-            name = string[string.find(" | ")+2:string.find(",")].strip()
-            time = float(string[find_nth(string, ",", 2)+1:find_nth(string, ",", 3)].strip()) / \
-                (time_unit_output/time_unit_input)
-            minsize = min(minsize, size)
-            maxsize = max(maxsize, size)
-
-            if name in entries:
-                entries[name].sizes = np.append(entries[name].sizes, size)
-                entries[name].times = np.append(entries[name].times, time)
-            else:
-                entries[name] = BenchmarkEntry(size, time)
+# fft_bench --fft_results: a context line, then one line per repetition with the structured fields of the benchmark
+with open('data/fftbench.jsonl') as file:
+    for line in file:
+        result = json.loads(line)
+        if result["type"] == "context":
+            print("Results of", result.get("cpu"), "from", result.get("date"))
+            continue
+        if "error" in result or "size" not in result:
+            continue
+        name = result["plan"] if not result["variant"] else "{} | {}".format(result["plan"], result["variant"])
+        size = result["size"]
+        minsize = min(minsize, size)
+        maxsize = max(maxsize, size)
+        entries.setdefault(name, BenchmarkEntry()).add(size, result["realTime"] / time_unit_output)
 
 
 xticksvalues = []
@@ -53,7 +50,7 @@ for exp in range(int(np.log2(minsize)), int(np.log2(maxsize))+1):
 plt.figure(figsize=(10, 10))
 plt.subplot(2, 1, 1)
 for name, entry in entries.items():
-    plt.plot(entry.sizes, entry.times, "*-", label=name, linewidth=2)
+    plt.plot(entry.sizes, entry.mean_times, "*-", label=name, linewidth=2)
 plt.xscale("log")
 plt.xlabel("FFT size")
 plt.ylabel("time [ms]")
@@ -62,7 +59,7 @@ plt.legend()
 
 plt.subplot(2, 1, 2)
 for name, entry in entries.items():
-    plt.plot(entry.sizes, entry.times, "*-", label=name, linewidth=2)
+    plt.plot(entry.sizes, entry.mean_times, "*-", label=name, linewidth=2)
 plt.xscale("log")
 plt.yscale("log")
 plt.xlabel("FFT size")